@@ -27,10 +27,15 @@
 # find opm -name '*.c*' -printf '\t%p\n' | sort
 list (APPEND MAIN_SOURCE_FILES
 	opm/autodiff/BlackoilPropsAdInterface.cpp
+	opm/autodiff/BlackoilStateExtrapolation.cpp
+	opm/autodiff/BlackoilTransportReorder.cpp
+	opm/autodiff/PIDTimeStepControl.cpp
+	opm/autodiff/CellOrdering.cpp
 	opm/autodiff/ExtractParallelGridInformationToISTL.cpp
 	opm/autodiff/NewtonIterationBlackoilCPR.cpp
 	opm/autodiff/NewtonIterationBlackoilSimple.cpp
 	opm/autodiff/GridHelpers.cpp
+	opm/autodiff/GridOperatorsCache.cpp
 	opm/autodiff/ImpesTPFAAD.cpp
 	opm/autodiff/SimulatorFullyImplicitBlackoilOutput.cpp
 	opm/autodiff/SimulatorIncompTwophaseAd.cpp
@@ -45,7 +50,12 @@ list (APPEND MAIN_SOURCE_FILES
 list (APPEND TEST_SOURCE_FILES
 	tests/test_autodiffhelpers.cpp
 	tests/test_block.cpp
+	tests/test_blackoilstateextrapolation.cpp
+	tests/test_blackoiltransportreorder.cpp
+	tests/test_pidtimestepcontrol.cpp
+	tests/test_cellordering.cpp
 	tests/test_boprops_ad.cpp
+	tests/test_gridoperatorscache.cpp
 	tests/test_rateconverter.cpp
 	tests/test_span.cpp
 	tests/test_syntax.cpp
@@ -90,18 +100,25 @@ list (APPEND PROGRAM_SOURCE_FILES
 # originally generated with the command:
 # find opm -name '*.h*' -a ! -name '*-pch.hpp' -printf '\t%p\n' | sort
 list (APPEND PUBLIC_HEADER_FILES
+	opm/autodiff/AutoDiffBatch.hpp
 	opm/autodiff/AutoDiffBlock.hpp
 	opm/autodiff/AutoDiffHelpers.hpp
 	opm/autodiff/AutoDiff.hpp
 	opm/autodiff/BackupRestore.hpp
+	opm/autodiff/BlackoilPhaseConfiguration.hpp
 	opm/autodiff/BlackoilPropsAdFromDeck.hpp
 	opm/autodiff/BlackoilPropsAdInterface.hpp
+	opm/autodiff/BlackoilStateExtrapolation.hpp
+	opm/autodiff/BlackoilTransportReorder.hpp
+	opm/autodiff/PIDTimeStepControl.hpp
 	opm/autodiff/CPRPreconditioner.hpp
+	opm/autodiff/CellOrdering.hpp
 	opm/autodiff/fastSparseProduct.hpp
 	opm/autodiff/DuneMatrix.hpp
 	opm/autodiff/ExtractParallelGridInformationToISTL.hpp
 	opm/autodiff/GeoProps.hpp
 	opm/autodiff/GridHelpers.hpp
+	opm/autodiff/GridOperatorsCache.hpp
 	opm/autodiff/ImpesTPFAAD.hpp
 	opm/autodiff/FullyImplicitBlackoilSolver.hpp
 	opm/autodiff/FullyImplicitBlackoilSolver_impl.hpp
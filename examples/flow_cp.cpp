@@ -209,7 +209,7 @@ try
                                                Opm::UgGridHelpers::cartDims(*grid),
                                                Opm::UgGridHelpers::beginCellCentroids(*grid),
                                                Opm::UgGridHelpers::dimensions(*grid), param));
-    new_props.reset(new BlackoilPropsAdFromDeck(deck, eclipseState, *grid));
+    new_props.reset(new BlackoilPropsAdFromDeck(deck, eclipseState, *grid, param));
     // check_well_controls = param.getDefault("check_well_controls", false);
     // max_well_control_iterations = param.getDefault("max_well_control_iterations", 10);
     // Rock compressibility.
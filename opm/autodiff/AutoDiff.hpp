@@ -22,42 +22,86 @@
 #define OPM_AUTODIFF_HPP_HEADER
 
 #include <cmath>
+#include <cassert>
 
 namespace Opm
 {
 
     /// A simple class for forward-mode automatic differentiation.
     ///
-    /// The class represents a single value and a single derivative.
-    /// Only basic arithmetic operators and a few functions are
-    /// implemented for it, it is mostly intended for simple
-    /// experimentation.
-    template <typename Scalar>
+    /// The class represents a single value and a fixed number N of
+    /// partial derivatives (one by default).  The derivatives are
+    /// stored in a contiguous array whose length is known at compile
+    /// time, so all derivative loops below have fixed trip counts and
+    /// are readily unrolled and vectorised by the compiler.  This
+    /// makes the class suitable for cell-local kernels where a few
+    /// primary variables (say pressure, saturation and Rs) must be
+    /// propagated through a property evaluation.
+    ///
+    /// For evaluating many such objects at once, see AutoDiffBatch.
+    template <typename Scalar, int N = 1>
     class AutoDiff
     {
     public:
+        /// Number of partial derivatives carried.
+        enum { NumDerivatives = N };
+
         /// Create an AutoDiff object representing a constant, that
-        /// is, its derivative is zero.
+        /// is, all its derivatives are zero.
         static AutoDiff
         constant(const Scalar x)
         {
-            return function(x, Scalar(0));
+            AutoDiff ret(x);
+            return ret;
         }
 
         /// Create an AutoDiff object representing a primary variable,
-        /// that is, its derivative is one.
+        /// that is, its derivative with respect to itself (the
+        /// variable with the given index) is one, all other
+        /// derivatives are zero.
         static AutoDiff
-        variable(const Scalar x)
+        variable(const Scalar x, const int index = 0)
         {
-            return function(x, Scalar(1));
+            assert(0 <= index && index < N);
+            AutoDiff ret(x);
+            ret.der_[index] = Scalar(1);
+            return ret;
         }
 
         /// Create an AutoDiff object representing a function value
-        /// and its derivative.
+        /// and its derivative.  Only available when N == 1.
         static AutoDiff
         function(const Scalar x, const Scalar dx)
         {
-            return AutoDiff(x, dx);
+            static_assert(N == 1, "function(x, dx) requires a single derivative.");
+            AutoDiff ret(x);
+            ret.der_[0] = dx;
+            return ret;
+        }
+
+        /// Create an AutoDiff object representing a function value
+        /// and its N derivatives.
+        static AutoDiff
+        function(const Scalar x, const Scalar* dx)
+        {
+            AutoDiff ret(x);
+            for (int i = 0; i < N; ++i) {
+                ret.der_[i] = dx[i];
+            }
+            return ret;
+        }
+
+        /// Create an AutoDiff object representing f(x), given the
+        /// value f = f(x.val()) and derivative dfdx = f'(x.val()).
+        /// The derivatives of the result follow from the chain rule.
+        static AutoDiff
+        chain(const Scalar f, const Scalar dfdx, const AutoDiff& x)
+        {
+            AutoDiff ret(f);
+            for (int i = 0; i < N; ++i) {
+                ret.der_[i] = dfdx * x.der_[i];
+            }
+            return ret;
         }
 
         void
@@ -70,7 +114,9 @@ namespace Opm
         operator +=(const AutoDiff& rhs)
         {
             val_ += rhs.val_;
-            der_ += rhs.der_;
+            for (int i = 0; i < N; ++i) {
+                der_[i] += rhs.der_[i];
+            }
         }
 
         void
@@ -83,20 +129,26 @@ namespace Opm
         operator -=(const AutoDiff& rhs)
         {
             val_ -= rhs.val_;
-            der_ -= rhs.der_;
+            for (int i = 0; i < N; ++i) {
+                der_[i] -= rhs.der_[i];
+            }
         }
 
         void
         operator *=(const Scalar& rhs)
         {
             val_ *= rhs;
-            der_ *= rhs;
+            for (int i = 0; i < N; ++i) {
+                der_[i] *= rhs;
+            }
         }
 
         void
         operator *=(const AutoDiff& rhs)
         {
-            der_   = der_*rhs.val_ + val_*rhs.der_;
+            for (int i = 0; i < N; ++i) {
+                der_[i] = der_[i]*rhs.val_ + val_*rhs.der_[i];
+            }
             val_  *= rhs.val_;
         }
 
@@ -104,199 +156,348 @@ namespace Opm
         operator /=(const Scalar& rhs)
         {
             val_ /= rhs;
-            der_ /= rhs;
+            for (int i = 0; i < N; ++i) {
+                der_[i] /= rhs;
+            }
         }
 
         void
         operator /=(const AutoDiff& rhs)
         {
-            der_   = (der_*rhs.val_ - val_*rhs.der_) / (rhs.val_ * rhs.val_);
+            const Scalar denom = rhs.val_ * rhs.val_;
+            for (int i = 0; i < N; ++i) {
+                der_[i] = (der_[i]*rhs.val_ - val_*rhs.der_[i]) / denom;
+            }
             val_  /= rhs.val_;
         }
 
+        AutoDiff
+        operator -() const
+        {
+            AutoDiff ret(-val_);
+            for (int i = 0; i < N; ++i) {
+                ret.der_[i] = -der_[i];
+            }
+            return ret;
+        }
+
         template <class Ostream>
         Ostream&
         print(Ostream& os) const
         {
-            os << "(x,dx) = (" << val_ << ',' << der_ << ")";
+            os << "(x,dx) = (" << val_;
+            for (int i = 0; i < N; ++i) {
+                os << ',' << der_[i];
+            }
+            os << ")";
 
             return os;
         }
 
         const Scalar val() const { return val_; }
-        const Scalar der() const { return der_; }
+        const Scalar der(const int i = 0) const { return der_[i]; }
+
+        /// Contiguous array of all N derivatives.
+        const Scalar* derivatives() const { return der_; }
 
     private:
-        AutoDiff(const Scalar x, const Scalar dx)
-            : val_(x), der_(dx)
-        {}
+        explicit AutoDiff(const Scalar x)
+            : val_(x)
+        {
+            for (int i = 0; i < N; ++i) {
+                der_[i] = Scalar(0);
+            }
+        }
 
         Scalar val_;
-        Scalar der_;
+        Scalar der_[N];
     };
 
 
-    template <class Ostream, typename Scalar>
+    template <class Ostream, typename Scalar, int N>
     Ostream&
-    operator<<(Ostream& os, const AutoDiff<Scalar>& fw)
+    operator<<(Ostream& os, const AutoDiff<Scalar, N>& fw)
     {
         return fw.print(os);
     }
 
-    template <typename Scalar>
-    AutoDiff<Scalar>
-    operator +(const AutoDiff<Scalar>& lhs,
-               const AutoDiff<Scalar>& rhs)
+    template <typename Scalar, int N>
+    AutoDiff<Scalar, N>
+    operator +(const AutoDiff<Scalar, N>& lhs,
+               const AutoDiff<Scalar, N>& rhs)
     {
-        AutoDiff<Scalar> ret = lhs;
+        AutoDiff<Scalar, N> ret = lhs;
         ret += rhs;
 
         return ret;
     }
 
-    template <typename Scalar, typename T>
-    AutoDiff<Scalar>
-    operator +(const T                lhs,
-               const AutoDiff<Scalar>& rhs)
+    template <typename Scalar, int N, typename T>
+    AutoDiff<Scalar, N>
+    operator +(const T                   lhs,
+               const AutoDiff<Scalar, N>& rhs)
     {
-        AutoDiff<Scalar> ret = rhs;
+        AutoDiff<Scalar, N> ret = rhs;
         ret += Scalar(lhs);
 
         return ret;
     }
 
-    template <typename Scalar, typename T>
-    AutoDiff<Scalar>
-    operator +(const AutoDiff<Scalar>& lhs,
-               const T                rhs)
+    template <typename Scalar, int N, typename T>
+    AutoDiff<Scalar, N>
+    operator +(const AutoDiff<Scalar, N>& lhs,
+               const T                   rhs)
     {
-        AutoDiff<Scalar> ret = lhs;
+        AutoDiff<Scalar, N> ret = lhs;
         ret += Scalar(rhs);
 
         return ret;
     }
 
-    template <typename Scalar>
-    AutoDiff<Scalar>
-    operator -(const AutoDiff<Scalar>& lhs,
-               const AutoDiff<Scalar>& rhs)
+    template <typename Scalar, int N>
+    AutoDiff<Scalar, N>
+    operator -(const AutoDiff<Scalar, N>& lhs,
+               const AutoDiff<Scalar, N>& rhs)
     {
-        AutoDiff<Scalar> ret = lhs;
+        AutoDiff<Scalar, N> ret = lhs;
         ret -= rhs;
 
         return ret;
     }
 
-    template <typename Scalar, typename T>
-    AutoDiff<Scalar>
-    operator -(const T                lhs,
-               const AutoDiff<Scalar>& rhs)
+    template <typename Scalar, int N, typename T>
+    AutoDiff<Scalar, N>
+    operator -(const T                   lhs,
+               const AutoDiff<Scalar, N>& rhs)
     {
-        return AutoDiff<Scalar>::function(Scalar(lhs) - rhs.val(), -rhs.der());
+        AutoDiff<Scalar, N> ret = -rhs;
+        ret += Scalar(lhs);
+
+        return ret;
     }
 
-    template <typename Scalar, typename T>
-    AutoDiff<Scalar>
-    operator -(const AutoDiff<Scalar>& lhs,
-               const T                rhs)
+    template <typename Scalar, int N, typename T>
+    AutoDiff<Scalar, N>
+    operator -(const AutoDiff<Scalar, N>& lhs,
+               const T                   rhs)
     {
-        AutoDiff<Scalar> ret = lhs;
+        AutoDiff<Scalar, N> ret = lhs;
         ret -= Scalar(rhs);
 
         return ret;
     }
 
-    template <typename Scalar>
-    AutoDiff<Scalar>
-    operator *(const AutoDiff<Scalar>& lhs,
-               const AutoDiff<Scalar>& rhs)
+    template <typename Scalar, int N>
+    AutoDiff<Scalar, N>
+    operator *(const AutoDiff<Scalar, N>& lhs,
+               const AutoDiff<Scalar, N>& rhs)
     {
-        AutoDiff<Scalar> ret = lhs;
+        AutoDiff<Scalar, N> ret = lhs;
         ret *= rhs;
 
         return ret;
     }
 
-    template <typename Scalar, typename T>
-    AutoDiff<Scalar>
-    operator *(const T                lhs,
-               const AutoDiff<Scalar>& rhs)
+    template <typename Scalar, int N, typename T>
+    AutoDiff<Scalar, N>
+    operator *(const T                   lhs,
+               const AutoDiff<Scalar, N>& rhs)
     {
-        AutoDiff<Scalar> ret = rhs;
+        AutoDiff<Scalar, N> ret = rhs;
         ret *= Scalar(lhs);
 
         return ret;
     }
 
-    template <typename Scalar, typename T>
-    AutoDiff<Scalar>
-    operator *(const AutoDiff<Scalar>& lhs,
-               const T                rhs)
+    template <typename Scalar, int N, typename T>
+    AutoDiff<Scalar, N>
+    operator *(const AutoDiff<Scalar, N>& lhs,
+               const T                   rhs)
     {
-        AutoDiff<Scalar> ret = lhs;
+        AutoDiff<Scalar, N> ret = lhs;
         ret *= Scalar(rhs);
 
         return ret;
     }
 
-    template <typename Scalar>
-    AutoDiff<Scalar>
-    operator /(const AutoDiff<Scalar>& lhs,
-               const AutoDiff<Scalar>& rhs)
+    template <typename Scalar, int N>
+    AutoDiff<Scalar, N>
+    operator /(const AutoDiff<Scalar, N>& lhs,
+               const AutoDiff<Scalar, N>& rhs)
     {
-        AutoDiff<Scalar> ret = lhs;
+        AutoDiff<Scalar, N> ret = lhs;
         ret /= rhs;
 
         return ret;
     }
 
-    template <typename Scalar, typename T>
-    AutoDiff<Scalar>
-    operator /(const T                lhs,
-               const AutoDiff<Scalar>& rhs)
+    template <typename Scalar, int N, typename T>
+    AutoDiff<Scalar, N>
+    operator /(const T                   lhs,
+               const AutoDiff<Scalar, N>& rhs)
     {
         Scalar a =  Scalar(lhs) / rhs.val();
         Scalar b = -Scalar(lhs) / (rhs.val() * rhs.val());
 
-        return AutoDiff<Scalar>::function(a, b);
+        return AutoDiff<Scalar, N>::chain(a, b, rhs);
+    }
+
+    template <typename Scalar, int N, typename T>
+    AutoDiff<Scalar, N>
+    operator /(const AutoDiff<Scalar, N>& lhs,
+               const T                   rhs)
+    {
+        AutoDiff<Scalar, N> ret = lhs;
+        ret /= Scalar(rhs);
+
+        return ret;
     }
 
-    template <typename Scalar, typename T>
-    AutoDiff<Scalar>
-    operator /(const AutoDiff<Scalar>& lhs,
-               const T                rhs)
+    template <typename Scalar, int N>
+    AutoDiff<Scalar, N>
+    cos(const AutoDiff<Scalar, N>& x)
     {
-        Scalar a = lhs.val() / Scalar(rhs);
-        Scalar b = lhs.der() / Scalar(rhs);
+        Scalar a =  std::cos(x.val());
+        Scalar b = -std::sin(x.val());
 
-        return AutoDiff<Scalar>::function(a, b);
+        return AutoDiff<Scalar, N>::chain(a, b, x);
     }
 
-    template <typename Scalar>
-    AutoDiff<Scalar>
-    cos(const AutoDiff<Scalar>& x)
+    template <typename Scalar, int N>
+    AutoDiff<Scalar, N>
+    sin(const AutoDiff<Scalar, N>& x)
     {
-        Scalar a = std::cos(x.val());
-        Scalar b = -std::sin(x.val()) * x.der();
+        Scalar a = std::sin(x.val());
+        Scalar b = std::cos(x.val());
 
-        return AutoDiff<Scalar>::function(a, b);
+        return AutoDiff<Scalar, N>::chain(a, b, x);
     }
 
-    template <typename Scalar>
-    AutoDiff<Scalar>
-    sqrt(const AutoDiff<Scalar>& x)
+    template <typename Scalar, int N>
+    AutoDiff<Scalar, N>
+    sqrt(const AutoDiff<Scalar, N>& x)
     {
         Scalar a = std::sqrt(x.val());
-        Scalar b = (Scalar(1.0) / (Scalar(2.0) * a)) * x.der();
+        Scalar b = Scalar(1.0) / (Scalar(2.0) * a);
+
+        return AutoDiff<Scalar, N>::chain(a, b, x);
+    }
+
+    template <typename Scalar, int N>
+    AutoDiff<Scalar, N>
+    exp(const AutoDiff<Scalar, N>& x)
+    {
+        Scalar a = std::exp(x.val());
+
+        return AutoDiff<Scalar, N>::chain(a, a, x);
+    }
+
+    template <typename Scalar, int N>
+    AutoDiff<Scalar, N>
+    log(const AutoDiff<Scalar, N>& x)
+    {
+        Scalar a = std::log(x.val());
+        Scalar b = Scalar(1.0) / x.val();
 
-        return AutoDiff<Scalar>::function(a, b);
+        return AutoDiff<Scalar, N>::chain(a, b, x);
+    }
+
+    template <typename Scalar, int N>
+    AutoDiff<Scalar, N>
+    abs(const AutoDiff<Scalar, N>& x)
+    {
+        return (x.val() < Scalar(0)) ? -x : x;
+    }
+
+    /// Power function with constant exponent, x^e.
+    template <typename Scalar, int N, typename T>
+    AutoDiff<Scalar, N>
+    pow(const AutoDiff<Scalar, N>& x, const T e)
+    {
+        Scalar a = std::pow(x.val(), Scalar(e));
+        Scalar b = Scalar(e) * std::pow(x.val(), Scalar(e) - Scalar(1.0));
+
+        return AutoDiff<Scalar, N>::chain(a, b, x);
+    }
+
+    /// Power function with constant base, b^x.
+    template <typename Scalar, int N, typename T>
+    AutoDiff<Scalar, N>
+    pow(const T base, const AutoDiff<Scalar, N>& x)
+    {
+        Scalar a = std::pow(Scalar(base), x.val());
+        Scalar b = a * std::log(Scalar(base));
+
+        return AutoDiff<Scalar, N>::chain(a, b, x);
+    }
+
+    /// Power function with variable base and exponent, x^e.
+    template <typename Scalar, int N>
+    AutoDiff<Scalar, N>
+    pow(const AutoDiff<Scalar, N>& x, const AutoDiff<Scalar, N>& e)
+    {
+        // x^e = exp(e log x)
+        return exp(e * log(x));
+    }
+
+    /// Minimum of two values.  The derivatives are taken from the
+    /// argument that is selected.
+    template <typename Scalar, int N>
+    AutoDiff<Scalar, N>
+    min(const AutoDiff<Scalar, N>& x, const AutoDiff<Scalar, N>& y)
+    {
+        return (y.val() < x.val()) ? y : x;
+    }
+
+    template <typename Scalar, int N, typename T>
+    AutoDiff<Scalar, N>
+    min(const AutoDiff<Scalar, N>& x, const T y)
+    {
+        return (Scalar(y) < x.val()) ? AutoDiff<Scalar, N>::constant(Scalar(y)) : x;
+    }
+
+    template <typename Scalar, int N, typename T>
+    AutoDiff<Scalar, N>
+    min(const T x, const AutoDiff<Scalar, N>& y)
+    {
+        return min(y, x);
+    }
+
+    /// Maximum of two values.  The derivatives are taken from the
+    /// argument that is selected.
+    template <typename Scalar, int N>
+    AutoDiff<Scalar, N>
+    max(const AutoDiff<Scalar, N>& x, const AutoDiff<Scalar, N>& y)
+    {
+        return (x.val() < y.val()) ? y : x;
+    }
+
+    template <typename Scalar, int N, typename T>
+    AutoDiff<Scalar, N>
+    max(const AutoDiff<Scalar, N>& x, const T y)
+    {
+        return (x.val() < Scalar(y)) ? AutoDiff<Scalar, N>::constant(Scalar(y)) : x;
+    }
+
+    template <typename Scalar, int N, typename T>
+    AutoDiff<Scalar, N>
+    max(const T x, const AutoDiff<Scalar, N>& y)
+    {
+        return max(y, x);
     }
 
 } // namespace Opm
 
 namespace std {
     using Opm::cos;
+    using Opm::sin;
     using Opm::sqrt;
+    using Opm::exp;
+    using Opm::log;
+    using Opm::abs;
+    using Opm::pow;
+    using Opm::min;
+    using Opm::max;
 }
 
 #endif  /* OPM_AUTODIFF_HPP_HEADER */
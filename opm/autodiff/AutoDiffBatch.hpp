@@ -0,0 +1,141 @@
+/*
+  Copyright 2014 SINTEF ICT, Applied Mathematics.
+
+  This file is part of the Open Porous Media Project (OPM).
+
+  OPM is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  OPM is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with OPM.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef OPM_AUTODIFFBATCH_HEADER_INCLUDED
+#define OPM_AUTODIFFBATCH_HEADER_INCLUDED
+
+#include <opm/autodiff/AutoDiff.hpp>
+
+#include <algorithm>
+#include <cassert>
+#include <vector>
+
+namespace Opm
+{
+
+    /// A batch of forward-mode AD values stored in
+    /// structure-of-arrays layout.
+    ///
+    /// The values of all n elements are stored contiguously, followed
+    /// by N contiguous arrays holding derivative number 0, 1, ..., N-1
+    /// of all elements. Kernels that sweep over many cells therefore
+    /// stream through memory with unit stride, which is what the
+    /// vectoriser wants, while individual elements can still be
+    /// extracted as (or assigned from) AutoDiff<Scalar, N> objects for
+    /// cell-local computations.
+    ///
+    /// Example: evaluating f for all cells at once
+    ///     AutoDiffBatch<double, 2> x = ..., y(x.size());
+    ///     for (int i = 0; i < x.size(); ++i) {
+    ///         y.assign(i, f(x[i]));
+    ///     }
+    template <typename Scalar, int N>
+    class AutoDiffBatch
+    {
+    public:
+        /// Element type.
+        typedef AutoDiff<Scalar, N> ADType;
+
+        /// Construct a batch of n constant zeros.
+        explicit AutoDiffBatch(const int n = 0)
+            : n_(n),
+              data_((N + 1) * n, Scalar(0))
+        {
+        }
+
+        /// Construct a batch of constants with the given values.
+        static AutoDiffBatch
+        constant(const std::vector<Scalar>& values)
+        {
+            AutoDiffBatch ret(values.size());
+            std::copy(values.begin(), values.end(), ret.data_.begin());
+            return ret;
+        }
+
+        /// Construct a batch of primary variables with the given
+        /// values; element i has unit derivative with respect to
+        /// variable number index, and zero for all others.
+        static AutoDiffBatch
+        variable(const std::vector<Scalar>& values, const int index)
+        {
+            assert(0 <= index && index < N);
+            AutoDiffBatch ret = constant(values);
+            Scalar* d = ret.derivative(index);
+            for (int i = 0; i < ret.n_; ++i) {
+                d[i] = Scalar(1);
+            }
+            return ret;
+        }
+
+        /// Number of elements.
+        int size() const { return n_; }
+
+        /// Change number of elements. Contents are not preserved.
+        void resize(const int n)
+        {
+            n_ = n;
+            data_.assign((N + 1) * n, Scalar(0));
+        }
+
+        /// Extract element i.
+        ADType operator[](const int i) const
+        {
+            assert(0 <= i && i < n_);
+            Scalar der[N];
+            for (int k = 0; k < N; ++k) {
+                der[k] = data_[(k + 1)*n_ + i];
+            }
+            return ADType::function(data_[i], der);
+        }
+
+        /// Assign element i.
+        void assign(const int i, const ADType& x)
+        {
+            assert(0 <= i && i < n_);
+            data_[i] = x.val();
+            const Scalar* der = x.derivatives();
+            for (int k = 0; k < N; ++k) {
+                data_[(k + 1)*n_ + i] = der[k];
+            }
+        }
+
+        /// Contiguous array of the values of all elements.
+        const Scalar* value() const { return &data_[0]; }
+        Scalar* value() { return &data_[0]; }
+
+        /// Contiguous array of derivative number k of all elements.
+        const Scalar* derivative(const int k) const
+        {
+            assert(0 <= k && k < N);
+            return &data_[(k + 1)*n_];
+        }
+        Scalar* derivative(const int k)
+        {
+            assert(0 <= k && k < N);
+            return &data_[(k + 1)*n_];
+        }
+
+    private:
+        int n_;
+        std::vector<Scalar> data_;
+    };
+
+} // namespace Opm
+
+#endif // OPM_AUTODIFFBATCH_HEADER_INCLUDED
@@ -25,7 +25,10 @@
 #include <opm/core/grid.h>
 #include <opm/core/utility/ErrorMacros.hpp>
 
+#include <algorithm>
+#include <cassert>
 #include <iostream>
+#include <utility>
 #include <vector>
 
 namespace Opm
@@ -44,6 +47,10 @@ struct HelperOps
     typedef Eigen::Array<int, Eigen::Dynamic, 1> IFaces;
     IFaces internal_faces;
 
+    /// The two neighbouring cells of each internal face.
+    typedef Eigen::Array<int, Eigen::Dynamic, 2, Eigen::RowMajor> TwoColInt;
+    TwoColInt nbi;
+
     /// Extract for each internal face the difference of its adjacent cells' values (first - second).
     M ngrad;
     /// Extract for each face the difference of its adjacent cells' values (second - first).
@@ -58,6 +65,11 @@ struct HelperOps
     /// Extract for each cell the sum of all its adjacent faces' (signed) values.
     M fulldiv;
 
+    /// Constructs empty operators, to be filled by e.g. readHelperOps().
+    HelperOps()
+    {
+    }
+
     /// Constructs all helper vectors and matrices.
     template<class Grid>
     HelperOps(const Grid& grid)
@@ -66,8 +78,6 @@ struct HelperOps
         const int nc = numCells(grid);
         const int nf = numFaces(grid);
         // Define some neighbourhood-derived helper arrays.
-        typedef Eigen::Array<int, Eigen::Dynamic, 2, Eigen::RowMajor> TwoColInt;
-        TwoColInt nbi;
         extractInternalFaces(grid, internal_faces, nbi);
         int num_internal=internal_faces.size();
 
@@ -107,47 +117,504 @@ struct HelperOps
     }
 };
 
+// -------------------- face-loop kernels --------------------
+
+namespace {
+
+    /// True if jac is square without off-diagonal entries, as is
+    /// the case for most per-cell Jacobian blocks.
+    inline bool isDiagonal(const HelperOps::M& jac)
+    {
+        typedef HelperOps::M M;
+        if (jac.rows() != jac.cols()) {
+            return false;
+        }
+        for (M::Index col = 0; col < jac.outerSize(); ++col) {
+            for (M::InnerIterator it(jac, col); it; ++it) {
+                if (it.index() != col) {
+                    return false;
+                }
+            }
+        }
+        return true;
+    }
+
+    /// Returns op * jac for a cell-to-face operator op, without a
+    /// general sparse product when jac is diagonal: the result is
+    /// then op with each column scaled by the diagonal element.
+    inline HelperOps::M cellToFaceJacobian(const HelperOps::M& op,
+                                           const HelperOps::M& jac)
+    {
+        typedef HelperOps::M M;
+        M res;
+        if (!isDiagonal(jac)) {
+            fastSparseProduct(op, jac, res);
+            return res;
+        }
+        res = M(op.rows(), op.cols());
+        res.reserve(op.nonZeros());
+        for (M::Index col = 0; col < op.outerSize(); ++col) {
+            res.startVec(col);
+            M::InnerIterator d(jac, col);
+            // Zero columns are dropped, as in fastSparseProduct().
+            if (d && d.value() != 0.0) {
+                for (M::InnerIterator it(op, col); it; ++it) {
+                    res.insertBackByOuterInnerUnordered(col, it.index()) = it.value() * d.value();
+                }
+            }
+        }
+        res.finalize();
+        return res;
+    }
+
+    /// Returns div * jac by scattering each internal face entry of
+    /// jac to its two neighbouring cells.
+    inline HelperOps::M faceToCellJacobian(const HelperOps& ops,
+                                           const HelperOps::M& jac)
+    {
+        typedef HelperOps::M M;
+        typedef M::Index Index;
+        const Index nc = ops.div.rows();
+        M res(nc, jac.cols());
+        res.reserve(2*jac.nonZeros());
+        std::vector<bool> mask(nc, false);
+        std::vector<double> values(nc);
+        std::vector<Index> indices;
+        indices.reserve(nc);
+        for (Index col = 0; col < jac.outerSize(); ++col) {
+            for (M::InnerIterator it(jac, col); it; ++it) {
+                const double v = it.value();
+                if (v == 0.0) {
+                    continue;
+                }
+                const int f = it.index();
+                const Index c[2] = { ops.nbi(f, 0), ops.nbi(f, 1) };
+                const double sv[2] = { v, -v };
+                for (int k = 0; k < 2; ++k) {
+                    if (mask[c[k]]) {
+                        values[c[k]] += sv[k];
+                    } else {
+                        mask[c[k]] = true;
+                        values[c[k]] = sv[k];
+                        indices.push_back(c[k]);
+                    }
+                }
+            }
+            std::sort(indices.begin(), indices.end());
+            res.startVec(col);
+            for (const Index c : indices) {
+                res.insertBackByOuterInnerUnordered(col, c) = values[c];
+                mask[c] = false;
+            }
+            indices.clear();
+        }
+        res.finalize();
+        return res;
+    }
+
+} // anon namespace
+
+
+
+/// Returns ops.ngrad * x, computed from the internal face neighbours.
+inline AutoDiffBlock<double>::V
+applyNGrad(const HelperOps& ops, const AutoDiffBlock<double>::V& x)
+{
+    const int nif = ops.nbi.rows();
+    AutoDiffBlock<double>::V res(nif);
+    for (int i = 0; i < nif; ++i) {
+        res[i] = x[ops.nbi(i, 0)] - x[ops.nbi(i, 1)];
+    }
+    return res;
+}
+
+/// Returns ops.ngrad * x, computed from the internal face neighbours.
+inline AutoDiffBlock<double>
+applyNGrad(const HelperOps& ops, const AutoDiffBlock<double>& x)
+{
+    typedef AutoDiffBlock<double> ADB;
+    ADB::V val = applyNGrad(ops, x.value());
+    std::vector<ADB::M> jac(x.numBlocks());
+    for (int block = 0; block < x.numBlocks(); ++block) {
+        jac[block] = cellToFaceJacobian(ops.ngrad, x.derivative()[block]);
+    }
+    return ADB::function(std::move(val), std::move(jac));
+}
+
+/// Returns ops.caver * x, computed from the internal face neighbours.
+inline AutoDiffBlock<double>::V
+applyCAver(const HelperOps& ops, const AutoDiffBlock<double>::V& x)
+{
+    const int nif = ops.nbi.rows();
+    AutoDiffBlock<double>::V res(nif);
+    for (int i = 0; i < nif; ++i) {
+        res[i] = 0.5 * (x[ops.nbi(i, 0)] + x[ops.nbi(i, 1)]);
+    }
+    return res;
+}
+
+/// Returns ops.caver * x, computed from the internal face neighbours.
+inline AutoDiffBlock<double>
+applyCAver(const HelperOps& ops, const AutoDiffBlock<double>& x)
+{
+    typedef AutoDiffBlock<double> ADB;
+    ADB::V val = applyCAver(ops, x.value());
+    std::vector<ADB::M> jac(x.numBlocks());
+    for (int block = 0; block < x.numBlocks(); ++block) {
+        jac[block] = cellToFaceJacobian(ops.caver, x.derivative()[block]);
+    }
+    return ADB::function(std::move(val), std::move(jac));
+}
+
+/// Returns ops.div * x, computed from the internal face neighbours.
+inline AutoDiffBlock<double>::V
+applyDiv(const HelperOps& ops, const AutoDiffBlock<double>::V& x)
+{
+    const int nif = ops.nbi.rows();
+    AutoDiffBlock<double>::V res = AutoDiffBlock<double>::V::Zero(ops.div.rows());
+    for (int i = 0; i < nif; ++i) {
+        res[ops.nbi(i, 0)] += x[i];
+        res[ops.nbi(i, 1)] -= x[i];
+    }
+    return res;
+}
+
+/// Returns ops.div * x, computed from the internal face neighbours.
+inline AutoDiffBlock<double>
+applyDiv(const HelperOps& ops, const AutoDiffBlock<double>& x)
+{
+    typedef AutoDiffBlock<double> ADB;
+    ADB::V val = applyDiv(ops, x.value());
+    std::vector<ADB::M> jac(x.numBlocks());
+    for (int block = 0; block < x.numBlocks(); ++block) {
+        jac[block] = faceToCellJacobian(ops, x.derivative()[block]);
+    }
+    return ADB::function(std::move(val), std::move(jac));
+}
+
+
+namespace detail {
+
+
+    /// Insert the (row, value) pairs of one column at the back of
+    /// res, which must be filled column by column. Sorts the pairs
+    /// by row unless they are known to be sorted already.
+    template <typename Scalar, class Matrix>
+    void insertColumn(const typename Matrix::Index col,
+                      std::vector<std::pair<typename Matrix::Index, Scalar> >& entries,
+                      const bool sorted,
+                      Matrix& res)
+    {
+        if (!sorted && entries.size() > 1) {
+            std::sort(entries.begin(), entries.end());
+        }
+        res.startVec(col);
+        for (const auto& e : entries) {
+            res.insertBackByOuterInnerUnordered(col, e.first) = e.second;
+        }
+        entries.clear();
+    }
+
+
+
+    /// Inverse of a row gather: for each row of the full matrix, the
+    /// rows of the gathered matrix it is copied to, in compressed
+    /// (start, target) form.
+    struct RowGatherMap
+    {
+        std::vector<int> start;
+        std::vector<int> target;
+        bool sorted; // True if the gathered rows are nondecreasing.
+    };
+
+    template <class IntVec>
+    void buildRowGatherMap(const int full_size,
+                           const IntVec& indices,
+                           RowGatherMap& map)
+    {
+        const int size = indices.size();
+        map.start.assign(full_size + 1, 0);
+        map.sorted = true;
+        for (int i = 0; i < size; ++i) {
+            ++map.start[indices[i] + 1];
+            if (i > 0 && indices[i] < indices[i - 1]) {
+                map.sorted = false;
+            }
+        }
+        for (int r = 0; r < full_size; ++r) {
+            map.start[r + 1] += map.start[r];
+        }
+        map.target.resize(size);
+        std::vector<int> pos(map.start.begin(), map.start.end() - 1);
+        for (int i = 0; i < size; ++i) {
+            map.target[pos[indices[i]]++] = i;
+        }
+    }
+
+    /// Returns the rows of jac selected by map, which must have been
+    /// built for jac.rows() rows.
+    template <typename Scalar>
+    typename AutoDiffBlock<Scalar>::M
+    gatherRows(const typename AutoDiffBlock<Scalar>::M& jac,
+               const RowGatherMap& map)
+    {
+        typedef typename AutoDiffBlock<Scalar>::M M;
+        typedef typename M::Index Index;
+        assert(Index(map.start.size()) == jac.rows() + 1);
+        M res(map.target.size(), jac.cols());
+        res.reserve(jac.nonZeros());
+        std::vector<std::pair<Index, Scalar> > entries;
+        for (Index col = 0; col < jac.outerSize(); ++col) {
+            for (typename M::InnerIterator it(jac, col); it; ++it) {
+                const Index r = it.index();
+                for (int k = map.start[r]; k < map.start[r + 1]; ++k) {
+                    entries.emplace_back(map.target[k], it.value());
+                }
+            }
+            insertColumn(col, entries, map.sorted, res);
+        }
+        res.finalize();
+        return res;
+    }
+
+    /// Returns the rows jac(indices, :) without forming a selection
+    /// matrix. Rows may be repeated and appear in any order.
+    template <typename Scalar, class IntVec>
+    typename AutoDiffBlock<Scalar>::M
+    subsetRows(const typename AutoDiffBlock<Scalar>::M& jac,
+               const IntVec& indices)
+    {
+        RowGatherMap map;
+        buildRowGatherMap(jac.rows(), indices, map);
+        return gatherRows<Scalar>(jac, map);
+    }
+
+
+
+    /// Returns the columns jac(:, cols).
+    template <typename Scalar, class IntVec>
+    typename AutoDiffBlock<Scalar>::M
+    subsetColumns(const typename AutoDiffBlock<Scalar>::M& jac,
+                  const IntVec& cols)
+    {
+        typedef typename AutoDiffBlock<Scalar>::M M;
+        const int n = cols.size();
+        M res(jac.rows(), n);
+        res.reserve(jac.nonZeros());
+        for (int j = 0; j < n; ++j) {
+            res.startVec(j);
+            for (typename M::InnerIterator it(jac, cols[j]); it; ++it) {
+                res.insertBack(it.row(), j) = it.value();
+            }
+        }
+        res.finalize();
+        return res;
+    }
+
+
+
+    /// True if the indices are unique and in [0, n).
+    template <class IntVec>
+    bool uniqueIndices(const IntVec& indices, const int n)
+    {
+        std::vector<bool> seen(n, false);
+        for (int i = 0; i < int(indices.size()); ++i) {
+            const int r = indices[i];
+            if (r < 0 || r >= n || seen[r]) {
+                return false;
+            }
+            seen[r] = true;
+        }
+        return true;
+    }
+
+
+
+    /// Returns a matrix with n rows, where row indices[i] is row i
+    /// of jac and all other rows are zero. The indices must be
+    /// unique, see supersetSumRows() otherwise.
+    template <typename Scalar, class IntVec>
+    typename AutoDiffBlock<Scalar>::M
+    supersetRows(const typename AutoDiffBlock<Scalar>::M& jac,
+                 const IntVec& indices,
+                 const int n)
+    {
+        typedef typename AutoDiffBlock<Scalar>::M M;
+        typedef typename M::Index Index;
+        assert(Index(indices.size()) == jac.rows());
+        assert(uniqueIndices(indices, n));
+        bool sorted = true;
+        for (Index i = 1; i < Index(indices.size()); ++i) {
+            if (indices[i] < indices[i - 1]) {
+                sorted = false;
+                break;
+            }
+        }
+
+        M res(n, jac.cols());
+        res.reserve(jac.nonZeros());
+        std::vector<std::pair<Index, Scalar> > entries;
+        for (Index col = 0; col < jac.outerSize(); ++col) {
+            for (typename M::InnerIterator it(jac, col); it; ++it) {
+                entries.emplace_back(indices[it.index()], it.value());
+            }
+            insertColumn(col, entries, sorted, res);
+        }
+        res.finalize();
+        return res;
+    }
+
+
+
+    /// Returns a matrix with n rows, where row r is the sum of the
+    /// rows i of jac with indices[i] == r. The indices may repeat.
+    template <typename Scalar, class IntVec>
+    typename AutoDiffBlock<Scalar>::M
+    supersetSumRows(const typename AutoDiffBlock<Scalar>::M& jac,
+                    const IntVec& indices,
+                    const int n)
+    {
+        typedef typename AutoDiffBlock<Scalar>::M M;
+        typedef typename M::Index Index;
+        assert(Index(indices.size()) == jac.rows());
+        bool sorted = true;
+        for (Index i = 1; i < Index(indices.size()); ++i) {
+            if (indices[i] < indices[i - 1]) {
+                sorted = false;
+                break;
+            }
+        }
+
+        M res(n, jac.cols());
+        res.reserve(jac.nonZeros());
+        std::vector<std::pair<Index, Scalar> > entries;
+        for (Index col = 0; col < jac.outerSize(); ++col) {
+            for (typename M::InnerIterator it(jac, col); it; ++it) {
+                entries.emplace_back(indices[it.index()], it.value());
+            }
+            if (!sorted && entries.size() > 1) {
+                std::sort(entries.begin(), entries.end());
+            }
+            // Merge the entries of repeated rows, now adjacent.
+            std::size_t last = 0;
+            for (std::size_t k = 1; k < entries.size(); ++k) {
+                if (entries[k].first == entries[last].first) {
+                    entries[last].second += entries[k].second;
+                } else {
+                    entries[++last] = entries[k];
+                }
+            }
+            if (!entries.empty()) {
+                entries.resize(last + 1);
+            }
+            insertColumn(col, entries, true, res);
+        }
+        res.finalize();
+        return res;
+    }
+
+
+
+    /// Returns the matrix whose rows are taken from jac1 where
+    /// take_first is true and from jac2 elsewhere.
+    template <typename Scalar>
+    typename AutoDiffBlock<Scalar>::M
+    selectRows(const typename AutoDiffBlock<Scalar>::M& jac1,
+               const typename AutoDiffBlock<Scalar>::M& jac2,
+               const std::vector<bool>& take_first)
+    {
+        typedef typename AutoDiffBlock<Scalar>::M M;
+        typedef typename M::Index Index;
+        assert(jac1.rows() == jac2.rows() && jac1.cols() == jac2.cols());
+
+        M res(jac1.rows(), jac1.cols());
+        res.reserve(std::max(jac1.nonZeros(), jac2.nonZeros()));
+        for (Index col = 0; col < jac1.outerSize(); ++col) {
+            res.startVec(col);
+            // Merge the two sorted columns.
+            typename M::InnerIterator it1(jac1, col), it2(jac2, col);
+            for (;;) {
+                while (it1 && !take_first[it1.index()]) { ++it1; }
+                while (it2 && take_first[it2.index()]) { ++it2; }
+                if (!it1 && !it2) {
+                    break;
+                }
+                if (it1 && (!it2 || it1.index() < it2.index())) {
+                    res.insertBackByOuterInnerUnordered(col, it1.index()) = it1.value();
+                    ++it1;
+                } else {
+                    res.insertBackByOuterInnerUnordered(col, it2.index()) = it2.value();
+                    ++it2;
+                }
+            }
+        }
+        res.finalize();
+        return res;
+    }
+
+} // namespace detail
+
+
+
 // -------------------- upwinding helper class --------------------
 
 
     /// Upwind selection in absence of counter-current flow (i.e.,
     /// without effects of gravity and/or capillary pressure).
+    ///
+    /// The selector stores the upwind cell of each internal face and
+    /// gathers values and Jacobian rows directly. A selector kept
+    /// between Newton iterations can be refreshed with update(),
+    /// which does no further work when no face changed direction.
     template <typename Scalar>
     class UpwindSelector {
     public:
         typedef AutoDiffBlock<Scalar> ADB;
 
+        /// Construct an empty selector, to be set up by update().
+        UpwindSelector()
+            : num_cells_(0)
+        {
+        }
+
         template<class Grid>
         UpwindSelector(const Grid& g,
                        const HelperOps&        h,
                        const typename ADB::V&  ifaceflux)
+            : num_cells_(AutoDiffGrid::numCells(g))
+        {
+            update(h, ifaceflux);
+        }
+
+        /// Recompute the upwind cells from a new internal face flux.
+        /// \return true if the upwind cell of any face changed.
+        bool update(const HelperOps&        h,
+                    const typename ADB::V&  ifaceflux)
         {
-            using namespace AutoDiffGrid;
             typedef HelperOps::IFaces::Index IFIndex;
             const IFIndex nif = h.internal_faces.size();
-            typename ADFaceCellTraits<Grid>::Type
-                face_cells = faceCellsToEigen(g);
             assert(nif == ifaceflux.size());
+            assert(nif == h.nbi.rows());
 
-            // Define selector structure.
-            typedef typename Eigen::Triplet<Scalar> Triplet;
-            std::vector<Triplet> s;  s.reserve(nif);
+            const int nc = h.div.rows();
+            bool changed = (IFIndex(upwind_cells_.size()) != nif) || (num_cells_ != nc);
+            upwind_cells_.resize(nif);
+            num_cells_ = nc;
             for (IFIndex iface = 0; iface < nif; ++iface) {
-                const int f  = h.internal_faces[iface];
-                const int c1 = face_cells(f,0);
-                const int c2 = face_cells(f,1);
-
-                assert ((c1 >= 0) && (c2 >= 0));
+                assert ((h.nbi(iface, 0) >= 0) && (h.nbi(iface, 1) >= 0));
 
                 // Select upwind cell.
-                const int c = (ifaceflux[iface] >= 0) ? c1 : c2;
-
-                s.push_back(Triplet(iface, c, Scalar(1)));
+                const int c = (ifaceflux[iface] >= 0) ? h.nbi(iface, 0) : h.nbi(iface, 1);
+                if (c != upwind_cells_[iface]) {
+                    upwind_cells_[iface] = c;
+                    changed = true;
+                }
             }
 
-            // Assemble explicit selector operator.
-            select_.resize(nif, numCells(g));
-            select_.setFromTriplets(s.begin(), s.end());
+            if (changed) {
+                detail::buildRowGatherMap(num_cells_, upwind_cells_, gather_);
+            }
+            return changed;
         }
 
         /// Apply selector to multiple per-cell quantities.
@@ -161,7 +628,7 @@ struct HelperOps
             for (typename std::vector<ADB>::const_iterator
                      b = xc.begin(), e = xc.end(); b != e; ++b)
             {
-                xf.push_back(select_ * (*b));
+                xf.push_back(select(*b));
             }
 
             return xf;
@@ -170,38 +637,41 @@ struct HelperOps
         /// Apply selector to single per-cell ADB quantity.
         ADB select(const ADB& xc) const
         {
-            return select_*xc;
+            typename ADB::V val = select(xc.value());
+            const int num_blocks = xc.numBlocks();
+            std::vector<typename ADB::M> jac(num_blocks);
+            for (int block = 0; block < num_blocks; ++block) {
+                jac[block] = detail::gatherRows<Scalar>(xc.derivative()[block], gather_);
+            }
+            return ADB::function(std::move(val), std::move(jac));
         }
 
         /// Apply selector to single per-cell constant quantity.
         typename ADB::V select(const typename ADB::V& xc) const
         {
-            return (select_*xc.matrix()).array();
+            assert(xc.size() == num_cells_);
+            const int nif = upwind_cells_.size();
+            typename ADB::V xf(nif);
+            for (int iface = 0; iface < nif; ++iface) {
+                xf[iface] = xc[upwind_cells_[iface]];
+            }
+            return xf;
+        }
+
+        /// The upwind cell of each internal face.
+        const std::vector<int>& upwindCells() const
+        {
+            return upwind_cells_;
         }
 
     private:
-        typename ADB::M select_;
+        std::vector<int> upwind_cells_;
+        detail::RowGatherMap     gather_;
+        int              num_cells_;
     };
 
 
 
-namespace {
-
-
-    template <typename Scalar, class IntVec>
-    typename AutoDiffBlock<Scalar>::M
-    constructSupersetSparseMatrix(const int full_size, const IntVec& indices)
-    {
-        const int subset_size = indices.size();
-        typename AutoDiffBlock<Scalar>::M mat(full_size, subset_size);
-        mat.reserve(Eigen::VectorXi::Constant(subset_size, 1));
-        for (int i = 0; i < subset_size; ++i) {
-            mat.insert(indices[i], i) = 1;
-        }
-        return mat;
-    }
-
-} // anon namespace
 
 
 
@@ -221,37 +691,124 @@ subset(const Eigen::Array<Scalar, Eigen::Dynamic, 1>& x,
 }
 
 /// Returns x(indices).
+/// Gathers values and Jacobian rows directly, without a selection matrix.
 template <typename Scalar, class IntVec>
 AutoDiffBlock<Scalar>
 subset(const AutoDiffBlock<Scalar>& x,
        const IntVec& indices)
 {
-    const typename AutoDiffBlock<Scalar>::M sub
-        = constructSupersetSparseMatrix<Scalar>(x.value().size(), indices).transpose();
-    return sub * x;
+    typedef AutoDiffBlock<Scalar> ADB;
+    typename ADB::V val = subset(x.value(), indices);
+    const int num_blocks = x.numBlocks();
+    std::vector<typename ADB::M> jac(num_blocks);
+    for (int block = 0; block < num_blocks; ++block) {
+        jac[block] = detail::subsetRows<Scalar>(x.derivative()[block], indices);
+    }
+    return ADB::function(std::move(val), std::move(jac));
 }
 
 
 /// Returns v where v(indices) == x, v(!indices) == 0 and v.size() == n.
+/// The indices must be unique, use supersetSum() for repeated indices.
 template <typename Scalar, class IntVec>
-AutoDiffBlock<Scalar>
-superset(const AutoDiffBlock<Scalar>& x,
+Eigen::Array<Scalar, Eigen::Dynamic, 1>
+superset(const Eigen::Array<Scalar, Eigen::Dynamic, 1>& x,
          const IntVec& indices,
          const int n)
 {
-    return constructSupersetSparseMatrix<Scalar>(n, indices) * x;
+    typedef typename Eigen::Array<Scalar, Eigen::Dynamic, 1>::Index Index;
+    assert(detail::uniqueIndices(indices, n));
+    const Index size = indices.size();
+    Eigen::Array<Scalar, Eigen::Dynamic, 1> ret = Eigen::Array<Scalar, Eigen::Dynamic, 1>::Zero(n);
+    for( Index i=0; i<size; ++i )
+        ret[ indices[ i ] ] = x[ i ];
+
+    return ret;
 }
 
 
 
 /// Returns v where v(indices) == x, v(!indices) == 0 and v.size() == n.
+/// Scatters values and Jacobian rows directly, without a selection matrix.
+/// The indices must be unique, use supersetSum() for repeated indices.
 template <typename Scalar, class IntVec>
-Eigen::Array<Scalar, Eigen::Dynamic, 1>
-superset(const Eigen::Array<Scalar, Eigen::Dynamic, 1>& x,
+AutoDiffBlock<Scalar>
+superset(const AutoDiffBlock<Scalar>& x,
          const IntVec& indices,
          const int n)
 {
-    return constructSupersetSparseMatrix<Scalar>(n, indices) * x.matrix();
+    typedef AutoDiffBlock<Scalar> ADB;
+    typename ADB::V val = superset(x.value(), indices, n);
+    const int num_blocks = x.numBlocks();
+    std::vector<typename ADB::M> jac(num_blocks);
+    for (int block = 0; block < num_blocks; ++block) {
+        jac[block] = detail::supersetRows<Scalar>(x.derivative()[block], indices, n);
+    }
+    return ADB::function(std::move(val), std::move(jac));
+}
+
+
+
+/// Returns v with v.size() == n, where v[r] is the sum of the x[i]
+/// with indices[i] == r, and zero if there are none. Unlike superset(),
+/// the indices may repeat, e.g. perforations sharing a cell.
+template <typename Scalar, class IntVec>
+Eigen::Array<Scalar, Eigen::Dynamic, 1>
+supersetSum(const Eigen::Array<Scalar, Eigen::Dynamic, 1>& x,
+            const IntVec& indices,
+            const int n)
+{
+    typedef typename Eigen::Array<Scalar, Eigen::Dynamic, 1>::Index Index;
+    const Index size = indices.size();
+    Eigen::Array<Scalar, Eigen::Dynamic, 1> ret = Eigen::Array<Scalar, Eigen::Dynamic, 1>::Zero(n);
+    for( Index i=0; i<size; ++i )
+        ret[ indices[ i ] ] += x[ i ];
+
+    return ret;
+}
+
+
+
+/// Returns v with v.size() == n, where v[r] is the sum of the x[i]
+/// with indices[i] == r. Scatters values and Jacobian rows directly,
+/// without a selection matrix.
+template <typename Scalar, class IntVec>
+AutoDiffBlock<Scalar>
+supersetSum(const AutoDiffBlock<Scalar>& x,
+            const IntVec& indices,
+            const int n)
+{
+    typedef AutoDiffBlock<Scalar> ADB;
+    typename ADB::V val = supersetSum(x.value(), indices, n);
+    const int num_blocks = x.numBlocks();
+    std::vector<typename ADB::M> jac(num_blocks);
+    for (int block = 0; block < num_blocks; ++block) {
+        jac[block] = detail::supersetSumRows<Scalar>(x.derivative()[block], indices, n);
+    }
+    return ADB::function(std::move(val), std::move(jac));
+}
+
+
+
+/// Returns x with the Jacobian blocks 0, ..., num_blocks - 1
+/// restricted to the columns cols. A constant x, such as the well
+/// equations of a run without wells, is returned unchanged.
+template <typename Scalar, class IntVec>
+AutoDiffBlock<Scalar>
+restrictColumns(const AutoDiffBlock<Scalar>& x,
+                const int num_blocks,
+                const IntVec& cols)
+{
+    typedef AutoDiffBlock<Scalar> ADB;
+    if (x.derivative().empty()) {
+        return x;
+    }
+    assert(num_blocks <= x.numBlocks());
+    std::vector<typename ADB::M> jac = x.derivative();
+    for (int block = 0; block < num_blocks; ++block) {
+        jac[block] = detail::subsetColumns<Scalar>(jac[block], cols);
+    }
+    return ADB::function(typename ADB::V(x.value()), std::move(jac));
 }
 
 
@@ -294,6 +851,7 @@ spdiag(const AutoDiffBlock<double>::V& d)
             // Over-reserving so we do not have to count.
             left_elems_.reserve(n);
             right_elems_.reserve(n);
+            chooseleft_.resize(n);
             for (int i = 0; i < n; ++i) {
                 bool chooseleft = false;
                 switch (crit) {
@@ -318,6 +876,7 @@ spdiag(const AutoDiffBlock<double>::V& d)
                 default:
                     OPM_THROW(std::logic_error, "No such criterion: " << crit);
                 }
+                chooseleft_[i] = chooseleft;
                 if (chooseleft) {
                     left_elems_.push_back(i);
                 } else {
@@ -334,8 +893,19 @@ spdiag(const AutoDiffBlock<double>::V& d)
             } else if (left_elems_.empty()) {
                 return x2;
             } else {
-                return superset(subset(x1, left_elems_), left_elems_, x1.size())
-                    + superset(subset(x2, right_elems_), right_elems_, x2.size());
+                typename ADB::V val = select(x1.value(), x2.value());
+                // Either argument may be a constant without Jacobians.
+                const int num_blocks = std::max(x1.numBlocks(), x2.numBlocks());
+                std::vector<typename ADB::M> jac(num_blocks);
+                for (int block = 0; block < num_blocks; ++block) {
+                    const typename ADB::M& ref = x1.numBlocks() > 0
+                        ? x1.derivative()[block] : x2.derivative()[block];
+                    const typename ADB::M zero(ref.rows(), ref.cols());
+                    jac[block] = detail::selectRows<Scalar>(x1.numBlocks() > 0 ? x1.derivative()[block] : zero,
+                                                    x2.numBlocks() > 0 ? x2.derivative()[block] : zero,
+                                                    chooseleft_);
+                }
+                return ADB::function(std::move(val), std::move(jac));
             }
         }
 
@@ -347,14 +917,19 @@ spdiag(const AutoDiffBlock<double>::V& d)
             } else if (left_elems_.empty()) {
                 return x2;
             } else {
-                return superset(subset(x1, left_elems_), left_elems_, x1.size())
-                    + superset(subset(x2, right_elems_), right_elems_, x2.size());
+                const int n = x1.size();
+                typename ADB::V x(n);
+                for (int i = 0; i < n; ++i) {
+                    x[i] = chooseleft_[i] ? x1[i] : x2[i];
+                }
+                return x;
             }
         }
 
     private:
         std::vector<int> left_elems_;
         std::vector<int> right_elems_;
+        std::vector<bool> chooseleft_;
     };
 
 
@@ -0,0 +1,120 @@
+/*
+  Copyright 2015 SINTEF ICT, Applied Mathematics.
+
+  This file is part of the Open Porous Media project (OPM).
+
+  OPM is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  OPM is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with OPM.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef OPM_BLACKOILPHASECONFIGURATION_HEADER_INCLUDED
+#define OPM_BLACKOILPHASECONFIGURATION_HEADER_INCLUDED
+
+#include <opm/core/props/BlackoilPhases.hpp>
+
+namespace Opm
+{
+
+    /// Set of active phases and black-oil features known at compile
+    /// time. The oil phase is always active.
+    ///
+    /// Classes templated on a phase configuration (such as
+    /// FullyImplicitBlackoilSolver) use the constants below instead
+    /// of runtime flags, so that branches for inactive phases and
+    /// features are removed by the compiler.
+    template <bool WaterActive, bool GasActive, bool DisGas, bool VapOil>
+    struct StaticBlackoilPhaseConfiguration
+    {
+        static_assert(GasActive || !(DisGas || VapOil),
+                      "Dissolved gas and vaporized oil require an active gas phase.");
+
+        enum { IsStatic  = 1,
+               HasWater  = WaterActive,
+               HasGas    = GasActive,
+               HasDisgas = DisGas,
+               HasVapoil = VapOil,
+               NumPhases = 1 + int(WaterActive) + int(GasActive) };
+
+        /// \return true if canonical phase is active.
+        static bool active(const int phase)
+        {
+            return (phase == BlackoilPhases::Liquid)
+                || (WaterActive && phase == BlackoilPhases::Aqua)
+                || (GasActive   && phase == BlackoilPhases::Vapour);
+        }
+    };
+
+    /// Phase configuration determined at runtime from the deck. The
+    /// constants are placeholders, users must consult their runtime
+    /// flags when IsStatic is zero.
+    struct DynamicBlackoilPhaseConfiguration
+    {
+        enum { IsStatic  = 0,
+               HasWater  = 1,
+               HasGas    = 1,
+               HasDisgas = 1,
+               HasVapoil = 1,
+               NumPhases = -1 };
+
+        static bool active(const int /* phase */)
+        {
+            return true;
+        }
+    };
+
+    /// Two-phase oil-water.
+    typedef StaticBlackoilPhaseConfiguration<true, false, false, false> OilWaterConfiguration;
+    /// Three-phase dead oil with free gas.
+    typedef StaticBlackoilPhaseConfiguration<true, true, false, false>  DeadOilGasConfiguration;
+    /// Three-phase live oil (dissolved gas).
+    typedef StaticBlackoilPhaseConfiguration<true, true, true, false>   LiveOilConfiguration;
+    /// Three-phase live oil and wet gas (dissolved gas and vaporized oil).
+    typedef StaticBlackoilPhaseConfiguration<true, true, true, true>    LiveOilWetGasConfiguration;
+
+    /// Identifies the compile-time configuration matching a runtime
+    /// phase set.
+    enum BlackoilPhaseConfigurationId {
+        OilWaterConfigurationId,
+        DeadOilGasConfigurationId,
+        LiveOilConfigurationId,
+        LiveOilWetGasConfigurationId,
+        DynamicConfigurationId
+    };
+
+    /// Find the compile-time configuration matching the active
+    /// phases and the dissolved gas and vaporized oil flags. Returns
+    /// DynamicConfigurationId if there is no matching static configuration.
+    inline BlackoilPhaseConfigurationId
+    blackoilPhaseConfiguration(const PhaseUsage& pu,
+                               const bool has_disgas,
+                               const bool has_vapoil)
+    {
+        const bool water = pu.phase_used[BlackoilPhases::Aqua]   != 0;
+        const bool oil   = pu.phase_used[BlackoilPhases::Liquid] != 0;
+        const bool gas   = pu.phase_used[BlackoilPhases::Vapour] != 0;
+
+        if (!water || !oil) {
+            return DynamicConfigurationId;
+        }
+        if (!gas) {
+            return (has_disgas || has_vapoil) ? DynamicConfigurationId : OilWaterConfigurationId;
+        }
+        if (!has_disgas) {
+            return has_vapoil ? DynamicConfigurationId : DeadOilGasConfigurationId;
+        }
+        return has_vapoil ? LiveOilWetGasConfigurationId : LiveOilConfigurationId;
+    }
+
+} // namespace Opm
+
+#endif // OPM_BLACKOILPHASECONFIGURATION_HEADER_INCLUDED
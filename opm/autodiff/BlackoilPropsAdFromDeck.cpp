@@ -40,6 +40,11 @@
 #include <opm/parser/eclipse/Deck/Deck.hpp>
 #include <opm/parser/eclipse/EclipseState/EclipseState.hpp>
 
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <string>
+
 namespace Opm
 {
     // Making these typedef to make the code more readable.
@@ -47,6 +52,144 @@ namespace Opm
     typedef BlackoilPropsAdFromDeck::V V;
     typedef Eigen::Array<double, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor> Block;
 
+    namespace {
+
+        /// Multiply row i of mat by d(i), i.e. mat = diag(d) * mat,
+        /// without changing the sparsity pattern.
+        template <class Scale>
+        void scaleRows(const Scale& d, ADB::M& mat)
+        {
+            for (int col = 0; col < mat.outerSize(); ++col) {
+                for (ADB::M::InnerIterator it(mat, col); it; ++it) {
+                    it.valueRef() *= d(it.row());
+                }
+            }
+        }
+
+        /// Add diag(dfdx) * dx to the Jacobians jacs, for each block dx
+        /// of the Jacobian of x. Empty blocks of x are skipped, and
+        /// empty blocks of jacs are overwritten instead of summed.
+        template <class Scale>
+        void addChainRule(const Scale& dfdx, const ADB& x, std::vector<ADB::M>& jacs)
+        {
+            const int num_blocks = std::min(jacs.size(), x.derivative().size());
+            for (int block = 0; block < num_blocks; ++block) {
+                const ADB::M& dx = x.derivative()[block];
+                if (dx.nonZeros() == 0) {
+                    continue;
+                }
+                if (jacs[block].nonZeros() == 0) {
+                    jacs[block] = dx;
+                    scaleRows(dfdx, jacs[block]);
+                } else {
+                    ADB::M temp = dx;
+                    scaleRows(dfdx, temp);
+                    jacs[block] += temp;
+                }
+            }
+        }
+
+        /// Jacobians of f(x), given the values of df/dx.
+        std::vector<ADB::M> chainRule(const V& dfdx, const ADB& x)
+        {
+            std::vector<ADB::M> jacs(x.derivative());
+            for (ADB::M& jac : jacs) {
+                scaleRows(dfdx, jac);
+            }
+            return jacs;
+        }
+
+        /// Jacobians of f(x, y), given the values of df/dx and df/dy.
+        std::vector<ADB::M> chainRule(const V& dfdx, const ADB& x,
+                                      const V& dfdy, const ADB& y)
+        {
+            if (x.derivative().empty()) {
+                return chainRule(dfdy, y);
+            }
+            std::vector<ADB::M> jacs = chainRule(dfdx, x);
+            addChainRule(dfdy, y, jacs);
+            return jacs;
+        }
+
+        /// Check resampled dead oil or dry gas PVT against the PVT of
+        /// the input tables, by comparing b and mu at the midpoints
+        /// between the table pressures of every region. Returns false,
+        /// with a warning, if the largest relative deviation exceeds
+        /// the tolerance.
+        template <class Tables>
+        bool resampledPvtIsAccurate(const PvtInterface& original,
+                                    const PvtInterface& resampled,
+                                    const Tables& tables,
+                                    const double tolerance,
+                                    const std::string& keyword)
+        {
+            std::vector<double> p;
+            std::vector<int> region;
+            for (int regionIdx = 0; regionIdx < int(tables.size()); ++regionIdx) {
+                const std::vector<double>& press = tables[regionIdx].getPressureColumn();
+                for (int i = 0; i + 1 < int(press.size()); ++i) {
+                    p.push_back(0.5*(press[i] + press[i + 1]));
+                    region.push_back(regionIdx);
+                }
+            }
+            const int n = p.size();
+            if (n == 0) {
+                return true;
+            }
+            // Temperature and dissolution ratios are not used by dead PVT.
+            const std::vector<double> unused(n, 0.0);
+            std::vector<double> b0(n), b1(n), mu0(n), mu1(n), dp(n), dr(n);
+            original.b(n, region.data(), p.data(), unused.data(), unused.data(), b0.data(), dp.data(), dr.data());
+            resampled.b(n, region.data(), p.data(), unused.data(), unused.data(), b1.data(), dp.data(), dr.data());
+            original.mu(n, region.data(), p.data(), unused.data(), unused.data(), mu0.data(), dp.data(), dr.data());
+            resampled.mu(n, region.data(), p.data(), unused.data(), unused.data(), mu1.data(), dp.data(), dr.data());
+            double deviation = 0.0;
+            for (int i = 0; i < n; ++i) {
+                deviation = std::max(deviation, std::fabs(b1[i] - b0[i]) / std::fabs(b0[i]));
+                deviation = std::max(deviation, std::fabs(mu1[i] - mu0[i]) / std::fabs(mu0[i]));
+            }
+            if (deviation > tolerance) {
+                std::cerr << "Warning: resampled " << keyword << " tables deviate by " << deviation
+                          << " (relative) from the input tables, more than the tolerance "
+                          << tolerance << ". Using the input tables." << std::endl;
+                return false;
+            }
+            return true;
+        }
+
+        /// Jacobians of the saturation function f = value(phase1_pos) of
+        /// the active saturations s, given the derivatives in Fortran
+        /// order as returned by SaturationPropsInterface. Derivatives
+        /// that are zero in all cells (e.g. dkrw/dsg) are skipped.
+        std::vector<ADB::M> saturationChainRule(const Block& deriv,
+                                                const int phase1_pos,
+                                                const PhaseUsage& pu,
+                                                const ADB* const s[3])
+        {
+            const int n = deriv.rows();
+            const int np = pu.num_phases;
+            const ADB& s1 = *s[BlackoilPhases::Liquid];
+            const int num_blocks = s1.numBlocks();
+            std::vector<ADB::M> jacs(num_blocks);
+            for (int block = 0; block < num_blocks; ++block) {
+                jacs[block] = ADB::M(n, s1.derivative()[block].cols());
+            }
+            for (int phase2 = 0; phase2 < 3; ++phase2) {
+                if (!pu.phase_used[phase2]) {
+                    continue;
+                }
+                const int phase2_pos = pu.phase_pos[phase2];
+                const int column = phase1_pos + np*phase2_pos; // Recall: Fortran ordering from the saturation functions
+                if ((deriv.col(column) == 0.0).all()) {
+                    continue;
+                }
+                addChainRule(deriv.col(column), *s[phase2], jacs);
+            }
+            return jacs;
+        }
+
+    } // anonymous namespace
+
     /// Constructor wrapping an opm-core black oil interface.
     BlackoilPropsAdFromDeck::BlackoilPropsAdFromDeck(Opm::DeckConstPtr deck,
                                                      Opm::EclipseStateConstPtr eclState,
@@ -70,6 +213,35 @@ namespace Opm
     }
 #endif
 
+    /// Constructor wrapping an opm-core black oil interface, with options.
+    BlackoilPropsAdFromDeck::BlackoilPropsAdFromDeck(Opm::DeckConstPtr deck,
+                                                     Opm::EclipseStateConstPtr eclState,
+                                                     const UnstructuredGrid& grid,
+                                                     const parameter::ParameterGroup& param,
+                                                     const bool init_rock)
+    {
+        init(deck, eclState, grid.number_of_cells, grid.global_cell, grid.cartdims,
+             grid.cell_centroids, grid.dimensions, init_rock,
+             param.getDefault("pvt_tab_size", 0),
+             param.getDefault("pvt_tab_tolerance", 1e-3));
+    }
+
+#ifdef HAVE_DUNE_CORNERPOINT
+    /// Constructor wrapping an opm-core black oil interface, with options.
+    BlackoilPropsAdFromDeck::BlackoilPropsAdFromDeck(Opm::DeckConstPtr deck,
+                                                     Opm::EclipseStateConstPtr eclState,
+                                                     const Dune::CpGrid& grid,
+                                                     const parameter::ParameterGroup& param,
+                                                     const bool init_rock )
+    {
+        init(deck, eclState, grid.numCells(), static_cast<const int*>(&grid.globalCell()[0]),
+             static_cast<const int*>(&grid.logicalCartesianSize()[0]),
+             grid.beginCellCentroids(), Dune::CpGrid::dimension, init_rock,
+             param.getDefault("pvt_tab_size", 0),
+             param.getDefault("pvt_tab_tolerance", 1e-3));
+    }
+#endif
+
 /// Constructor for properties on a subgrid
 BlackoilPropsAdFromDeck::BlackoilPropsAdFromDeck(const BlackoilPropsAdFromDeck& props,
                                                  const int number_of_cells)
@@ -90,6 +262,7 @@ BlackoilPropsAdFromDeck::BlackoilPropsAdFromDeck(const BlackoilPropsAdFromDeck&
     vap1_             = props.vap1_;
     vap2_             = props.vap2_;
     vap_satmax_guard_ = props.vap_satmax_guard_;
+    single_pvt_region_ = props.single_pvt_region_;
     // For data that is dependant on the subgrid we simply allocate space
     // and initialize with obviously bogus numbers.
     cellPvtRegionIdx_.resize(number_of_cells, std::numeric_limits<int>::min());
@@ -104,11 +277,15 @@ BlackoilPropsAdFromDeck::BlackoilPropsAdFromDeck(const BlackoilPropsAdFromDeck&
                                        const int* cart_dims,
                                        const CentroidIterator& begin_cell_centroids,
                                        int dimension,
-                                       const bool init_rock)
+                                       const bool init_rock,
+                                       const int pvt_tab_size,
+                                       const double pvt_tab_tolerance)
     {
         // retrieve the cell specific PVT table index from the deck
         // and using the grid...
         extractPvtTableIndex(cellPvtRegionIdx_, deck, number_of_cells, global_cell);
+        single_pvt_region_ = std::all_of(cellPvtRegionIdx_.begin(), cellPvtRegionIdx_.end(),
+                                         [](const int region) { return region == 0; });
 
         if (init_rock){
             rock_.init(eclState, number_of_cells, global_cell, cart_dims);
@@ -138,8 +315,6 @@ BlackoilPropsAdFromDeck::BlackoilPropsAdFromDeck(const BlackoilPropsAdFromDeck&
             }
         }
 
-        const int numSamples = 0;
-
         // Resize the property objects container
         props_.resize(phase_usage_.num_phases);
 
@@ -168,14 +343,15 @@ BlackoilPropsAdFromDeck::BlackoilPropsAdFromDeck(const BlackoilPropsAdFromDeck&
             const auto& pvdoTables = eclState->getPvdoTables();
             const auto& pvtoTables = eclState->getPvtoTables();
             if (!pvdoTables.empty()) {
-                if (numSamples > 0) {
+                auto pvdo = std::shared_ptr<PvtDead>(new PvtDead);
+                pvdo->initFromOil(pvdoTables);
+                props_[phase_usage_.phase_pos[Liquid]] = pvdo;
+                if (pvt_tab_size > 0) {
                     auto splinePvdo = std::shared_ptr<PvtDeadSpline>(new PvtDeadSpline);
-                    splinePvdo->initFromOil(pvdoTables, numSamples);
-                    props_[phase_usage_.phase_pos[Liquid]] = splinePvdo;
-                } else {
-                    auto pvdo = std::shared_ptr<PvtDead>(new PvtDead);
-                    pvdo->initFromOil(pvdoTables);
-                    props_[phase_usage_.phase_pos[Liquid]] = pvdo;
+                    splinePvdo->initFromOil(pvdoTables, pvt_tab_size);
+                    if (resampledPvtIsAccurate(*pvdo, *splinePvdo, pvdoTables, pvt_tab_tolerance, "PVDO")) {
+                        props_[phase_usage_.phase_pos[Liquid]] = splinePvdo;
+                    }
                 }
             } else if (!pvtoTables.empty()) {
                 std::shared_ptr<PvtLiveOil> pvto(new PvtLiveOil(pvtoTables));
@@ -202,14 +378,15 @@ BlackoilPropsAdFromDeck::BlackoilPropsAdFromDeck(const BlackoilPropsAdFromDeck&
             const auto& pvdgTables = eclState->getPvdgTables();
             const auto& pvtgTables = eclState->getPvtgTables();
             if (!pvdgTables.empty()) {
-                if (numSamples > 0) {
+                std::shared_ptr<PvtDead> deadPvt(new PvtDead);
+                deadPvt->initFromGas(pvdgTables);
+                props_[phase_usage_.phase_pos[Vapour]] = deadPvt;
+                if (pvt_tab_size > 0) {
                     std::shared_ptr<PvtDeadSpline> splinePvt(new PvtDeadSpline);
-                    splinePvt->initFromGas(pvdgTables, numSamples);
-                    props_[phase_usage_.phase_pos[Vapour]] = splinePvt;
-                } else {
-                    std::shared_ptr<PvtDead> deadPvt(new PvtDead);
-                    deadPvt->initFromGas(pvdgTables);
-                    props_[phase_usage_.phase_pos[Vapour]] = deadPvt;
+                    splinePvt->initFromGas(pvdgTables, pvt_tab_size);
+                    if (resampledPvtIsAccurate(*deadPvt, *splinePvt, pvdgTables, pvt_tab_tolerance, "PVDG")) {
+                        props_[phase_usage_.phase_pos[Vapour]] = splinePvt;
+                    }
                 }
             } else if (!pvtgTables.empty()) {
                 props_[phase_usage_.phase_pos[Vapour]].reset(new PvtLiveGas(pvtgTables));
@@ -322,26 +499,17 @@ BlackoilPropsAdFromDeck::BlackoilPropsAdFromDeck(const BlackoilPropsAdFromDeck&
             OPM_THROW(std::runtime_error, "Cannot call muWat(): water phase not present.");
         }
         const int n = cells.size();
-        mapPvtRegions(cells);
+        std::vector<int> region_buffer;
+        const int* pvt_region = pvtRegions(cells, region_buffer);
         assert(pw.size() == n);
         V mu(n);
         V dmudp(n);
         V dmudr(n);
         const double* rs = 0;
 
-        props_[phase_usage_.phase_pos[Water]]->mu(n, pvt_region_.data(), pw.value().data(), T.value().data(), rs,
+        props_[phase_usage_.phase_pos[Water]]->mu(n, pvt_region, pw.value().data(), T.value().data(), rs,
                                                   mu.data(), dmudp.data(), dmudr.data());
-        if (pw.derivative().empty()) {
-            return ADB::constant(std::move(mu));
-        } else {
-            ADB::M dmudp_diag = spdiag(dmudp);
-            const int num_blocks = pw.numBlocks();
-            std::vector<ADB::M> jacs(num_blocks);
-            for (int block = 0; block < num_blocks; ++block) {
-                fastSparseProduct(dmudp_diag, pw.derivative()[block], jacs[block]);
-            }
-            return ADB::function(std::move(mu), std::move(jacs));
-        }
+        return ADB::function(std::move(mu), chainRule(dmudp, pw));
     }
 
     /// Oil viscosity.
@@ -361,26 +529,17 @@ BlackoilPropsAdFromDeck::BlackoilPropsAdFromDeck(const BlackoilPropsAdFromDeck&
             OPM_THROW(std::runtime_error, "Cannot call muOil(): oil phase not present.");
         }
         const int n = cells.size();
-        mapPvtRegions(cells);
+        std::vector<int> region_buffer;
+        const int* pvt_region = pvtRegions(cells, region_buffer);
         assert(po.size() == n);
         V mu(n);
         V dmudp(n);
         V dmudr(n);
 
-        props_[phase_usage_.phase_pos[Oil]]->mu(n, pvt_region_.data(), po.value().data(), T.value().data(), rs.value().data(),
+        props_[phase_usage_.phase_pos[Oil]]->mu(n, pvt_region, po.value().data(), T.value().data(), rs.value().data(),
                                                 &cond[0], mu.data(), dmudp.data(), dmudr.data());
 
-        ADB::M dmudp_diag = spdiag(dmudp);
-        ADB::M dmudr_diag = spdiag(dmudr);
-        const int num_blocks = po.numBlocks();
-        std::vector<ADB::M> jacs(num_blocks);
-        for (int block = 0; block < num_blocks; ++block) {
-            fastSparseProduct(dmudp_diag, po.derivative()[block], jacs[block]);
-            ADB::M temp;
-            fastSparseProduct(dmudr_diag, rs.derivative()[block], temp);
-            jacs[block] += temp;
-        }
-        return ADB::function(std::move(mu), std::move(jacs));
+        return ADB::function(std::move(mu), chainRule(dmudp, po, dmudr, rs));
     }
 
     /// Gas viscosity.
@@ -400,26 +559,17 @@ BlackoilPropsAdFromDeck::BlackoilPropsAdFromDeck(const BlackoilPropsAdFromDeck&
             OPM_THROW(std::runtime_error, "Cannot call muGas(): gas phase not present.");
         }
         const int n = cells.size();
-        mapPvtRegions(cells);
+        std::vector<int> region_buffer;
+        const int* pvt_region = pvtRegions(cells, region_buffer);
         assert(pg.value().size() == n);
         V mu(n);
         V dmudp(n);
         V dmudr(n);
 
-        props_[phase_usage_.phase_pos[Gas]]->mu(n, pvt_region_.data(), pg.value().data(), T.value().data(), rv.value().data(),&cond[0],
+        props_[phase_usage_.phase_pos[Gas]]->mu(n, pvt_region, pg.value().data(), T.value().data(), rv.value().data(),&cond[0],
                                                   mu.data(), dmudp.data(), dmudr.data());
 
-        ADB::M dmudp_diag = spdiag(dmudp);
-        ADB::M dmudr_diag = spdiag(dmudr);
-        const int num_blocks = pg.numBlocks();
-        std::vector<ADB::M> jacs(num_blocks);
-        for (int block = 0; block < num_blocks; ++block) {
-            fastSparseProduct(dmudp_diag, pg.derivative()[block], jacs[block]);
-            ADB::M temp;
-            fastSparseProduct(dmudr_diag, rv.derivative()[block], temp);
-            jacs[block] += temp;
-        }
-        return ADB::function(std::move(mu), std::move(jacs));
+        return ADB::function(std::move(mu), chainRule(dmudp, pg, dmudr, rv));
     }
 
 
@@ -439,7 +589,8 @@ BlackoilPropsAdFromDeck::BlackoilPropsAdFromDeck(const BlackoilPropsAdFromDeck&
             OPM_THROW(std::runtime_error, "Cannot call muWat(): water phase not present.");
         }
         const int n = cells.size();
-        mapPvtRegions(cells);
+        std::vector<int> region_buffer;
+        const int* pvt_region = pvtRegions(cells, region_buffer);
         assert(pw.size() == n);
 
         V b(n);
@@ -447,16 +598,10 @@ BlackoilPropsAdFromDeck::BlackoilPropsAdFromDeck(const BlackoilPropsAdFromDeck&
         V dbdr(n);
         const double* rs = 0;
 
-        props_[phase_usage_.phase_pos[Water]]->b(n, pvt_region_.data(), pw.value().data(), T.value().data(), rs,
+        props_[phase_usage_.phase_pos[Water]]->b(n, pvt_region, pw.value().data(), T.value().data(), rs,
                                                  b.data(), dbdp.data(), dbdr.data());
 
-        ADB::M dbdp_diag = spdiag(dbdp);
-        const int num_blocks = pw.numBlocks();
-        std::vector<ADB::M> jacs(num_blocks);
-        for (int block = 0; block < num_blocks; ++block) {
-            fastSparseProduct(dbdp_diag, pw.derivative()[block], jacs[block]);
-        }
-        return ADB::function(std::move(b), std::move(jacs));
+        return ADB::function(std::move(b), chainRule(dbdp, pw));
     }
 
     /// Oil formation volume factor.
@@ -476,27 +621,18 @@ BlackoilPropsAdFromDeck::BlackoilPropsAdFromDeck(const BlackoilPropsAdFromDeck&
             OPM_THROW(std::runtime_error, "Cannot call muOil(): oil phase not present.");
         }
         const int n = cells.size();
-        mapPvtRegions(cells);
+        std::vector<int> region_buffer;
+        const int* pvt_region = pvtRegions(cells, region_buffer);
         assert(po.size() == n);
 
         V b(n);
         V dbdp(n);
         V dbdr(n);
 
-        props_[phase_usage_.phase_pos[Oil]]->b(n, pvt_region_.data(), po.value().data(), T.value().data(), rs.value().data(),
+        props_[phase_usage_.phase_pos[Oil]]->b(n, pvt_region, po.value().data(), T.value().data(), rs.value().data(),
                                                &cond[0], b.data(), dbdp.data(), dbdr.data());
 
-        ADB::M dbdp_diag = spdiag(dbdp);
-        ADB::M dbdr_diag = spdiag(dbdr);
-        const int num_blocks = po.numBlocks();
-        std::vector<ADB::M> jacs(num_blocks);
-        for (int block = 0; block < num_blocks; ++block) {
-            fastSparseProduct(dbdp_diag, po.derivative()[block], jacs[block]);
-            ADB::M temp;
-            fastSparseProduct(dbdr_diag, rs.derivative()[block], temp);
-            jacs[block] += temp;
-        }
-        return ADB::function(std::move(b), std::move(jacs));
+        return ADB::function(std::move(b), chainRule(dbdp, po, dbdr, rs));
     }
 
     /// Gas formation volume factor.
@@ -516,27 +652,104 @@ BlackoilPropsAdFromDeck::BlackoilPropsAdFromDeck(const BlackoilPropsAdFromDeck&
             OPM_THROW(std::runtime_error, "Cannot call muGas(): gas phase not present.");
         }
         const int n = cells.size();
-        mapPvtRegions(cells);
+        std::vector<int> region_buffer;
+        const int* pvt_region = pvtRegions(cells, region_buffer);
         assert(pg.size() == n);
 
         V b(n);
         V dbdp(n);
         V dbdr(n);
 
-        props_[phase_usage_.phase_pos[Gas]]->b(n, pvt_region_.data(), pg.value().data(), T.value().data(), rv.value().data(), &cond[0],
+        props_[phase_usage_.phase_pos[Gas]]->b(n, pvt_region, pg.value().data(), T.value().data(), rv.value().data(), &cond[0],
                                                b.data(), dbdp.data(), dbdr.data());
 
-        ADB::M dbdp_diag = spdiag(dbdp);
-        ADB::M dbdr_diag = spdiag(dbdr);
-        const int num_blocks = pg.numBlocks();
-        std::vector<ADB::M> jacs(num_blocks);
-        for (int block = 0; block < num_blocks; ++block) {
-            fastSparseProduct(dbdp_diag, pg.derivative()[block], jacs[block]);
-            ADB::M temp;
-            fastSparseProduct(dbdr_diag, rv.derivative()[block], temp);
-            jacs[block] += temp;
+        return ADB::function(std::move(b), chainRule(dbdp, pg, dbdr, rv));
+    }
+
+
+
+    // ------ Combined evaluation ------
+
+    /// Reciprocal formation volume factor, viscosity and density of a phase.
+    /// \param[in]  phase  Canonical index (Water, Oil or Gas) of the phase.
+    /// \param[in]  p      Array of n phase pressure values.
+    /// \param[in]  T      Array of n temperature values.
+    /// \param[in]  rs     Array of n gas solution factor values.
+    /// \param[in]  rv     Array of n vapor oil/gas ratios.
+    /// \param[in]  cond   Array of n objects, each specifying which phases are present with non-zero saturation in a cell.
+    /// \param[in]  cells  Array of n cell indices to be associated with the pressure values.
+    /// \return            b, mu and rho of the phase.
+    BlackoilPropsAdFromDeck::PhaseProperties
+    BlackoilPropsAdFromDeck::phaseProperties(const int phase,
+                                             const ADB& p,
+                                             const ADB& T,
+                                             const ADB& rs,
+                                             const ADB& rv,
+                                             const std::vector<PhasePresence>& cond,
+                                             const Cells& cells) const
+    {
+        if (phase != Water && phase != Oil && phase != Gas) {
+            OPM_THROW(std::runtime_error, "Unknown phase index " << phase);
+        }
+        if (!phase_usage_.phase_used[phase]) {
+            OPM_THROW(std::runtime_error, "Cannot call phaseProperties(): phase " << phase << " not present.");
         }
-        return ADB::function(std::move(b), std::move(jacs));
+        const int n = cells.size();
+        assert(p.size() == n);
+        std::vector<int> region_buffer;
+        const int* pvt_region = pvtRegions(cells, region_buffer);
+        const PvtInterface& pvt = *props_[phase_usage_.phase_pos[phase]];
+
+        V mu(n);
+        V dmudp(n);
+        V dmudr(n);
+        V b(n);
+        V dbdp(n);
+        V dbdr(n);
+
+        PhaseProperties props;
+        if (phase == Water) {
+            const double* rs_water = 0;
+            pvt.mu(n, pvt_region, p.value().data(), T.value().data(), rs_water,
+                   mu.data(), dmudp.data(), dmudr.data());
+            pvt.b(n, pvt_region, p.value().data(), T.value().data(), rs_water,
+                  b.data(), dbdp.data(), dbdr.data());
+            props.mu = ADB::function(std::move(mu), chainRule(dmudp, p));
+            props.b  = ADB::function(std::move(b), chainRule(dbdp, p));
+        } else {
+            const ADB& r = (phase == Oil) ? rs : rv;
+            pvt.mu(n, pvt_region, p.value().data(), T.value().data(), r.value().data(),
+                   &cond[0], mu.data(), dmudp.data(), dmudr.data());
+            pvt.b(n, pvt_region, p.value().data(), T.value().data(), r.value().data(),
+                  &cond[0], b.data(), dbdp.data(), dbdr.data());
+            props.mu = ADB::function(std::move(mu), chainRule(dmudp, p, dmudr, r));
+            props.b  = ADB::function(std::move(b), chainRule(dbdp, p, dbdr, r));
+        }
+
+        // rho = (rho_s + rho_s,dissolved * r) * b, with the derivatives
+        // formed directly from the Jacobians of b and r.
+        const double* rhos = surfaceDensity();
+        const V& bval = props.b.value();
+        int dissolved = -1;
+        if (phase == Oil && phase_usage_.phase_used[Gas]) {
+            dissolved = Gas;
+        }
+        if (phase == Gas && phase_usage_.phase_used[Oil]) {
+            dissolved = Oil;
+        }
+        if (dissolved < 0) {
+            const V factor = V::Constant(n, rhos[phase_usage_.phase_pos[phase]]);
+            V rho = factor * bval;
+            props.rho = ADB::function(std::move(rho), chainRule(factor, props.b));
+        } else {
+            const ADB& r = (phase == Oil) ? rs : rv;
+            const double rhos_dissolved = rhos[phase_usage_.phase_pos[dissolved]];
+            const V factor = rhos[phase_usage_.phase_pos[phase]] + rhos_dissolved * r.value();
+            const V drhodr = rhos_dissolved * bval;
+            V rho = factor * bval;
+            props.rho = ADB::function(std::move(rho), chainRule(factor, props.b, drhodr, r));
+        }
+        return props;
     }
 
 
@@ -554,18 +767,13 @@ BlackoilPropsAdFromDeck::BlackoilPropsAdFromDeck(const BlackoilPropsAdFromDeck&
             OPM_THROW(std::runtime_error, "Cannot call rsMax(): oil phase not present.");
         }
         const int n = cells.size();
-        mapPvtRegions(cells);
+        std::vector<int> region_buffer;
+        const int* pvt_region = pvtRegions(cells, region_buffer);
         assert(po.size() == n);
         V rbub(n);
         V drbubdp(n);
-        props_[phase_usage_.phase_pos[Oil]]->rsSat(n, pvt_region_.data(), po.value().data(), rbub.data(), drbubdp.data());
-        ADB::M drbubdp_diag = spdiag(drbubdp);
-        const int num_blocks = po.numBlocks();
-        std::vector<ADB::M> jacs(num_blocks);
-        for (int block = 0; block < num_blocks; ++block) {
-            fastSparseProduct(drbubdp_diag, po.derivative()[block], jacs[block]);
-        }
-        return ADB::function(std::move(rbub), std::move(jacs));
+        props_[phase_usage_.phase_pos[Oil]]->rsSat(n, pvt_region, po.value().data(), rbub.data(), drbubdp.data());
+        return ADB::function(std::move(rbub), chainRule(drbubdp, po));
     }
 
     /// Bubble point curve for Rs as function of oil pressure.
@@ -595,18 +803,13 @@ BlackoilPropsAdFromDeck::BlackoilPropsAdFromDeck(const BlackoilPropsAdFromDeck&
             OPM_THROW(std::runtime_error, "Cannot call rvMax(): gas phase not present.");
         }
         const int n = cells.size();
-        mapPvtRegions(cells);
+        std::vector<int> region_buffer;
+        const int* pvt_region = pvtRegions(cells, region_buffer);
         assert(po.size() == n);
         V rv(n);
         V drvdp(n);
-        props_[phase_usage_.phase_pos[Gas]]->rvSat(n, pvt_region_.data(), po.value().data(), rv.data(), drvdp.data());
-        ADB::M drvdp_diag = spdiag(drvdp);
-        const int num_blocks = po.numBlocks();
-        std::vector<ADB::M> jacs(num_blocks);
-        for (int block = 0; block < num_blocks; ++block) {
-            fastSparseProduct(drvdp_diag, po.derivative()[block], jacs[block]);
-        }
-        return ADB::function(std::move(rv), std::move(jacs));
+        props_[phase_usage_.phase_pos[Gas]]->rvSat(n, pvt_region, po.value().data(), rv.data(), drvdp.data());
+        return ADB::function(std::move(rv), chainRule(drvdp, po));
     }
 
     /// Condensation curve for Rv as function of oil pressure.
@@ -657,34 +860,15 @@ BlackoilPropsAdFromDeck::BlackoilPropsAdFromDeck(const BlackoilPropsAdFromDeck&
         Block kr(n, np);
         Block dkr(n, np*np);
         satprops_->relperm(n, s_all.data(), cells.data(), kr.data(), dkr.data());
-        const int num_blocks = so.numBlocks();
         std::vector<ADB> relperms;
         relperms.reserve(3);
-        typedef const ADB* ADBPtr;
-        ADBPtr s[3] = { &sw, &so, &sg };
+        const ADB* const s[3] = { &sw, &so, &sg };
         for (int phase1 = 0; phase1 < 3; ++phase1) {
             if (phase_usage_.phase_used[phase1]) {
                 const int phase1_pos = phase_usage_.phase_pos[phase1];
-                std::vector<ADB::M> jacs(num_blocks);
-                for (int block = 0; block < num_blocks; ++block) {
-                    jacs[block] = ADB::M(n, s[phase1]->derivative()[block].cols());
-                }
-                for (int phase2 = 0; phase2 < 3; ++phase2) {
-                    if (!phase_usage_.phase_used[phase2]) {
-                        continue;
-                    }
-                    const int phase2_pos = phase_usage_.phase_pos[phase2];
-                    // Assemble dkr1/ds2.
-                    const int column = phase1_pos + np*phase2_pos; // Recall: Fortran ordering from props_.relperm()
-                    ADB::M dkr1_ds2_diag = spdiag(dkr.col(column));
-                    for (int block = 0; block < num_blocks; ++block) {
-                        ADB::M temp;
-                        fastSparseProduct(dkr1_ds2_diag, s[phase2]->derivative()[block], temp);
-                        jacs[block] += temp;
-                    }
-                }
                 ADB::V val = kr.col(phase1_pos);
-                relperms.emplace_back(ADB::function(std::move(val), std::move(jacs)));
+                relperms.emplace_back(ADB::function(std::move(val),
+                                                    saturationChainRule(dkr, phase1_pos, phase_usage_, s)));
             } else {
                 relperms.emplace_back(ADB::null());
             }
@@ -699,7 +883,6 @@ BlackoilPropsAdFromDeck::BlackoilPropsAdFromDeck(const BlackoilPropsAdFromDeck&
     {
         const int numCells = cells.size();
         const int numActivePhases = numPhases();
-        const int numBlocks = so.numBlocks();
 
         Block activeSat(numCells, numActivePhases);
         if (phase_usage_.phase_used[Water]) {
@@ -723,29 +906,13 @@ BlackoilPropsAdFromDeck::BlackoilPropsAdFromDeck(const BlackoilPropsAdFromDeck&
 
         std::vector<ADB> adbCapPressures;
         adbCapPressures.reserve(3);
-        const ADB* s[3] = { &sw, &so, &sg };
+        const ADB* const s[3] = { &sw, &so, &sg };
         for (int phase1 = 0; phase1 < 3; ++phase1) {
             if (phase_usage_.phase_used[phase1]) {
                 const int phase1_pos = phase_usage_.phase_pos[phase1];
-                std::vector<ADB::M> jacs(numBlocks);
-                for (int block = 0; block < numBlocks; ++block) {
-                    jacs[block] = ADB::M(numCells, s[phase1]->derivative()[block].cols());
-                }
-                for (int phase2 = 0; phase2 < 3; ++phase2) {
-                    if (!phase_usage_.phase_used[phase2])
-                        continue;
-                    const int phase2_pos = phase_usage_.phase_pos[phase2];
-                    // Assemble dpc1/ds2.
-                    const int column = phase1_pos + numActivePhases*phase2_pos; // Recall: Fortran ordering from props_.relperm()
-                    ADB::M dpc1_ds2_diag = spdiag(dpc.col(column));
-                    for (int block = 0; block < numBlocks; ++block) {
-                        ADB::M temp;
-                        fastSparseProduct(dpc1_ds2_diag, s[phase2]->derivative()[block], temp);
-                        jacs[block] += temp;
-                    }
-                }
                 ADB::V val = pc.col(phase1_pos);
-                adbCapPressures.emplace_back(ADB::function(std::move(val), std::move(jacs)));
+                adbCapPressures.emplace_back(ADB::function(std::move(val),
+                                                           saturationChainRule(dpc, phase1_pos, phase_usage_, s)));
             } else {
                 adbCapPressures.emplace_back(ADB::null());
             }
@@ -856,14 +1023,32 @@ BlackoilPropsAdFromDeck::BlackoilPropsAdFromDeck(const BlackoilPropsAdFromDeck&
 
 
 
-    // Fills pvt_region_ with cellPvtRegionIdx_[cells].
-    void BlackoilPropsAdFromDeck::mapPvtRegions(const std::vector<int>& cells) const
+    // Region indices of the given cells, see the declaration.
+    const int* BlackoilPropsAdFromDeck::pvtRegions(const Cells& cells,
+                                                   std::vector<int>& buffer) const
     {
         const int n = cells.size();
-        pvt_region_.resize(n);
+        const int num_cells = cellPvtRegionIdx_.size();
+        // With a single region any cell set maps to the (constant)
+        // per-cell array, as long as it is long enough.
+        if (single_pvt_region_ && n <= num_cells) {
+            return cellPvtRegionIdx_.data();
+        }
+        // The set of all cells, in order, maps to the per-cell array.
+        if (n == num_cells) {
+            bool all_cells = true;
+            for (int ii = 0; ii < n && all_cells; ++ii) {
+                all_cells = (cells[ii] == ii);
+            }
+            if (all_cells) {
+                return cellPvtRegionIdx_.data();
+            }
+        }
+        buffer.resize(n);
         for (int ii = 0; ii < n; ++ii) {
-            pvt_region_[ii] = cellPvtRegionIdx_[cells[ii]];
+            buffer[ii] = cellPvtRegionIdx_[cells[ii]];
         }
+        return buffer.data();
     }
 
 
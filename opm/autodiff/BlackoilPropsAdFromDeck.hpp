@@ -28,6 +28,7 @@
 #include <opm/core/props/BlackoilPhases.hpp>
 #include <opm/core/props/satfunc/SaturationPropsFromDeck.hpp>
 #include <opm/core/props/rock/RockFromDeck.hpp>
+#include <opm/core/utility/parameters/ParameterGroup.hpp>
 
 #include <opm/parser/eclipse/Deck/Deck.hpp>
 #include <opm/parser/eclipse/EclipseState/EclipseState.hpp>
@@ -73,6 +74,30 @@ namespace Opm
                                 const bool init_rock = true );
 #endif
 
+        /// Constructor wrapping an opm-core black oil interface, with
+        /// options given by parameters:
+        ///   pvt_tab_size (0)         -- if positive, dead oil (PVDO) and dry gas
+        ///                               (PVDG) tables are resampled to this many
+        ///                               uniformly spaced pressures.
+        ///   pvt_tab_tolerance (1e-3) -- largest accepted relative deviation of the
+        ///                               resampled b and mu from the input tables,
+        ///                               the input tables are used otherwise.
+        BlackoilPropsAdFromDeck(Opm::DeckConstPtr deck,
+                                Opm::EclipseStateConstPtr eclState,
+                                const UnstructuredGrid& grid,
+                                const parameter::ParameterGroup& param,
+                                const bool init_rock = true );
+
+#ifdef HAVE_DUNE_CORNERPOINT
+        /// Constructor wrapping an opm-core black oil interface, with
+        /// options given by parameters, see above.
+        BlackoilPropsAdFromDeck(Opm::DeckConstPtr deck,
+                                Opm::EclipseStateConstPtr eclState,
+                                const Dune::CpGrid& grid,
+                                const parameter::ParameterGroup& param,
+                                const bool init_rock = true );
+#endif
+
         /// \brief Constructor to create properties for a subgrid
         ///
         /// This copies all properties that are not dependant on the
@@ -206,6 +231,27 @@ namespace Opm
                  const std::vector<PhasePresence>& cond,
                  const Cells& cells) const;
 
+        // ------ Combined evaluation ------
+
+        /// Reciprocal formation volume factor, viscosity and density
+        /// of a phase. The PVT regions are looked up once, and the
+        /// density is formed directly from the b values and Jacobians.
+        /// \param[in]  phase  Canonical index (Water, Oil or Gas) of the phase.
+        /// \param[in]  p      Array of n phase pressure values.
+        /// \param[in]  T      Array of n temperature values.
+        /// \param[in]  rs     Array of n gas solution factor values.
+        /// \param[in]  rv     Array of n vapor oil/gas ratios.
+        /// \param[in]  cond   Array of n objects, each specifying which phases are present with non-zero saturation in a cell.
+        /// \param[in]  cells  Array of n cell indices to be associated with the pressure values.
+        /// \return            b, mu and rho of the phase.
+        PhaseProperties phaseProperties(const int phase,
+                                        const ADB& p,
+                                        const ADB& T,
+                                        const ADB& rs,
+                                        const ADB& rv,
+                                        const std::vector<PhasePresence>& cond,
+                                        const Cells& cells) const;
+
         // ------ Rs bubble point curve ------
 
         /// Bubble point curve for Rs as function of oil pressure.
@@ -310,7 +356,9 @@ namespace Opm
                   const int* cart_dims,
                   const CentroidIterator& begin_cell_centroids,
                   int dimension,
-                  const bool init_rock);
+                  const bool init_rock,
+                  const int pvt_tab_size = 0,
+                  const double pvt_tab_tolerance = 0.0);
 
         /// Correction to rs/rv according to kw VAPPARS
         void applyVap(V& r,
@@ -323,8 +371,12 @@ namespace Opm
                       const std::vector<int>& cells,
                       const double vap) const;
 
-        // Fills pvt_region_ with cellPvtRegionIdx_[cells].
-        void mapPvtRegions(const std::vector<int>& cells) const;
+        // Returns the PVT region index of each of the given cells.
+        // The set of all cells and any cell set in a single-region
+        // model use cellPvtRegionIdx_ directly, other sets are mapped
+        // into buffer. No member is modified, so the property methods
+        // may be called concurrently.
+        const int* pvtRegions(const Cells& cells, std::vector<int>& buffer) const;
 
         RockFromDeck rock_;
         // This has to be a shared pointer as we must
@@ -338,9 +390,8 @@ namespace Opm
         // The PVT region which is to be used for each cell
         std::vector<int> cellPvtRegionIdx_;
 
-        // Used for storing the region-per-cell array computed in calls
-        // to pvt functions.
-        mutable std::vector<int> pvt_region_;
+        // True if all cells are in the first PVT region.
+        bool single_pvt_region_;
 
         // The PVT properties. One object per active fluid phase.
         std::vector<std::shared_ptr<Opm::PvtInterface> > props_;
@@ -18,7 +18,49 @@
 */
 
 #include <opm/autodiff/BlackoilPropsAdInterface.hpp>
+#include <opm/core/utility/ErrorMacros.hpp>
+
+#include <stdexcept>
 
 Opm::BlackoilPropsAdInterface::~BlackoilPropsAdInterface()
 {
 }
+
+Opm::BlackoilPropsAdInterface::PhaseProperties
+Opm::BlackoilPropsAdInterface::phaseProperties(const int phase,
+                                               const ADB& p,
+                                               const ADB& T,
+                                               const ADB& rs,
+                                               const ADB& rv,
+                                               const std::vector<PhasePresence>& cond,
+                                               const Cells& cells) const
+{
+    const PhaseUsage pu = phaseUsage();
+    const double* rhos = surfaceDensity();
+    const int n = cells.size();
+    PhaseProperties props;
+    switch (phase) {
+    case Water:
+        props.b  = bWat(p, T, cells);
+        props.mu = muWat(p, T, cells);
+        break;
+    case Oil:
+        props.b  = bOil(p, T, rs, cond, cells);
+        props.mu = muOil(p, T, rs, cond, cells);
+        break;
+    case Gas:
+        props.b  = bGas(p, T, rv, cond, cells);
+        props.mu = muGas(p, T, rv, cond, cells);
+        break;
+    default:
+        OPM_THROW(std::runtime_error, "Unknown phase index " << phase);
+    }
+    props.rho = V::Constant(n, 1, rhos[pu.phase_pos[phase]]) * props.b;
+    if (phase == Oil && pu.phase_used[Gas]) {
+        props.rho += V::Constant(n, 1, rhos[pu.phase_pos[Gas]]) * rs * props.b;
+    }
+    if (phase == Gas && pu.phase_used[Oil]) {
+        props.rho += V::Constant(n, 1, rhos[pu.phase_pos[Oil]]) * rv * props.b;
+    }
+    return props;
+}
@@ -172,6 +172,44 @@ namespace Opm
                  const std::vector<PhasePresence>& cond,
                  const Cells& cells) const = 0;
 
+        // ------ Combined evaluation ------
+
+        /// Reciprocal formation volume factor, viscosity and density
+        /// of one phase.
+        struct PhaseProperties
+        {
+            PhaseProperties()
+                : b(ADB::null()), mu(ADB::null()), rho(ADB::null())
+            {
+            }
+            ADB b;   // Reciprocal formation volume factor
+            ADB mu;  // Viscosity
+            ADB rho; // Density at reservoir conditions
+        };
+
+        /// Reciprocal formation volume factor, viscosity and density
+        /// of a phase, evaluated in one call. The default
+        /// implementation calls the single-property methods.
+        /// The density uses surfaceDensity(), and includes dissolved
+        /// gas for oil and vaporized oil for gas when both of these
+        /// phases are active.
+        /// \param[in]  phase  Canonical index (Water, Oil or Gas) of the phase.
+        /// \param[in]  p      Array of n phase pressure values.
+        /// \param[in]  T      Array of n temperature values.
+        /// \param[in]  rs     Array of n gas solution factor values.
+        /// \param[in]  rv     Array of n vapor oil/gas ratios.
+        /// \param[in]  cond   Array of n objects, each specifying which phases are present with non-zero saturation in a cell.
+        /// \param[in]  cells  Array of n cell indices to be associated with the pressure values.
+        /// \return            b, mu and rho of the phase.
+        virtual
+        PhaseProperties phaseProperties(const int phase,
+                                        const ADB& p,
+                                        const ADB& T,
+                                        const ADB& rs,
+                                        const ADB& rv,
+                                        const std::vector<PhasePresence>& cond,
+                                        const Cells& cells) const;
+
         // ------ Rs bubble point curve ------
 
         /// Bubble point curve for Rs as function of oil pressure.
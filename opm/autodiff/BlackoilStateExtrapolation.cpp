@@ -0,0 +1,134 @@
+/*
+  Copyright 2015 SINTEF ICT, Applied Mathematics.
+
+  This file is part of the Open Porous Media project (OPM).
+
+  OPM is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  OPM is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with OPM.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <config.h>
+
+#include <opm/autodiff/BlackoilStateExtrapolation.hpp>
+#include <opm/core/simulator/BlackoilState.hpp>
+#include <opm/core/utility/ErrorMacros.hpp>
+
+#include <algorithm>
+#include <cassert>
+#include <stdexcept>
+#include <utility>
+
+namespace Opm
+{
+
+    namespace
+    {
+        /// Add the change of the Lagrange polynomial through the
+        /// values (one vector per node) from the last node to the
+        /// point with the given weights, i.e. sum_i w_i v_i - v_last.
+        void addChange(const std::vector<double>& weights,
+                       const std::vector<const std::vector<double>*>& values,
+                       const bool non_negative,
+                       std::vector<double>& x)
+        {
+            const int nn = weights.size();
+            const std::vector<double>& last = *values[nn - 1];
+            if (last.size() != x.size()) {
+                OPM_THROW(std::logic_error, "BlackoilStateExtrapolation: state size changed.");
+            }
+            const int n = x.size();
+            for (int i = 0; i < n; ++i) {
+                double v = -last[i];
+                for (int node = 0; node < nn; ++node) {
+                    v += weights[node] * (*values[node])[i];
+                }
+                x[i] += v;
+                if (non_negative) {
+                    x[i] = std::max(x[i], 0.0);
+                }
+            }
+        }
+    } // anonymous namespace
+
+
+
+    BlackoilStateExtrapolation::BlackoilStateExtrapolation(const int order)
+        : order_(order)
+    {
+        if (order < 1 || order > 2) {
+            OPM_THROW(std::runtime_error, "BlackoilStateExtrapolation: order must be 1 or 2, got " << order);
+        }
+    }
+
+
+
+    void BlackoilStateExtrapolation::addState(const BlackoilState& state, const double dt)
+    {
+        Snapshot s;
+        s.time = history_.empty() ? 0.0 : history_.back().time + dt;
+        s.pressure = state.pressure();
+        s.saturation = state.saturation();
+        s.rs = state.gasoilratio();
+        s.rv = state.rv();
+        if (!history_.empty() && !(dt > 0.0)) {
+            // Same point in time, keep the latest state only.
+            history_.back() = std::move(s);
+            return;
+        }
+        history_.push_back(std::move(s));
+        while (int(history_.size()) > order_ + 1) {
+            history_.pop_front();
+        }
+    }
+
+
+
+    bool BlackoilStateExtrapolation::extrapolate(const double dt,
+                                                 const BlackoilState& state,
+                                                 BlackoilState& guess) const
+    {
+        if (history_.size() < 2) {
+            return false;
+        }
+
+        // Lagrange weights of the nodes at t = t_last + dt.
+        const int nn = history_.size();
+        const double t = history_.back().time + dt;
+        std::vector<double> weights(nn, 1.0);
+        for (int i = 0; i < nn; ++i) {
+            for (int j = 0; j < nn; ++j) {
+                if (j != i) {
+                    const double tij = history_[i].time - history_[j].time;
+                    assert(tij != 0.0);
+                    weights[i] *= (t - history_[j].time) / tij;
+                }
+            }
+        }
+
+        std::vector<const std::vector<double>*> p, s, rs, rv;
+        for (const Snapshot& snap : history_) {
+            p.push_back(&snap.pressure);
+            s.push_back(&snap.saturation);
+            rs.push_back(&snap.rs);
+            rv.push_back(&snap.rv);
+        }
+
+        guess = state;
+        addChange(weights, p, false, guess.pressure());
+        addChange(weights, s, false, guess.saturation());
+        addChange(weights, rs, true, guess.gasoilratio());
+        addChange(weights, rv, true, guess.rv());
+        return true;
+    }
+
+} // namespace Opm
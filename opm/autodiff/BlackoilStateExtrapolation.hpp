@@ -0,0 +1,87 @@
+/*
+  Copyright 2015 SINTEF ICT, Applied Mathematics.
+
+  This file is part of the Open Porous Media project (OPM).
+
+  OPM is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  OPM is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with OPM.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef OPM_BLACKOILSTATEEXTRAPOLATION_HEADER_INCLUDED
+#define OPM_BLACKOILSTATEEXTRAPOLATION_HEADER_INCLUDED
+
+#include <deque>
+#include <vector>
+
+namespace Opm
+{
+
+    class BlackoilState;
+
+    /// History of the states at the end of the last accepted time
+    /// steps, used to extrapolate pressure, saturations, rs and rv
+    /// in time as the initial guess of the next Newton iteration.
+    class BlackoilStateExtrapolation
+    {
+    public:
+        /// Construct an empty history.
+        /// \param[in] order   1 for linear, 2 for quadratic extrapolation.
+        explicit BlackoilStateExtrapolation(const int order);
+
+        /// Extrapolation order requested in the constructor.
+        int order() const { return order_; }
+
+        /// True if no state has been recorded.
+        bool empty() const { return history_.empty(); }
+
+        /// Record the state reached by an accepted step of length dt
+        /// from the previously recorded state. For the first state
+        /// (the initial one) dt is ignored.
+        void addState(const BlackoilState& state, const double dt);
+
+        /// Discard the history, for instance after a change that
+        /// breaks the continuity in time.
+        void clear() { history_.clear(); }
+
+        /// Extrapolate to the end of a step of length dt starting in
+        /// state, which is expected to be the last recorded state.
+        /// The change of the extrapolating polynomial over the step
+        /// is added to state, with rs and rv kept non-negative. The
+        /// order is reduced if the history is too short.
+        /// \param[in]  dt      length of the next step.
+        /// \param[in]  state   state at the beginning of the step.
+        /// \param[out] guess   extrapolated state, a copy of state
+        ///                     except for pressure, saturation, rs and rv.
+        /// \return             false if there are less than two
+        ///                     recorded states, and guess is not set.
+        bool extrapolate(const double dt,
+                         const BlackoilState& state,
+                         BlackoilState& guess) const;
+
+    private:
+        struct Snapshot
+        {
+            double time;
+            std::vector<double> pressure;
+            std::vector<double> saturation;
+            std::vector<double> rs;
+            std::vector<double> rv;
+        };
+
+        int order_;
+        std::deque<Snapshot> history_; // At most order_ + 1 states, the last one most recent.
+    };
+
+} // namespace Opm
+
+#endif // OPM_BLACKOILSTATEEXTRAPOLATION_HEADER_INCLUDED
@@ -0,0 +1,391 @@
+/*
+  Copyright 2015 SINTEF ICT, Applied Mathematics.
+
+  This file is part of the Open Porous Media project (OPM).
+
+  OPM is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  OPM is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with OPM.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <config.h>
+
+#include <opm/autodiff/BlackoilTransportReorder.hpp>
+#include <opm/autodiff/BlackoilPropsAdInterface.hpp>
+#include <opm/autodiff/CellOrdering.hpp>
+#include <opm/core/utility/ErrorMacros.hpp>
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <stdexcept>
+#include <utility>
+
+namespace Opm
+{
+
+    BlackoilTransportReorder::BlackoilTransportReorder(const BlackoilPropsAdInterface& props,
+                                                       const HelperOps& ops,
+                                                       const double tolerance,
+                                                       const int max_iter,
+                                                       const double ds_max)
+        : props_(props)
+        , ops_(ops)
+        , tolerance_(tolerance)
+        , max_iter_(max_iter)
+        , ds_max_(ds_max)
+        , np_(props.numPhases())
+        , oil_(-1)
+        , input_(0)
+        , saturation_(0)
+        , iterations_(0)
+        , multi_cell_components_(0)
+    {
+        const PhaseUsage pu = props.phaseUsage();
+        if (!pu.phase_used[BlackoilPhases::Liquid]) {
+            OPM_THROW(std::runtime_error, "BlackoilTransportReorder requires an oil phase.");
+        }
+        oil_ = pu.phase_pos[BlackoilPhases::Liquid];
+        for (int phase = 0; phase < np_; ++phase) {
+            if (phase != oil_) {
+                unknowns_.push_back(phase);
+            }
+        }
+
+        // Faces of each cell.
+        const int nif = ops.nbi.rows();
+        const int nc = ops.div.rows();
+        cell_face_start_.assign(nc + 1, 0);
+        for (int f = 0; f < nif; ++f) {
+            ++cell_face_start_[ops.nbi(f, 0) + 1];
+            ++cell_face_start_[ops.nbi(f, 1) + 1];
+        }
+        for (int c = 0; c < nc; ++c) {
+            cell_face_start_[c + 1] += cell_face_start_[c];
+        }
+        cell_faces_.resize(2*nif);
+        std::vector<int> pos(cell_face_start_.begin(), cell_face_start_.end() - 1);
+        for (int f = 0; f < nif; ++f) {
+            cell_faces_[pos[ops.nbi(f, 0)]++] = f;
+            cell_faces_[pos[ops.nbi(f, 1)]++] = f;
+        }
+    }
+
+
+
+    bool BlackoilTransportReorder::solve(const Input& input, std::vector<double>& saturation)
+    {
+        const int nc = input.pvdt.size();
+        const int nif = ops_.nbi.rows();
+        if (int(saturation.size()) != nc*np_ || int(cell_face_start_.size()) != nc + 1) {
+            OPM_THROW(std::logic_error, "BlackoilTransportReorder::solve(): size mismatch.");
+        }
+        input_ = &input;
+        saturation_ = &saturation;
+        iterations_ = 0;
+        multi_cell_components_ = 0;
+
+        // Upwind cells of the phase heads, and the upwind graph.
+        upwind_.resize(nif*np_);
+        std::vector<std::pair<int, int> > edges;
+        edges.reserve(nif);
+        for (int f = 0; f < nif; ++f) {
+            const int c1 = ops_.nbi(f, 0);
+            const int c2 = ops_.nbi(f, 1);
+            bool from1 = false;
+            bool from2 = false;
+            for (int phase = 0; phase < np_; ++phase) {
+                const bool up1 = input.head[phase][f] >= 0.0;
+                upwind_[f*np_ + phase] = up1 ? c1 : c2;
+                from1 = from1 || up1;
+                from2 = from2 || !up1;
+            }
+            if (from1) { edges.emplace_back(c1, c2); }
+            if (from2) { edges.emplace_back(c2, c1); }
+        }
+        std::vector<int> order;
+        std::vector<int> component_start;
+        topologicalComponents(nc, edges, order, component_start);
+
+        // Mobilities of the initial saturations.
+        {
+            typedef Eigen::Array<double, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor> DataBlock;
+            const DataBlock s = Eigen::Map<const DataBlock>(&saturation[0], nc, np_);
+            const PhaseUsage pu = props_.phaseUsage();
+            const ADB zero = ADB::constant(V::Zero(nc, 1));
+            const ADB sw = pu.phase_used[BlackoilPhases::Aqua]
+                ? ADB::constant(s.col(pu.phase_pos[BlackoilPhases::Aqua])) : zero;
+            const ADB so = ADB::constant(s.col(oil_));
+            const ADB sg = pu.phase_used[BlackoilPhases::Vapour]
+                ? ADB::constant(s.col(pu.phase_pos[BlackoilPhases::Vapour])) : zero;
+            std::vector<int> cells(nc);
+            for (int c = 0; c < nc; ++c) {
+                cells[c] = c;
+            }
+            const std::vector<ADB> kr = props_.relperm(sw, so, sg, cells);
+            mob_.resize(nc*np_);
+            for (int canph = 0; canph < BlackoilPhases::MaxNumPhases; ++canph) {
+                if (pu.phase_used[canph]) {
+                    const int phase = pu.phase_pos[canph];
+                    for (int c = 0; c < nc; ++c) {
+                        mob_[c*np_ + phase] = kr[canph].value()[c] * input.mob_scale[phase][c];
+                    }
+                }
+            }
+        }
+
+        bool converged = true;
+        const int num_components = component_start.size() - 1;
+        std::vector<double> old_sat(np_);
+        for (int comp = 0; comp < num_components; ++comp) {
+            const int begin = component_start[comp];
+            const int end = component_start[comp + 1];
+            if (end - begin == 1) {
+                converged = solveSingleCell(order[begin]) && converged;
+                continue;
+            }
+            // Counter-current flow: Gauss-Seidel over the component.
+            ++multi_cell_components_;
+            bool comp_converged = false;
+            for (int sweep = 0; sweep < max_iter_ && !comp_converged; ++sweep) {
+                double max_change = 0.0;
+                bool cells_converged = true;
+                for (int k = begin; k < end; ++k) {
+                    const int cell = order[k];
+                    std::copy(&saturation[cell*np_], &saturation[cell*np_] + np_, old_sat.begin());
+                    cells_converged = solveSingleCell(cell) && cells_converged;
+                    for (int phase = 0; phase < np_; ++phase) {
+                        max_change = std::max(max_change, std::fabs(saturation[cell*np_ + phase] - old_sat[phase]));
+                    }
+                }
+                comp_converged = cells_converged && max_change < tolerance_;
+            }
+            converged = comp_converged && converged;
+        }
+
+        input_ = 0;
+        saturation_ = 0;
+        return converged;
+    }
+
+
+
+    bool BlackoilTransportReorder::solveSingleCell(const int cell)
+    {
+        const int nu = unknowns_.size();
+        const Input& in = *input_;
+        std::vector<double>& s = *saturation_;
+        std::vector<double> res;
+        std::vector<double> jac;
+        for (int it = 0; it < max_iter_; ++it) {
+            computeMobility(cell, &dmob_);
+            cellResidual(cell, res, jac);
+
+            // Residual in saturation units.
+            double norm = 0.0;
+            for (int k = 0; k < nu; ++k) {
+                const int phase = unknowns_[k];
+                const double scale = in.pvdt[cell] * in.pv_mult[cell] * in.component[phase][phase][cell];
+                norm = std::max(norm, std::fabs(res[k]) / scale);
+            }
+            if (norm < tolerance_) {
+                return true;
+            }
+
+            // Newton update of at most two unknowns.
+            double ds[2] = { 0.0, 0.0 };
+            if (nu == 1) {
+                if (jac[0] == 0.0) {
+                    break;
+                }
+                ds[0] = -res[0] / jac[0];
+            } else if (nu == 2) {
+                const double det = jac[0]*jac[3] - jac[1]*jac[2];
+                if (det == 0.0) {
+                    break;
+                }
+                ds[0] = -( jac[3]*res[0] - jac[1]*res[1]) / det;
+                ds[1] = -(-jac[2]*res[0] + jac[0]*res[1]) / det;
+            } else {
+                return true;
+            }
+            double max_ds = 0.0;
+            for (int k = 0; k < nu; ++k) {
+                max_ds = std::max(max_ds, std::fabs(ds[k]));
+            }
+            const double factor = max_ds > ds_max_ ? ds_max_ / max_ds : 1.0;
+
+            // Keep the saturations in [0, 1].
+            double sum = 0.0;
+            for (int k = 0; k < nu; ++k) {
+                double& su = s[cell*np_ + unknowns_[k]];
+                su = std::min(std::max(su + factor*ds[k], 0.0), 1.0);
+                sum += su;
+            }
+            if (sum > 1.0) {
+                for (int k = 0; k < nu; ++k) {
+                    s[cell*np_ + unknowns_[k]] /= sum;
+                }
+                sum = 1.0;
+            }
+            s[cell*np_ + oil_] = 1.0 - sum;
+            ++iterations_;
+        }
+        computeMobility(cell, 0);
+        return false;
+    }
+
+
+
+    void BlackoilTransportReorder::computeMobility(const int cell, std::vector<double>* dmob)
+    {
+        const int nu = unknowns_.size();
+        const PhaseUsage pu = props_.phaseUsage();
+        const std::vector<double>& s = *saturation_;
+
+        std::vector<V> vars0;
+        for (int k = 0; k < nu; ++k) {
+            vars0.push_back(V::Constant(1, s[cell*np_ + unknowns_[k]]));
+        }
+        const std::vector<ADB> vars = ADB::variables(vars0);
+        const ADB zero = ADB::constant(V::Zero(1));
+        ADB sw = zero;
+        ADB sg = zero;
+        ADB so = ADB::constant(V::Ones(1));
+        for (int k = 0; k < nu; ++k) {
+            so -= vars[k];
+            if (pu.phase_used[BlackoilPhases::Aqua] && unknowns_[k] == pu.phase_pos[BlackoilPhases::Aqua]) {
+                sw = vars[k];
+            } else {
+                sg = vars[k];
+            }
+        }
+        const std::vector<ADB> kr = props_.relperm(sw, so, sg, std::vector<int>(1, cell));
+
+        if (dmob) {
+            dmob->assign(np_*nu, 0.0);
+        }
+        for (int canph = 0; canph < BlackoilPhases::MaxNumPhases; ++canph) {
+            if (!pu.phase_used[canph]) {
+                continue;
+            }
+            const int phase = pu.phase_pos[canph];
+            const double scale = input_->mob_scale[phase][cell];
+            mob_[cell*np_ + phase] = kr[canph].value()[0] * scale;
+            if (dmob) {
+                const std::vector<ADB::M>& jacs = kr[canph].derivative();
+                for (int k = 0; k < nu && k < int(jacs.size()); ++k) {
+                    (*dmob)[phase*nu + k] = jacs[k].coeff(0, 0) * scale;
+                }
+            }
+        }
+    }
+
+
+
+    void BlackoilTransportReorder::cellResidual(const int cell,
+                                                std::vector<double>& res,
+                                                std::vector<double>& jac) const
+    {
+        const int nu = unknowns_.size();
+        const Input& in = *input_;
+        const std::vector<double>& s = *saturation_;
+        const std::vector<std::vector<V> >& comp = in.component;
+        res.assign(nu, 0.0);
+        jac.assign(nu*nu, 0.0);
+
+        // Accumulation, with so = 1 - sum of the unknowns.
+        const double acc_scale = in.pvdt[cell] * in.pv_mult[cell];
+        for (int k = 0; k < nu; ++k) {
+            const int kp = unknowns_[k];
+            double acc = 0.0;
+            for (int phase = 0; phase < np_; ++phase) {
+                acc += comp[kp][phase][cell] * s[cell*np_ + phase];
+            }
+            res[k] = acc_scale * acc - in.pvdt[cell] * in.accum0[kp][cell];
+            for (int j = 0; j < nu; ++j) {
+                jac[k*nu + j] = acc_scale * (comp[kp][unknowns_[j]][cell] - comp[kp][oil_][cell]);
+            }
+        }
+
+        // Fluxes in fractional flow form. Only the mobilities of
+        // this cell depend on the unknowns.
+        std::vector<double> mob_up(np_);
+        std::vector<double> dmob_up(np_*nu);
+        std::vector<double> dF(nu);
+        for (int k = cell_face_start_[cell]; k < cell_face_start_[cell + 1]; ++k) {
+            const int f = cell_faces_[k];
+            const double sign = ops_.nbi(f, 0) == cell ? 1.0 : -1.0;
+            double mob_total = 0.0;
+            for (int phase = 0; phase < np_; ++phase) {
+                const int up = upwind_[f*np_ + phase];
+                mob_up[phase] = mob_[up*np_ + phase];
+                mob_total += mob_up[phase];
+                for (int j = 0; j < nu; ++j) {
+                    dmob_up[phase*nu + j] = up == cell ? dmob_[phase*nu + j] : 0.0;
+                }
+            }
+            if (!(mob_total > 0.0)) {
+                continue;
+            }
+            for (int phase = 0; phase < np_; ++phase) {
+                const int up = upwind_[f*np_ + phase];
+                const double ha = in.head[phase][f];
+                double G = in.total_flux[f];
+                for (int other = 0; other < np_; ++other) {
+                    if (other != phase) {
+                        G += mob_up[other] * (ha - in.head[other][f]);
+                    }
+                }
+                const double F = mob_up[phase] / mob_total * G;
+                for (int j = 0; j < nu; ++j) {
+                    double dG = 0.0;
+                    double dmob_total = 0.0;
+                    for (int other = 0; other < np_; ++other) {
+                        dmob_total += dmob_up[other*nu + j];
+                        if (other != phase) {
+                            dG += dmob_up[other*nu + j] * (ha - in.head[other][f]);
+                        }
+                    }
+                    dF[j] = (dmob_up[phase*nu + j]*G + mob_up[phase]*dG) / mob_total
+                        - F * dmob_total / mob_total;
+                }
+                for (int kk = 0; kk < nu; ++kk) {
+                    const double c = sign * comp[unknowns_[kk]][phase][up];
+                    res[kk] += c * F;
+                    for (int j = 0; j < nu; ++j) {
+                        jac[kk*nu + j] += c * dF[j];
+                    }
+                }
+            }
+        }
+
+        // Wells: producing connections with the mobilities of the
+        // cell, injecting connections with its total mobility.
+        const double wp = in.well_production.size() > 0 ? in.well_production[cell] : 0.0;
+        for (int kk = 0; kk < nu; ++kk) {
+            const int kp = unknowns_[kk];
+            const double wi = in.well_injection.empty() ? 0.0 : in.well_injection[kp][cell];
+            if (wp == 0.0 && wi == 0.0) {
+                continue;
+            }
+            for (int phase = 0; phase < np_; ++phase) {
+                const double c = wp * comp[kp][phase][cell] - wi;
+                res[kk] += c * mob_[cell*np_ + phase];
+                for (int j = 0; j < nu; ++j) {
+                    jac[kk*nu + j] += c * dmob_[phase*nu + j];
+                }
+            }
+        }
+    }
+
+} // namespace Opm
@@ -0,0 +1,132 @@
+/*
+  Copyright 2015 SINTEF ICT, Applied Mathematics.
+
+  This file is part of the Open Porous Media project (OPM).
+
+  OPM is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  OPM is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with OPM.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef OPM_BLACKOILTRANSPORTREORDER_HEADER_INCLUDED
+#define OPM_BLACKOILTRANSPORTREORDER_HEADER_INCLUDED
+
+#include <opm/autodiff/AutoDiffHelpers.hpp>
+
+#include <vector>
+
+namespace Opm
+{
+
+    class BlackoilPropsAdInterface;
+
+    /// Implicit black-oil transport with a fixed total flux, solved
+    /// cell by cell in upwind order. The cells are ordered by the
+    /// strongly connected components of the upwind graph of the phase
+    /// fluxes. Single cells are solved with a local Newton method,
+    /// components with counter-current flow by Gauss-Seidel sweeps.
+    ///
+    /// The unknowns are the saturations of the phases other than
+    /// oil, and the equations are the corresponding component mass
+    /// balances, with the phase fluxes in fractional flow form:
+    ///   F_a = mob_a/mob_t * (v_t + sum_{b != a} mob_b*(head_a - head_b)).
+    /// All properties except the relative permeabilities are fixed
+    /// in the input, in particular b, viscosities, rs and rv. This is
+    /// the transport equation of a sequential scheme with pressure
+    /// (and thus the phase heads) fixed.
+    class BlackoilTransportReorder
+    {
+    public:
+        typedef AutoDiffBlock<double>::V V;
+
+        /// Fixed data of a transport step. Cell quantities have one
+        /// element per cell, face quantities one per internal face of
+        /// the HelperOps passed to the constructor, and phases are
+        /// indexed by active phase position.
+        struct Input
+        {
+            V pvdt;                          // Pore volume over time step.
+            V pv_mult;                       // Pore volume multiplier.
+            V total_flux;                    // Total reservoir volume flux.
+            std::vector<V> head;             // Per phase, transmissibility times potential difference.
+            std::vector<V> mob_scale;        // Per phase, mobility over relative permeability.
+            std::vector<std::vector<V> > component; // component[k][a]: surface volume of the
+                                             // component of phase k per reservoir volume of phase a.
+            std::vector<V> accum0;           // Per phase, accumulation of its component at the
+                                             // start of the step, without pvdt.
+            V well_production;               // Sum of WI*drawdown over producing connections.
+            std::vector<V> well_injection;   // Per phase, injected component per total mobility.
+        };
+
+        /// Construct a solver.
+        /// \param[in] props      fluid properties, for relative permeabilities.
+        /// \param[in] ops        grid operators, for the internal faces.
+        /// \param[in] tolerance  tolerance of the scaled cell residuals.
+        /// \param[in] max_iter   max Newton iterations per cell, and
+        ///                       max sweeps per component.
+        /// \param[in] ds_max     max saturation change per Newton iteration.
+        BlackoilTransportReorder(const BlackoilPropsAdInterface& props,
+                                 const HelperOps& ops,
+                                 const double tolerance,
+                                 const int max_iter,
+                                 const double ds_max);
+
+        /// Solve the transport step.
+        /// \param[in]    input       fixed data of the step.
+        /// \param[inout] saturation  per cell and active phase, with
+        ///                           the phase running fastest, as in
+        ///                           BlackoilState. The start of the
+        ///                           Newton iterations on input.
+        /// \return       false if some cell or component failed to converge.
+        bool solve(const Input& input, std::vector<double>& saturation);
+
+        /// Total number of cell Newton iterations of the last solve().
+        int iterations() const { return iterations_; }
+
+        /// Number of components with more than one cell in the last solve().
+        int multiCellComponents() const { return multi_cell_components_; }
+
+    private:
+        typedef AutoDiffBlock<double> ADB;
+
+        bool solveSingleCell(const int cell);
+        void computeMobility(const int cell, std::vector<double>* dmob);
+        void cellResidual(const int cell,
+                          std::vector<double>& res,
+                          std::vector<double>& jac) const;
+
+        const BlackoilPropsAdInterface& props_;
+        const HelperOps& ops_;
+        const double tolerance_;
+        const int max_iter_;
+        const double ds_max_;
+        const int np_;
+        std::vector<int> unknowns_;   // Phases of the unknowns, all but oil.
+        int oil_;                     // Phase position of oil.
+
+        // Faces of each cell, in compressed form.
+        std::vector<int> cell_face_start_;
+        std::vector<int> cell_faces_;
+
+        // Per solve().
+        const Input* input_;
+        std::vector<double>* saturation_;
+        std::vector<int> upwind_;     // Per face and phase, phase running fastest.
+        std::vector<double> mob_;     // Per cell and phase, phase running fastest.
+        std::vector<double> dmob_;    // Derivatives of mob_ by the unknowns of the cell.
+        int iterations_;
+        int multi_cell_components_;
+    };
+
+} // namespace Opm
+
+#endif // OPM_BLACKOILTRANSPORTREORDER_HEADER_INCLUDED
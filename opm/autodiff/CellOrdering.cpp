@@ -0,0 +1,342 @@
+/*
+  Copyright 2015 SINTEF ICT, Applied Mathematics.
+
+  This file is part of the Open Porous Media project (OPM).
+
+  OPM is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  OPM is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with OPM.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <config.h>
+
+#include <opm/autodiff/CellOrdering.hpp>
+#include <opm/core/utility/ErrorMacros.hpp>
+
+#include <algorithm>
+#include <cassert>
+#include <stdexcept>
+#include <utility>
+
+namespace Opm
+{
+
+    namespace
+    {
+        /// Symmetric adjacency structure in compressed form,
+        /// without self-connections.
+        struct Graph
+        {
+            std::vector<int> start;
+            std::vector<int> nbrs;
+
+            int degree(const int i) const { return start[i + 1] - start[i]; }
+        };
+
+        Graph symmetricGraph(const Eigen::SparseMatrix<double, Eigen::RowMajor>& A)
+        {
+            typedef Eigen::SparseMatrix<double, Eigen::RowMajor> Mat;
+            const int n = A.rows();
+            std::vector<std::pair<int, int> > edges;
+            edges.reserve(2 * A.nonZeros());
+            for (int row = 0; row < n; ++row) {
+                for (Mat::InnerIterator it(A, row); it; ++it) {
+                    const int col = it.index();
+                    if (col != row) {
+                        edges.emplace_back(row, col);
+                        edges.emplace_back(col, row);
+                    }
+                }
+            }
+            std::sort(edges.begin(), edges.end());
+            edges.erase(std::unique(edges.begin(), edges.end()), edges.end());
+
+            Graph g;
+            g.start.assign(n + 1, 0);
+            g.nbrs.resize(edges.size());
+            for (std::size_t e = 0; e < edges.size(); ++e) {
+                ++g.start[edges[e].first + 1];
+                g.nbrs[e] = edges[e].second;
+            }
+            for (int i = 0; i < n; ++i) {
+                g.start[i + 1] += g.start[i];
+            }
+            return g;
+        }
+
+        /// Breadth-first search from root, visiting neighbours in
+        /// order of increasing degree. Appends the visited nodes to
+        /// order. Returns the number of levels, and sets last_level
+        /// to the index in order where the last level starts.
+        int bfs(const Graph& g, const int root,
+                std::vector<char>& visited,
+                std::vector<int>& order,
+                std::size_t& last_level)
+        {
+            std::size_t head = order.size();
+            order.push_back(root);
+            visited[root] = 1;
+            int levels = 0;
+            std::vector<int> level_nbrs;
+            while (head < order.size()) {
+                const std::size_t level_end = order.size();
+                last_level = head;
+                ++levels;
+                for (; head < level_end; ++head) {
+                    const int node = order[head];
+                    level_nbrs.clear();
+                    for (int k = g.start[node]; k < g.start[node + 1]; ++k) {
+                        const int nb = g.nbrs[k];
+                        if (!visited[nb]) {
+                            visited[nb] = 1;
+                            level_nbrs.push_back(nb);
+                        }
+                    }
+                    std::stable_sort(level_nbrs.begin(), level_nbrs.end(),
+                                     [&g](const int a, const int b) { return g.degree(a) < g.degree(b); });
+                    order.insert(order.end(), level_nbrs.begin(), level_nbrs.end());
+                }
+            }
+            return levels;
+        }
+
+        /// Find a pseudo-peripheral node of the component of root
+        /// (George-Liu): repeatedly move to a minimum-degree node in
+        /// the last BFS level while the number of levels grows.
+        int pseudoPeripheralNode(const Graph& g, int root,
+                                 std::vector<char>& scratch)
+        {
+            std::vector<int> order;
+            int eccentricity = 0;
+            for (int iter = 0; iter < 10; ++iter) {
+                order.clear();
+                std::size_t last_level = 0;
+                const int levels = bfs(g, root, scratch, order, last_level);
+                // Only touch the nodes of this component when resetting.
+                for (const int node : order) {
+                    scratch[node] = 0;
+                }
+                if (iter > 0 && levels <= eccentricity) {
+                    break;
+                }
+                eccentricity = levels;
+                int best = order[last_level];
+                for (std::size_t k = last_level; k < order.size(); ++k) {
+                    if (g.degree(order[k]) < g.degree(best)) {
+                        best = order[k];
+                    }
+                }
+                if (best == root) {
+                    break;
+                }
+                root = best;
+            }
+            return root;
+        }
+    } // anonymous namespace
+
+
+
+    std::vector<int>
+    reverseCuthillMcKee(const Eigen::SparseMatrix<double, Eigen::RowMajor>& A)
+    {
+        if (A.rows() != A.cols()) {
+            OPM_THROW(std::logic_error, "reverseCuthillMcKee() requires a square matrix.");
+        }
+        const int n = A.rows();
+        const Graph g = symmetricGraph(A);
+
+        std::vector<int> order;
+        order.reserve(n);
+        std::vector<char> visited(n, 0);
+        std::vector<char> scratch(n, 0);
+        for (int i = 0; i < n; ++i) {
+            if (visited[i]) {
+                continue;
+            }
+            // Start each connected component from a peripheral node.
+            const int root = pseudoPeripheralNode(g, i, scratch);
+            std::size_t last_level = 0;
+            bfs(g, root, visited, order, last_level);
+        }
+        std::reverse(order.begin(), order.end());
+        return order;
+    }
+
+
+
+    void topologicalComponents(const int num_nodes,
+                               const std::vector<std::pair<int, int> >& edges,
+                               std::vector<int>& order,
+                               std::vector<int>& component_start)
+    {
+        // Outgoing edges in compressed form.
+        std::vector<int> start(num_nodes + 1, 0);
+        for (const auto& e : edges) {
+            if (e.first < 0 || e.first >= num_nodes || e.second < 0 || e.second >= num_nodes) {
+                OPM_THROW(std::logic_error, "topologicalComponents(): node index out of range.");
+            }
+            ++start[e.first + 1];
+        }
+        for (int i = 0; i < num_nodes; ++i) {
+            start[i + 1] += start[i];
+        }
+        std::vector<int> targets(edges.size());
+        {
+            std::vector<int> pos(start.begin(), start.end() - 1);
+            for (const auto& e : edges) {
+                targets[pos[e.first]++] = e.second;
+            }
+        }
+
+        // Iterative Tarjan. The components are completed in reverse
+        // topological order, and reversed at the end.
+        std::vector<int> index(num_nodes, -1);
+        std::vector<int> low(num_nodes, 0);
+        std::vector<char> on_stack(num_nodes, 0);
+        std::vector<int> stack;
+        std::vector<std::pair<int, int> > calls; // (node, next edge)
+        std::vector<int> rev_order;
+        std::vector<int> rev_start(1, 0);
+        rev_order.reserve(num_nodes);
+        int counter = 0;
+        for (int root = 0; root < num_nodes; ++root) {
+            if (index[root] >= 0) {
+                continue;
+            }
+            index[root] = low[root] = counter++;
+            stack.push_back(root);
+            on_stack[root] = 1;
+            calls.emplace_back(root, start[root]);
+            while (!calls.empty()) {
+                const int v = calls.back().first;
+                const int k = calls.back().second;
+                if (k < start[v + 1]) {
+                    ++calls.back().second;
+                    const int w = targets[k];
+                    if (index[w] < 0) {
+                        index[w] = low[w] = counter++;
+                        stack.push_back(w);
+                        on_stack[w] = 1;
+                        calls.emplace_back(w, start[w]);
+                    } else if (on_stack[w]) {
+                        low[v] = std::min(low[v], index[w]);
+                    }
+                    continue;
+                }
+                calls.pop_back();
+                if (!calls.empty()) {
+                    const int parent = calls.back().first;
+                    low[parent] = std::min(low[parent], low[v]);
+                }
+                if (low[v] == index[v]) {
+                    int w;
+                    do {
+                        w = stack.back();
+                        stack.pop_back();
+                        on_stack[w] = 0;
+                        rev_order.push_back(w);
+                    } while (w != v);
+                    rev_start.push_back(rev_order.size());
+                }
+            }
+        }
+
+        const int num_components = rev_start.size() - 1;
+        order.clear();
+        order.reserve(num_nodes);
+        component_start.assign(1, 0);
+        for (int comp = num_components - 1; comp >= 0; --comp) {
+            order.insert(order.end(), rev_order.begin() + rev_start[comp], rev_order.begin() + rev_start[comp + 1]);
+            component_start.push_back(order.size());
+        }
+    }
+
+
+
+    CellPermutation::CellPermutation(const std::vector<int>& new2old, const int num_blocks)
+        : new2old_(new2old)
+    {
+        const int nc = new2old.size();
+        old2new_.assign(nc * num_blocks, -1);
+        for (int block = 0; block < num_blocks; ++block) {
+            for (int i = 0; i < nc; ++i) {
+                old2new_[block*nc + new2old[i]] = block*nc + i;
+            }
+        }
+        if (std::find(old2new_.begin(), old2new_.end(), -1) != old2new_.end()) {
+            OPM_THROW(std::logic_error, "CellPermutation: cell ordering is not a permutation.");
+        }
+    }
+
+
+
+    Eigen::SparseMatrix<double, Eigen::RowMajor>
+    CellPermutation::permute(const Eigen::SparseMatrix<double, Eigen::RowMajor>& A) const
+    {
+        typedef Eigen::SparseMatrix<double, Eigen::RowMajor> Mat;
+        const int n = old2new_.size();
+        if (A.rows() != n || A.cols() != n) {
+            OPM_THROW(std::logic_error, "CellPermutation::permute(): matrix size mismatch.");
+        }
+        std::vector<int> new2old(n);
+        for (int i = 0; i < n; ++i) {
+            new2old[old2new_[i]] = i;
+        }
+
+        Mat res(n, n);
+        res.reserve(A.nonZeros());
+        std::vector<std::pair<int, double> > row_entries;
+        for (int row = 0; row < n; ++row) {
+            row_entries.clear();
+            for (Mat::InnerIterator it(A, new2old[row]); it; ++it) {
+                row_entries.emplace_back(old2new_[it.index()], it.value());
+            }
+            std::sort(row_entries.begin(), row_entries.end());
+            res.startVec(row);
+            for (const auto& e : row_entries) {
+                res.insertBackByOuterInnerUnordered(row, e.first) = e.second;
+            }
+        }
+        res.finalize();
+        return res;
+    }
+
+
+
+    Eigen::Array<double, Eigen::Dynamic, 1>
+    CellPermutation::permute(const Eigen::Array<double, Eigen::Dynamic, 1>& x) const
+    {
+        const int n = old2new_.size();
+        assert(x.size() == n);
+        Eigen::Array<double, Eigen::Dynamic, 1> y(n);
+        for (int i = 0; i < n; ++i) {
+            y[old2new_[i]] = x[i];
+        }
+        return y;
+    }
+
+
+
+    Eigen::Array<double, Eigen::Dynamic, 1>
+    CellPermutation::unpermute(const Eigen::Array<double, Eigen::Dynamic, 1>& x) const
+    {
+        const int n = old2new_.size();
+        assert(x.size() == n);
+        Eigen::Array<double, Eigen::Dynamic, 1> y(n);
+        for (int i = 0; i < n; ++i) {
+            y[i] = x[old2new_[i]];
+        }
+        return y;
+    }
+
+} // namespace Opm
@@ -0,0 +1,92 @@
+/*
+  Copyright 2015 SINTEF ICT, Applied Mathematics.
+
+  This file is part of the Open Porous Media project (OPM).
+
+  OPM is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  OPM is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with OPM.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef OPM_CELLORDERING_HEADER_INCLUDED
+#define OPM_CELLORDERING_HEADER_INCLUDED
+
+#include <opm/core/utility/platform_dependent/disable_warnings.h>
+
+#include <Eigen/Eigen>
+#include <Eigen/Sparse>
+
+#include <opm/core/utility/platform_dependent/reenable_warnings.h>
+
+#include <utility>
+#include <vector>
+
+namespace Opm
+{
+
+    /// Bandwidth-reducing reverse Cuthill-McKee ordering of the
+    /// graph given by the sparsity pattern of A + A^T.
+    /// \param[in] A   square matrix, typically the pressure
+    ///                (cell-cell) block of a reservoir system.
+    /// \return        new2old, with new2old[i] the original index of
+    ///                the row placed at position i.
+    std::vector<int>
+    reverseCuthillMcKee(const Eigen::SparseMatrix<double, Eigen::RowMajor>& A);
+
+    /// Strongly connected components of a directed graph (Tarjan),
+    /// ordered such that every edge goes from a component to itself
+    /// or to a later component. For the graph of a flux field with
+    /// edges from upwind to downwind cells, this is the order in
+    /// which the cells can be solved, one component at a time.
+    /// \param[in]  num_nodes        number of nodes.
+    /// \param[in]  edges            (from, to) pairs, duplicates allowed.
+    /// \param[out] order            the nodes, grouped by component.
+    /// \param[out] component_start  component i consists of the nodes
+    ///                              order[component_start[i]] up to
+    ///                              order[component_start[i + 1] - 1].
+    void topologicalComponents(const int num_nodes,
+                               const std::vector<std::pair<int, int> >& edges,
+                               std::vector<int>& order,
+                               std::vector<int>& component_start);
+
+    /// Renumbering of a system consisting of num_blocks consecutive
+    /// blocks of cell equations and unknowns, each block renumbered
+    /// with the same cell permutation.
+    class CellPermutation
+    {
+    public:
+        /// Construct from the cell ordering new2old.
+        CellPermutation(const std::vector<int>& new2old, const int num_blocks);
+
+        /// Number of cells.
+        int numCells() const { return new2old_.size(); }
+
+        /// Returns P A P^T, i.e. A with rows and columns renumbered.
+        Eigen::SparseMatrix<double, Eigen::RowMajor>
+        permute(const Eigen::SparseMatrix<double, Eigen::RowMajor>& A) const;
+
+        /// Returns P x, i.e. x in the new numbering.
+        Eigen::Array<double, Eigen::Dynamic, 1>
+        permute(const Eigen::Array<double, Eigen::Dynamic, 1>& x) const;
+
+        /// Returns P^T x, i.e. x back in the original numbering.
+        Eigen::Array<double, Eigen::Dynamic, 1>
+        unpermute(const Eigen::Array<double, Eigen::Dynamic, 1>& x) const;
+
+    private:
+        std::vector<int> new2old_;
+        std::vector<int> old2new_; // Over all blocks.
+    };
+
+} // namespace Opm
+
+#endif // OPM_CELLORDERING_HEADER_INCLUDED
@@ -24,11 +24,14 @@
 
 #include <opm/autodiff/AutoDiffBlock.hpp>
 #include <opm/autodiff/AutoDiffHelpers.hpp>
+#include <opm/autodiff/BlackoilPhaseConfiguration.hpp>
 #include <opm/autodiff/BlackoilPropsAdInterface.hpp>
 #include <opm/autodiff/LinearisedBlackoilResidual.hpp>
 #include <opm/autodiff/NewtonIterationBlackoilInterface.hpp>
 
 #include <array>
+#include <memory>
+#include <string>
 
 struct UnstructuredGrid;
 struct Wells;
@@ -40,6 +43,8 @@ namespace Opm {
     class RockCompressibility;
     class NewtonIterationBlackoilInterface;
     class BlackoilState;
+    class BlackoilStateExtrapolation;
+    class BlackoilTransportReorder;
     class WellStateFullyImplicitBlackoil;
 
 
@@ -52,12 +57,22 @@ namespace Opm {
     ///
     /// It uses automatic differentiation via the class AutoDiffBlock
     /// to simplify assembly of the jacobian matrix.
-    template<class T>
+    ///
+    /// The PhaseConfig parameter may be one of the static phase
+    /// configurations in BlackoilPhaseConfiguration.hpp, in which
+    /// case the active phases and the dissolved gas and vaporized oil
+    /// features are compile-time constants, and the corresponding
+    /// branches in assembly and updateState() are eliminated. The
+    /// default determines them from the constructor arguments.
+    template<class T, class PhaseConfig = DynamicBlackoilPhaseConfiguration>
     class FullyImplicitBlackoilSolver
     {
     public:
         // the Newton relaxation type
-        enum RelaxType { DAMPEN, SOR };
+        enum RelaxType { DAMPEN, SOR, LINESEARCH };
+
+        // the coupling of pressure and saturations in step()
+        enum SolverApproach { FULLY_IMPLICIT, SEQUENTIAL };
 
         // class holding the solver parameters
         struct SolverParameter
@@ -75,6 +90,23 @@ namespace Opm {
             double                          tolerance_wells_;
             int                             max_iter_; // max newton iterations
             int                             min_iter_; // min newton iterations
+            std::string                     grid_operators_cache_; // cache file for HelperOps, empty to disable
+            bool                            lazy_jacobian_; // check convergence on a residual-only assembly
+            int                             line_search_max_cuts_; // max step halvings in the LINESEARCH relaxation
+            bool                            eisenstat_walker_; // adapt the linear solver reduction to the nonlinear progress
+            double                          ew_eta_max_; // loosest linear solver reduction, used in the first iteration
+            double                          ew_eta_min_; // tightest linear solver reduction
+            double                          ew_gamma_;
+            double                          ew_alpha_;
+            bool                            linear_warm_start_; // start the linear solver from the scaled previous increment
+            bool                            local_newton_; // solve only for unconverged cells in later iterations
+            int                             local_newton_halo_; // layers of neighbours added to the unconverged cells
+            double                          local_newton_max_fraction_; // largest fraction of cells for a local solve
+            enum SolverApproach             solver_approach_;
+            int                             sequential_max_inner_iter_; // max Newton iterations of each sequential stage
+            bool                            reorder_transport_; // start the sequential transport stage with a reordered solve
+            double                          reorder_tolerance_; // tolerance of the cell residuals in the reordered solve
+            int                             reorder_max_iter_; // max Newton iterations per cell in the reordered solve
 
             SolverParameter( const parameter::ParameterGroup& param );
             SolverParameter();
@@ -115,12 +147,25 @@ namespace Opm {
         ///                                   of the grid passed in the constructor.
         void setThresholdPressures(const std::vector<double>& threshold_pressures_by_face);
 
+        /// \brief Extrapolate the initial guess of each step in time.
+        /// The state at the beginning of step() is moved along the
+        /// extrapolation of the previous accepted states, limited by
+        /// the chopping of updateState(), and converged states are
+        /// added to the history. The history is retained, not copied,
+        /// so that it can be shared by solvers of consecutive report
+        /// steps. A null pointer disables extrapolation.
+        void setStateExtrapolation(BlackoilStateExtrapolation* extrapolation);
+
         /// Take a single forward step, modifiying
         ///   state.pressure()
         ///   state.faceflux()
         ///   state.saturation()
         ///   state.gasoilratio()
         ///   wstate.bhp()
+        /// With the SEQUENTIAL solver approach, each outer iteration
+        /// solves an implicit pressure equation with fixed saturations,
+        /// then the implicit transport equations with a fixed total
+        /// flux, until the fully implicit residual has converged.
         /// \param[in] dt        time step size
         /// \param[in] state     reservoir state
         /// \param[in] wstate    well state
@@ -133,6 +178,22 @@ namespace Opm {
         unsigned int newtonIterations () const { return newtonIterations_; }
         unsigned int linearIterations () const { return linearIterations_; }
 
+        /// Summary of a call to step(), also of a failed one.
+        struct StepReport
+        {
+            StepReport();
+            bool converged;
+            int newton_iterations;  // Newton iterations, inner iterations with SEQUENTIAL.
+            int linear_iterations;
+            double max_dp;          // Largest pressure change over the step.
+            double max_ds;          // Largest saturation change over the step.
+            // CNV per canonical phase, for each convergence check.
+            std::vector<std::array<double, BlackoilPropsAdInterface::MaxNumPhases> > cnv;
+        };
+
+        /// The report of the latest call to step().
+        const StepReport& lastStepReport() const { return step_report_; }
+
     private:
         // Types and enums
         typedef AutoDiffBlock<double> ADB;
@@ -148,8 +209,11 @@ namespace Opm {
             std::vector<ADB> accum; // Accumulations
             ADB              mflux; // Mass flux (surface conditions)
             ADB              b;     // Reciprocal FVF
+            ADB              mu;    // Viscosity
+            ADB              rho;   // Density
             ADB              head;  // Pressure drop across int. interfaces
             ADB              mob;   // Phase mobility (per cell)
+            UpwindSelector<double> upwind; // Upwind cells of head, kept between iterations
         };
 
         struct SolutionState {
@@ -163,10 +227,16 @@ namespace Opm {
             ADB              bhp;
             // Below are quantities stored in the state for optimization purposes.
             std::vector<ADB> canonical_phase_pressures; // Always has 3 elements, even if only 2 phases active.
+            ADB              rsSat; // Only defined if both oil and gas phases are active.
+            ADB              rvSat; // Only defined if both oil and gas phases are active.
         };
 
+        /// Perforation topology of the wells. Built once per
+        /// schedule change (the solver is constructed with the wells
+        /// of a report step) and reused by every Newton iteration.
         struct WellOps {
-            WellOps(const Wells* wells);
+            explicit WellOps(const Wells* wells);
+            std::vector<int> well_cells; // perf -> cell index, for subset() and supersetSum()
             M w2p;              // well -> perf (scatter)
             M p2w;              // perf -> well (gather)
         };
@@ -186,7 +256,8 @@ namespace Opm {
         const RockCompressibility*      rock_comp_props_;
         const Wells*                    wells_;
         const NewtonIterationBlackoilInterface&    linsolver_;
-        // For each canonical phase -> true if active
+        // For each canonical phase -> true if active.
+        // Use active() instead, which honours a static PhaseConfig.
         const std::vector<bool>         active_;
         // Size = # active phases. Maps active -> canonical phase indices.
         const std::vector<int>          canph_;
@@ -199,8 +270,13 @@ namespace Opm {
         SolverParameter                 param_;
         bool use_threshold_pressure_;
         V threshold_pressures_by_interior_face_;
+        BlackoilStateExtrapolation* extrapolation_;
 
         std::vector<ReservoirResidualQuant> rq_;
+        // Saturated Rs and Rv of the state passed to the latest
+        // assemble(), reused by updateState() for the old iterate.
+        V rsSat_;
+        V rvSat_;
         std::vector<PhasePresence> phaseCondition_;
         V well_perforation_pressure_diffs_; // Diff to bhp for each well perforation.
 
@@ -210,11 +286,32 @@ namespace Opm {
         bool terminal_output_;
         unsigned int newtonIterations_;
         unsigned int linearIterations_;
+        StepReport               step_report_;
+        std::vector<double>      step_start_pressure_;
+        std::vector<double>      step_start_saturation_;
 
         std::vector<int>         primalVariable_;
 
+        // Stage of the sequential solver. The cell unknowns of the
+        // other stage are constants in variableState(), and the
+        // transport stage computes the mass fluxes from total_flux_.
+        enum SequentialStage { CoupledStage, PressureStage, TransportStage };
+        SequentialStage          stage_;
+        V                        total_flux_; // Per internal face, fixed in the transport stage.
+        std::unique_ptr<BlackoilTransportReorder> reorder_; // Null unless reorder_transport is set.
+
         // Private methods.
 
+        // return true if canonical phase is active
+        bool active(const int phase) const
+        {
+            return PhaseConfig::IsStatic ? PhaseConfig::active(phase) : active_[phase];
+        }
+        // return true if gas can be dissolved in oil
+        bool hasDisgas() const { return PhaseConfig::IsStatic ? bool(PhaseConfig::HasDisgas) : has_disgas_; }
+        // return true if oil can be vaporized in gas
+        bool hasVapoil() const { return PhaseConfig::IsStatic ? bool(PhaseConfig::HasVapoil) : has_vapoil_; }
+
         // return true if wells are available
         bool wellsActive() const { return wells_ ? wells_->number_of_wells > 0 : false ; }
         // return wells object
@@ -227,9 +324,13 @@ namespace Opm {
         void
         makeConstantState(SolutionState& state) const;
 
+        /// The solution state with the primary variables of x and xw.
+        /// If with_derivatives is false, the primary variables are
+        /// constants, and no Jacobians are formed in the assembly.
         SolutionState
         variableState(const BlackoilState& x,
-                      const WellStateFullyImplicitBlackoil& xw) const;
+                      const WellStateFullyImplicitBlackoil& xw,
+                      const bool with_derivatives = true) const;
 
         void
         computeAccum(const SolutionState& state,
@@ -252,14 +353,78 @@ namespace Opm {
                                 ADB& well_phase_flow_rate,
                                 WellStateFullyImplicitBlackoil& xw) const;
 
+        /// Assemble the residual equations, and their Jacobian unless
+        /// with_derivatives is false. A residual-only assembly is
+        /// enough for checking convergence, but not for solveJacobianSystem().
         void
         assemble(const V&             dtpv,
                  const BlackoilState& x,
                  const bool initial_assembly,
-                 WellStateFullyImplicitBlackoil& xw);
+                 WellStateFullyImplicitBlackoil& xw,
+                 const bool with_derivatives = true);
 
         V solveJacobianSystem() const;
 
+        /// The sequential variant of step(), see SolverApproach.
+        int stepSequential(const double dt,
+                           BlackoilState& x,
+                           WellStateFullyImplicitBlackoil& xw);
+
+        /// The pressure equation, the sum of the mass balance
+        /// equations weighted to cancel the saturation derivatives of
+        /// the accumulation terms, and the well equations, with the
+        /// pressure and well unknowns of the latest assembly.
+        LinearisedBlackoilResidual pressureSystem(const BlackoilState& x) const;
+
+        /// The mass balance equations of the phases other than oil,
+        /// with the saturation unknowns (sw and xvar) of the latest assembly.
+        LinearisedBlackoilResidual transportSystem() const;
+
+        /// Sum of the phase fluxes of the latest assembly, in
+        /// reservoir volumes per internal face.
+        V totalFlux() const;
+
+        /// Solve the transport equations with total_flux_ cell by cell
+        /// in upwind order, with the properties other than the relative
+        /// permeabilities fixed at the latest assembly, and move x to
+        /// the resulting saturations.
+        /// \return the number of cell Newton iterations.
+        int solveTransportReordered(const double dt,
+                                    BlackoilState& x,
+                                    WellStateFullyImplicitBlackoil& xw);
+
+        /// Rs and rv of the latest assembly of x, zero unless both
+        /// oil and gas are active.
+        void cellRsRv(const BlackoilState& x, V& rs, V& rv) const;
+
+        /// Replace the mass fluxes of computeMassFlux() with the
+        /// fractional flow formulation of total_flux_.
+        void computeFractionalFlowFluxes();
+
+        /// The increment that updateState() needs to move state to
+        /// guess, with the current primal variables and no change of
+        /// the well variables.
+        V stateIncrement(const BlackoilState& state,
+                         const BlackoilState& guess) const;
+
+        /// Solve the Jacobian system with the given tolerance and
+        /// initial guess, see NewtonIterationBlackoilInterface::IncrementControls.
+        V solveJacobianSystem(const NewtonIterationBlackoilInterface::IncrementControls& controls) const;
+
+        /// Select the cells of a local Newton update: those with a
+        /// scaled residual (as in the CNV criterion) above
+        /// tolerance_cnv, the perforated cells, and local_newton_halo
+        /// layers of their neighbours.
+        /// \return false if the local update would include more than
+        ///         local_newton_max_fraction of the cells.
+        bool localNewtonCells(const double dt, std::vector<int>& cells) const;
+
+        /// Solve the Jacobian system restricted to the given (sorted)
+        /// cells and all well unknowns, with the other cells fixed.
+        /// The increment is zero for the fixed cells.
+        V solveLocalJacobianSystem(const std::vector<int>& cells,
+                                   const NewtonIterationBlackoilInterface::IncrementControls& controls) const;
+
         void updateState(const V& dx,
                          BlackoilState& state,
                          WellStateFullyImplicitBlackoil& well_state);
@@ -300,33 +465,6 @@ namespace Opm {
         /// and afterwards the norm of the residual of the well flux and the well equation.
         std::vector<double> computeResidualNorms() const;
 
-        ADB
-        fluidViscosity(const int               phase,
-                       const ADB&              p    ,
-                       const ADB&              temp ,
-                       const ADB&              rs   ,
-                       const ADB&              rv   ,
-                       const std::vector<PhasePresence>& cond,
-                       const std::vector<int>& cells) const;
-
-        ADB
-        fluidReciprocFVF(const int               phase,
-                         const ADB&              p    ,
-                         const ADB&              temp ,
-                         const ADB&              rs   ,
-                         const ADB&              rv   ,
-                         const std::vector<PhasePresence>& cond,
-                         const std::vector<int>& cells) const;
-
-        ADB
-        fluidDensity(const int               phase,
-                     const ADB&              p    ,
-                     const ADB&              temp ,
-                     const ADB&              rs   ,
-                     const ADB&              rv   ,
-                     const std::vector<PhasePresence>& cond,
-                     const std::vector<int>& cells) const;
-
         V
         fluidRsSat(const V&                p,
                    const V&                so,
@@ -373,10 +511,26 @@ namespace Opm {
         void
         updatePhaseCondFromPrimalVariable();
 
+        /// Set isRs, isRv and isSg to one in cells where Rs, Rv and Sg
+        /// respectively are the primary variable. The arguments must be
+        /// zero-initialised with one element per cell.
+        void
+        primalVariableIndicators(V& isRs, V& isRv, V& isSg) const;
+
         /// Compute convergence based on total mass balance (tol_mb) and maximum
-        /// residual mass balance (tol_cnv).
+        /// residual mass balance (tol_cnv). The CNV values are added
+        /// to the step report.
         bool getConvergence(const double dt, const int iteration);
 
+        /// Clear the step report and keep the state at the start of the step.
+        void startStepReport(const BlackoilState& x);
+
+        /// Complete the step report with the changes from the start of the step.
+        void finishStepReport(const BlackoilState& x,
+                              const bool converged,
+                              const int newton_iterations,
+                              const int linear_iterations);
+
         /// \brief Compute the reduction within the convergence check.
         /// \param[in] B     A matrix with MaxNumPhases columns and the same number rows
         ///                  as the number of cells of the grid. B.col(i) contains the values
@@ -411,6 +565,27 @@ namespace Opm {
 
         void stablizeNewton(V& dx, V& dxOld, const double omega, const RelaxType relax_type) const;
 
+        /// Apply the Newton update dx to x and xw, halving it until the
+        /// mass balance residuals decrease relative to residual_norms
+        /// (at most lineSearchMaxCuts() times). The residual of the
+        /// accepted state is assembled without derivatives.
+        void lineSearch(const V& dx,
+                        const V& pvdt,
+                        const std::vector<double>& residual_norms,
+                        BlackoilState& x,
+                        WellStateFullyImplicitBlackoil& xw);
+
+        /// Reduction of the mass balance residuals in the last Newton
+        /// iteration, the largest over the phases.
+        double residualReductionRatio(const std::vector<std::vector<double>>& residual_norms_history) const;
+
+        /// Eisenstat-Walker forcing term (choice 2) for the next linear
+        /// solve, computed from the progress of the mass balance
+        /// residuals in the last Newton iteration and the previous
+        /// forcing term eta_old.
+        double forcingTerm(const std::vector<std::vector<double>>& residual_norms_history,
+                           const double eta_old) const;
+
         double dpMaxRel() const { return param_.dp_max_rel_; }
         double dsMax() const { return param_.ds_max_; }
         double drMaxRel() const { return param_.dr_max_rel_; }
@@ -420,6 +595,14 @@ namespace Opm {
         double relaxRelTol() const { return param_.relax_rel_tol_; };
         double maxIter() const     { return param_.max_iter_; }
         double minIter() const     { return param_.min_iter_; }
+        bool lazyJacobian() const  { return param_.lazy_jacobian_; }
+        int lineSearchMaxCuts() const { return param_.line_search_max_cuts_; }
+        bool eisenstatWalker() const { return param_.eisenstat_walker_; }
+        bool linearWarmStart() const { return param_.linear_warm_start_; }
+        bool localNewton() const { return param_.local_newton_; }
+        bool sequential() const { return param_.solver_approach_ == SEQUENTIAL; }
+        int sequentialMaxInnerIter() const { return param_.sequential_max_inner_iter_; }
+        bool reorderTransport() const { return param_.reorder_transport_; }
         double maxResidualAllowed() const { return param_.max_residual_allowed_; }
 
     };
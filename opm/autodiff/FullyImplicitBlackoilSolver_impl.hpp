@@ -24,7 +24,10 @@
 
 #include <opm/autodiff/AutoDiffBlock.hpp>
 #include <opm/autodiff/AutoDiffHelpers.hpp>
+#include <opm/autodiff/BlackoilStateExtrapolation.hpp>
+#include <opm/autodiff/BlackoilTransportReorder.hpp>
 #include <opm/autodiff/GridHelpers.hpp>
+#include <opm/autodiff/GridOperatorsCache.hpp>
 #include <opm/autodiff/BlackoilPropsAdInterface.hpp>
 #include <opm/autodiff/GeoProps.hpp>
 #include <opm/autodiff/WellDensitySegmented.hpp>
@@ -132,8 +135,8 @@ namespace detail {
 
 } // namespace detail
 
-    template<class T>
-    void FullyImplicitBlackoilSolver<T>::SolverParameter::
+    template<class T, class PhaseConfig>
+    void FullyImplicitBlackoilSolver<T, PhaseConfig>::SolverParameter::
     reset()
     {
         // default values for the solver parameters
@@ -150,18 +153,35 @@ namespace detail {
         tolerance_mb_    = 1.0e-7;
         tolerance_cnv_   = 1.0e-3;
         tolerance_wells_ = 1./Opm::unit::day;
+        grid_operators_cache_.clear();
+        lazy_jacobian_   = false;
+        line_search_max_cuts_ = 5;
+        eisenstat_walker_ = false;
+        ew_eta_max_      = 0.1;
+        ew_eta_min_      = 1.0e-6;
+        ew_gamma_        = 0.9;
+        ew_alpha_        = 2.0;
+        linear_warm_start_ = false;
+        local_newton_    = false;
+        local_newton_halo_ = 1;
+        local_newton_max_fraction_ = 0.2;
+        solver_approach_ = FULLY_IMPLICIT;
+        sequential_max_inner_iter_ = 10;
+        reorder_transport_ = false;
+        reorder_tolerance_ = 1.0e-8;
+        reorder_max_iter_ = 20;
     }
 
-    template<class T>
-    FullyImplicitBlackoilSolver<T>::SolverParameter::
+    template<class T, class PhaseConfig>
+    FullyImplicitBlackoilSolver<T, PhaseConfig>::SolverParameter::
     SolverParameter()
     {
         // set default values
         reset();
     }
 
-    template<class T>
-    FullyImplicitBlackoilSolver<T>::SolverParameter::
+    template<class T, class PhaseConfig>
+    FullyImplicitBlackoilSolver<T, PhaseConfig>::SolverParameter::
     SolverParameter( const parameter::ParameterGroup& param )
     {
         // set default values
@@ -179,20 +199,47 @@ namespace detail {
         tolerance_mb_    = param.getDefault("tolerance_mb", tolerance_mb_);
         tolerance_cnv_   = param.getDefault("tolerance_cnv", tolerance_cnv_);
         tolerance_wells_ = param.getDefault("tolerance_wells", tolerance_wells_ );
+        grid_operators_cache_ = param.getDefault("grid_operators_cache", grid_operators_cache_);
+        lazy_jacobian_   = param.getDefault("lazy_jacobian", lazy_jacobian_);
+        line_search_max_cuts_ = param.getDefault("line_search_max_cuts", line_search_max_cuts_);
+        eisenstat_walker_ = param.getDefault("eisenstat_walker", eisenstat_walker_);
+        ew_eta_max_      = param.getDefault("ew_eta_max", ew_eta_max_);
+        ew_eta_min_      = param.getDefault("ew_eta_min", ew_eta_min_);
+        ew_gamma_        = param.getDefault("ew_gamma", ew_gamma_);
+        ew_alpha_        = param.getDefault("ew_alpha", ew_alpha_);
+        linear_warm_start_ = param.getDefault("linear_warm_start", linear_warm_start_);
+        local_newton_    = param.getDefault("local_newton", local_newton_);
+        local_newton_halo_ = param.getDefault("local_newton_halo", local_newton_halo_);
+        local_newton_max_fraction_ = param.getDefault("local_newton_max_fraction", local_newton_max_fraction_);
+        sequential_max_inner_iter_ = param.getDefault("sequential_max_inner_iter", sequential_max_inner_iter_);
+        reorder_transport_ = param.getDefault("reorder_transport", reorder_transport_);
+        reorder_tolerance_ = param.getDefault("reorder_tolerance", reorder_tolerance_);
+        reorder_max_iter_ = param.getDefault("reorder_max_iter", reorder_max_iter_);
 
         std::string relaxation_type = param.getDefault("relax_type", std::string("dampen"));
         if (relaxation_type == "dampen") {
             relax_type_ = DAMPEN;
         } else if (relaxation_type == "sor") {
             relax_type_ = SOR;
+        } else if (relaxation_type == "linesearch") {
+            relax_type_ = LINESEARCH;
         } else {
             OPM_THROW(std::runtime_error, "Unknown Relaxtion Type " << relaxation_type);
         }
+
+        std::string approach = param.getDefault("solver_approach", std::string("fully_implicit"));
+        if (approach == "fully_implicit") {
+            solver_approach_ = FULLY_IMPLICIT;
+        } else if (approach == "sequential") {
+            solver_approach_ = SEQUENTIAL;
+        } else {
+            OPM_THROW(std::runtime_error, "Unknown solver approach " << approach);
+        }
     }
 
 
-    template<class T>
-    FullyImplicitBlackoilSolver<T>::
+    template<class T, class PhaseConfig>
+    FullyImplicitBlackoilSolver<T, PhaseConfig>::
     FullyImplicitBlackoilSolver(const SolverParameter&          param,
                                 const Grid&                     grid ,
                                 const BlackoilPropsAdInterface& fluid,
@@ -212,12 +259,15 @@ namespace detail {
         , active_(detail::activePhases(fluid.phaseUsage()))
         , canph_ (detail::active2Canonical(fluid.phaseUsage()))
         , cells_ (detail::buildAllCells(Opm::AutoDiffGrid::numCells(grid)))
-        , ops_   (grid)
+        , ops_   (param.grid_operators_cache_.empty()
+                  ? HelperOps(grid)
+                  : cachedHelperOps(grid, param.grid_operators_cache_))
         , wops_  (wells_)
         , has_disgas_(has_disgas)
         , has_vapoil_(has_vapoil)
         , param_( param )
         , use_threshold_pressure_(false)
+        , extrapolation_(0)
         , rq_    (fluid.numPhases())
         , phaseCondition_(AutoDiffGrid::numCells(grid))
         , residual_ ( { std::vector<ADB>(fluid.numPhases(), ADB::null()),
@@ -226,7 +276,23 @@ namespace detail {
         , terminal_output_ (terminal_output)
         , newtonIterations_( 0 )
         , linearIterations_( 0 )
+        , stage_( CoupledStage )
     {
+        if (param_.reorder_transport_) {
+            reorder_.reset(new BlackoilTransportReorder(fluid_, ops_, param_.reorder_tolerance_,
+                                                        param_.reorder_max_iter_, param_.ds_max_));
+        }
+        if (PhaseConfig::IsStatic) {
+            bool match = (has_disgas == bool(PhaseConfig::HasDisgas))
+                && (has_vapoil == bool(PhaseConfig::HasVapoil));
+            for (int phase = 0; phase < MaxNumPhases; ++phase) {
+                match = match && (active_[phase] == PhaseConfig::active(phase));
+            }
+            if (!match) {
+                OPM_THROW(std::logic_error, "Static phase configuration of FullyImplicitBlackoilSolver "
+                          "does not match the active phases and DISGAS/VAPOIL settings.");
+            }
+        }
 #if HAVE_MPI
         if ( terminal_output_ ) {
             if ( linsolver_.parallelInformation().type() == typeid(ParallelISTLInformation) )
@@ -242,9 +308,9 @@ namespace detail {
 
 
 
-    template<class T>
+    template<class T, class PhaseConfig>
     void
-    FullyImplicitBlackoilSolver<T>::
+    FullyImplicitBlackoilSolver<T, PhaseConfig>::
     setThresholdPressures(const std::vector<double>& threshold_pressures_by_face)
     {
         const int num_faces = AutoDiffGrid::numFaces(grid_);
@@ -263,22 +329,51 @@ namespace detail {
 
 
 
-    template<class T>
+    template<class T, class PhaseConfig>
+    void
+    FullyImplicitBlackoilSolver<T, PhaseConfig>::
+    setStateExtrapolation(BlackoilStateExtrapolation* extrapolation)
+    {
+        extrapolation_ = extrapolation;
+    }
+
+
+
+
+    template<class T, class PhaseConfig>
     int
-    FullyImplicitBlackoilSolver<T>::
+    FullyImplicitBlackoilSolver<T, PhaseConfig>::
     step(const double   dt,
          BlackoilState& x ,
          WellStateFullyImplicitBlackoil& xw)
     {
+        startStepReport(x);
+        if (sequential()) {
+            return stepSequential(dt, x, xw);
+        }
+
         const V pvdt = geo_.poreVolume() / dt;
 
-        if (active_[Gas]) { updatePrimalVariableFromState(x); }
+        if (active(Gas)) { updatePrimalVariableFromState(x); }
 
         // For each iteration we store in a vector the norms of the residual of
         // the mass balance for each active phase, the well flux and the well equations
         std::vector<std::vector<double>> residual_norms_history;
 
-        assemble(pvdt, x, true, xw);
+        // The first state of the history is the initial one.
+        if (extrapolation_ != 0 && extrapolation_->empty()) {
+            extrapolation_->addState(x, 0.0);
+        }
+        BlackoilState guess;
+        const bool extrapolate = extrapolation_ != 0 && extrapolation_->extrapolate(dt, x, guess);
+
+        // The initial assembly provides the accumulation terms of
+        // the old state, the Jacobian is only needed without extrapolation.
+        assemble(pvdt, x, true, xw, !extrapolate);
+        if (extrapolate) {
+            updateState(stateIncrement(x, guess), x, xw);
+            assemble(pvdt, x, false, xw);
+        }
 
 
         bool converged = false;
@@ -296,16 +391,32 @@ namespace detail {
         bool isStagnate = false;
         const enum RelaxType relaxtype = relaxType();
         int linearIterations = 0;
+        double eta = param_.ew_eta_max_;
 
         while ( (!converged && (it < maxIter())) || (minIter() > it)) {
-            V dx = solveJacobianSystem();
+            NewtonIterationBlackoilInterface::IncrementControls controls;
+            if (eisenstatWalker()) {
+                if (it > 0) {
+                    eta = forcingTerm(residual_norms_history, eta);
+                }
+                controls.reduction = eta;
+            }
+            if (linearWarmStart() && it > 0) {
+                // The increments are expected to shrink like the residuals.
+                controls.initial_guess = std::min(residualReductionRatio(residual_norms_history), 1.0) * dxOld;
+            }
+            // Late iterations may only need to update the cells
+            // that have not converged.
+            std::vector<int> local_cells;
+            const bool local = localNewton() && it > 0 && localNewtonCells(dt, local_cells);
+            V dx = local ? solveLocalJacobianSystem(local_cells, controls) : solveJacobianSystem(controls);
 
             // store number of linear iterations used
             linearIterations += linsolver_.iterations();
 
             detectNewtonOscillations(residual_norms_history, it, relaxRelTol(), isOscillate, isStagnate);
 
-            if (isOscillate) {
+            if (isOscillate && relaxtype != LINESEARCH) {
                 omega -= relaxIncrement();
                 omega = std::max(omega, relaxMax());
                 if (terminal_output_)
@@ -316,9 +427,16 @@ namespace detail {
 
             stablizeNewton(dx, dxOld, omega, relaxtype);
 
-            updateState(dx, x, xw);
-
-            assemble(pvdt, x, false, xw);
+            // With lazy Jacobians or a line search the convergence check
+            // only needs the residual, and the Jacobian is assembled
+            // when another iteration follows.
+            const bool residual_only = lazyJacobian() || relaxtype == LINESEARCH;
+            if (relaxtype == LINESEARCH) {
+                lineSearch(dx, pvdt, residual_norms_history.back(), x, xw);
+            } else {
+                updateState(dx, x, xw);
+                assemble(pvdt, x, false, xw, !residual_only);
+            }
 
             residual_norms_history.push_back(computeResidualNorms());
 
@@ -326,8 +444,13 @@ namespace detail {
             ++it;
 
             converged = getConvergence(dt,it);
+
+            if (residual_only && ((!converged && (it < maxIter())) || (minIter() > it))) {
+                assemble(pvdt, x, false, xw);
+            }
         }
 
+        finishStepReport(x, converged, it, linearIterations);
         if (!converged) {
             std::cerr << "WARNING: Failed to compute converged solution in " << it << " iterations." << std::endl;
             return -1; // -1 indicates that the solver has to be restarted
@@ -336,6 +459,10 @@ namespace detail {
         linearIterations_ += linearIterations;
         newtonIterations_ += it;
 
+        if (extrapolation_ != 0) {
+            extrapolation_->addState(x, dt);
+        }
+
         return linearIterations;
     }
 
@@ -343,11 +470,13 @@ namespace detail {
 
 
 
-    template<class T>
-    FullyImplicitBlackoilSolver<T>::ReservoirResidualQuant::ReservoirResidualQuant()
+    template<class T, class PhaseConfig>
+    FullyImplicitBlackoilSolver<T, PhaseConfig>::ReservoirResidualQuant::ReservoirResidualQuant()
         : accum(2, ADB::null())
         , mflux(   ADB::null())
         , b    (   ADB::null())
+        , mu   (   ADB::null())
+        , rho  (   ADB::null())
         , head (   ADB::null())
         , mob  (   ADB::null())
     {
@@ -357,8 +486,22 @@ namespace detail {
 
 
 
-    template<class T>
-    FullyImplicitBlackoilSolver<T>::SolutionState::SolutionState(const int np)
+    template<class T, class PhaseConfig>
+    FullyImplicitBlackoilSolver<T, PhaseConfig>::StepReport::StepReport()
+        : converged(false)
+        , newton_iterations(0)
+        , linear_iterations(0)
+        , max_dp(0.0)
+        , max_ds(0.0)
+    {
+    }
+
+
+
+
+
+    template<class T, class PhaseConfig>
+    FullyImplicitBlackoilSolver<T, PhaseConfig>::SolutionState::SolutionState(const int np)
         : pressure  (    ADB::null())
         , temperature(   ADB::null())
         , saturation(np, ADB::null())
@@ -367,6 +510,8 @@ namespace detail {
         , qs        (    ADB::null())
         , bhp       (    ADB::null())
         , canonical_phase_pressures(3, ADB::null())
+        , rsSat     (    ADB::null())
+        , rvSat     (    ADB::null())
     {
     }
 
@@ -374,25 +519,29 @@ namespace detail {
 
 
 
-    template<class T>
-    FullyImplicitBlackoilSolver<T>::
+    template<class T, class PhaseConfig>
+    FullyImplicitBlackoilSolver<T, PhaseConfig>::
     WellOps::WellOps(const Wells* wells)
-      : w2p(),
+      : well_cells(),
+        w2p(),
         p2w()
     {
         if( wells )
         {
-            w2p = M(wells->well_connpos[ wells->number_of_wells ], wells->number_of_wells);
-            p2w = M(wells->number_of_wells, wells->well_connpos[ wells->number_of_wells ]);
+            const int        nw    = wells->number_of_wells;
+            const int* const wpos  = wells->well_connpos;
+            const int        nperf = wpos[nw];
+
+            w2p = M(nperf, nw);
+            p2w = M(nw, nperf);
 
-            const int        nw   = wells->number_of_wells;
-            const int* const wpos = wells->well_connpos;
+            well_cells.assign(wells->well_cells, wells->well_cells + nperf);
 
             typedef Eigen::Triplet<double> Tri;
 
             std::vector<Tri> scatter, gather;
-            scatter.reserve(wpos[nw]);
-            gather .reserve(wpos[nw]);
+            scatter.reserve(nperf);
+            gather .reserve(nperf);
 
             for (int w = 0, i = 0; w < nw; ++w) {
                 for (; i < wpos[ w + 1 ]; ++i) {
@@ -410,23 +559,21 @@ namespace detail {
 
 
 
-    template<class T>
-    typename FullyImplicitBlackoilSolver<T>::SolutionState
-    FullyImplicitBlackoilSolver<T>::constantState(const BlackoilState& x,
+    template<class T, class PhaseConfig>
+    typename FullyImplicitBlackoilSolver<T, PhaseConfig>::SolutionState
+    FullyImplicitBlackoilSolver<T, PhaseConfig>::constantState(const BlackoilState& x,
                                                   const WellStateFullyImplicitBlackoil&     xw) const
     {
-        auto state = variableState(x, xw);
-        makeConstantState(state);
-        return state;
+        return variableState(x, xw, false);
     }
 
 
 
 
 
-    template<class T>
+    template<class T, class PhaseConfig>
     void
-    FullyImplicitBlackoilSolver<T>::makeConstantState(SolutionState& state) const
+    FullyImplicitBlackoilSolver<T, PhaseConfig>::makeConstantState(SolutionState& state) const
     {
         // HACK: throw away the derivatives. this may not be the most
         // performant way to do things, but it will make the state
@@ -453,10 +600,11 @@ namespace detail {
 
 
 
-    template<class T>
-    typename FullyImplicitBlackoilSolver<T>::SolutionState
-    FullyImplicitBlackoilSolver<T>::variableState(const BlackoilState& x,
-                                                  const WellStateFullyImplicitBlackoil&     xw) const
+    template<class T, class PhaseConfig>
+    typename FullyImplicitBlackoilSolver<T, PhaseConfig>::SolutionState
+    FullyImplicitBlackoilSolver<T, PhaseConfig>::variableState(const BlackoilState& x,
+                                                  const WellStateFullyImplicitBlackoil&     xw,
+                                                  const bool with_derivatives) const
     {
         using namespace Opm::AutoDiffGrid;
         const int nc = numCells(grid_);
@@ -475,8 +623,8 @@ namespace detail {
         const DataBlock s = Eigen::Map<const DataBlock>(& x.saturation()[0], nc, np);
         const Opm::PhaseUsage pu = fluid_.phaseUsage();
         // We do not handle a Water/Gas situation correctly, guard against it.
-        assert (active_[ Oil]);
-        if (active_[ Water ]) {
+        assert (active(Oil));
+        if (active(Water)) {
             const V sw = s.col(pu.phase_pos[ Water ]);
             vars0.push_back(sw);
         }
@@ -486,23 +634,8 @@ namespace detail {
         V isRv = V::Zero(nc,1);
         V isSg = V::Zero(nc,1);
 
-        if (active_[ Gas ]){
-            for (int c = 0; c < nc ; c++ ) {
-                switch (primalVariable_[c]) {
-                case PrimalVariables::RS:
-                    isRs[c] = 1;
-                    break;
-
-                case PrimalVariables::RV:
-                    isRv[c] = 1;
-                    break;
-
-                default:
-                    isSg[c] = 1;
-                    break;
-                }
-            }
-
+        if (active(Gas)){
+            primalVariableIndicators(isRs, isRv, isSg);
 
             // define new primary variable xvar depending on solution condition
             V xvar(nc);
@@ -538,7 +671,31 @@ namespace detail {
             vars0.push_back(V());
         }
 
-        std::vector<ADB> vars = ADB::variables(vars0);
+        std::vector<ADB> vars;
+        if (with_derivatives) {
+            vars = ADB::variables(vars0);
+            if (stage_ != CoupledStage) {
+                // Keep the block structure, but fix the unknowns of
+                // the other stage: the saturations (sw and xvar) in
+                // the pressure stage, the pressure and wells in the
+                // transport stage.
+                std::vector<int> bpat;
+                for (const V& v : vars0) {
+                    bpat.push_back(v.size());
+                }
+                for (int var = 0; var < int(vars0.size()); ++var) {
+                    const bool saturation_var = var > 0 && var < np;
+                    if (saturation_var != (stage_ == TransportStage)) {
+                        vars[var] = ADB::constant(vars0[var], bpat);
+                    }
+                }
+            }
+        } else {
+            vars.reserve(vars0.size());
+            for (const V& v : vars0) {
+                vars.emplace_back(ADB::constant(v));
+            }
+        }
 
         SolutionState state(np);
 
@@ -555,13 +712,13 @@ namespace detail {
 
             ADB so = ADB::constant(V::Ones(nc, 1));
 
-            if (active_[ Water ]) {
+            if (active(Water)) {
                 state.saturation[pu.phase_pos[ Water ]] = std::move(vars[ nextvar++ ]);
                 const ADB& sw = state.saturation[pu.phase_pos[ Water ]];
                 so -= sw;
             }
 
-            if (active_[ Gas ]) {
+            if (active(Gas)) {
                 // Define Sg Rs and Rv in terms of xvar.
                 // Xvar is only defined if gas phase is active
                 const ADB& xvar = vars[ nextvar++ ];
@@ -569,28 +726,28 @@ namespace detail {
                 sg = isSg*xvar + isRv* so;
                 so -= sg;
 
-                if (active_[ Oil ]) {
+                if (active(Oil)) {
                     // RS and RV is only defined if both oil and gas phase are active.
-                    const ADB& sw = (active_[ Water ]
+                    const ADB& sw = (active(Water)
                                              ? state.saturation[ pu.phase_pos[ Water ] ]
                                              : ADB::constant(V::Zero(nc, 1)));
                     state.canonical_phase_pressures = computePressures(state.pressure, sw, so, sg);
-                    const ADB rsSat = fluidRsSat(state.canonical_phase_pressures[ Oil ], so , cells_);
-                    if (has_disgas_) {
-                        state.rs = (1-isRs) * rsSat + isRs*xvar;
+                    state.rsSat = fluidRsSat(state.canonical_phase_pressures[ Oil ], so , cells_);
+                    if (hasDisgas()) {
+                        state.rs = (1-isRs) * state.rsSat + isRs*xvar;
                     } else {
-                        state.rs = rsSat;
+                        state.rs = state.rsSat;
                     }
-                    const ADB rvSat = fluidRvSat(state.canonical_phase_pressures[ Gas ], so , cells_);
-                    if (has_vapoil_) {
-                        state.rv = (1-isRv) * rvSat + isRv*xvar;
+                    state.rvSat = fluidRvSat(state.canonical_phase_pressures[ Gas ], so , cells_);
+                    if (hasVapoil()) {
+                        state.rv = (1-isRv) * state.rvSat + isRv*xvar;
                     } else {
-                        state.rv = rvSat;
+                        state.rv = state.rvSat;
                     }
                 }
             }
 
-            if (active_[ Oil ]) {
+            if (active(Oil)) {
                 // Note that so is never a primary variable.
                 state.saturation[pu.phase_pos[ Oil ]] = std::move(so);
             }
@@ -611,9 +768,9 @@ namespace detail {
 
 
 
-    template<class T>
+    template<class T, class PhaseConfig>
     void
-    FullyImplicitBlackoilSolver<T>::computeAccum(const SolutionState& state,
+    FullyImplicitBlackoilSolver<T, PhaseConfig>::computeAccum(const SolutionState& state,
                                               const int            aix  )
     {
         const Opm::PhaseUsage& pu = fluid_.phaseUsage();
@@ -630,16 +787,22 @@ namespace detail {
 
         const int maxnp = Opm::BlackoilPhases::MaxNumPhases;
         for (int phase = 0; phase < maxnp; ++phase) {
-            if (active_[ phase ]) {
+            if (active(phase)) {
                 const int pos = pu.phase_pos[ phase ];
-                rq_[pos].b = fluidReciprocFVF(phase, state.canonical_phase_pressures[phase], temp, rs, rv, cond, cells_);
+                // The viscosity and density of the current state are
+                // evaluated together with b, and used in computeMassFlux().
+                BlackoilPropsAdInterface::PhaseProperties props =
+                    fluid_.phaseProperties(phase, state.canonical_phase_pressures[phase], temp, rs, rv, cond, cells_);
+                rq_[pos].b   = std::move(props.b);
+                rq_[pos].mu  = std::move(props.mu);
+                rq_[pos].rho = std::move(props.rho);
                 rq_[pos].accum[aix] = pv_mult * rq_[pos].b * sat[pos];
                 // DUMP(rq_[pos].b);
                 // DUMP(rq_[pos].accum[aix]);
             }
         }
 
-        if (active_[ Oil ] && active_[ Gas ]) {
+        if (active(Oil) && active(Gas)) {
             // Account for gas dissolved in oil and vaporized oil
             const int po = pu.phase_pos[ Oil ];
             const int pg = pu.phase_pos[ Gas ];
@@ -658,8 +821,8 @@ namespace detail {
 
 
 
-    template<class T>
-    void FullyImplicitBlackoilSolver<T>::computeWellConnectionPressures(const SolutionState& state,
+    template<class T, class PhaseConfig>
+    void FullyImplicitBlackoilSolver<T, PhaseConfig>::computeWellConnectionPressures(const SolutionState& state,
                                                                         const WellStateFullyImplicitBlackoil& xw)
     {
         if( ! wellsActive() ) return ;
@@ -670,7 +833,7 @@ namespace detail {
         //    taking std::vector<double> arguments, and not Eigen objects.
         const int nperf = wells().well_connpos[wells().number_of_wells];
         const int nw = wells().number_of_wells;
-        const std::vector<int> well_cells(wells().well_cells, wells().well_cells + nperf);
+        const std::vector<int>& well_cells = wops_.well_cells;
 
         // Compute the average pressure in each well block
         const V perf_press = Eigen::Map<const V>(xw.perfPress().data(), nperf);
@@ -684,7 +847,8 @@ namespace detail {
         }
 
         // Use cell values for the temperature as the wells don't knows its temperature yet.
-        const ADB perf_temp = subset(state.temperature, well_cells);
+        // Only values are needed below, so gather them with direct indexed loads.
+        const ADB perf_temp = ADB::constant(subset(state.temperature.value(), well_cells));
 
         // Compute b, rsmax, rvmax values for perforations.
         // Evaluate the properties using average well block pressures
@@ -703,17 +867,17 @@ namespace detail {
             const V bw = fluid_.bWat(avg_press_ad, perf_temp, well_cells).value();
             b.col(pu.phase_pos[BlackoilPhases::Aqua]) = bw;
         }
-        assert(active_[Oil]);
+        assert(active(Oil));
         const V perf_so =  subset(state.saturation[pu.phase_pos[Oil]].value(), well_cells);
         if (pu.phase_used[BlackoilPhases::Liquid]) {
-            const ADB perf_rs = subset(state.rs, well_cells);
+            const ADB perf_rs = ADB::constant(subset(state.rs.value(), well_cells));
             const V bo = fluid_.bOil(avg_press_ad, perf_temp, perf_rs, perf_cond, well_cells).value();
             b.col(pu.phase_pos[BlackoilPhases::Liquid]) = bo;
             const V rssat = fluidRsSat(avg_press, perf_so, well_cells);
             rsmax_perf.assign(rssat.data(), rssat.data() + nperf);
         }
         if (pu.phase_used[BlackoilPhases::Vapour]) {
-            const ADB perf_rv = subset(state.rv, well_cells);
+            const ADB perf_rv = ADB::constant(subset(state.rv.value(), well_cells));
             const V bg = fluid_.bGas(avg_press_ad, perf_temp, perf_rv, perf_cond, well_cells).value();
             b.col(pu.phase_pos[BlackoilPhases::Vapour]) = bg;
             const V rvsat = fluidRvSat(avg_press, perf_so, well_cells);
@@ -751,27 +915,22 @@ namespace detail {
 
 
 
-    template<class T>
+    template<class T, class PhaseConfig>
     void
-    FullyImplicitBlackoilSolver<T>::
+    FullyImplicitBlackoilSolver<T, PhaseConfig>::
     assemble(const V&             pvdt,
              const BlackoilState& x   ,
              const bool initial_assembly,
-             WellStateFullyImplicitBlackoil& xw  )
+             WellStateFullyImplicitBlackoil& xw,
+             const bool with_derivatives)
     {
         using namespace Opm::AutoDiffGrid;
         // Create the primary variables.
-        SolutionState state = variableState(x, xw);
+        SolutionState state = variableState(x, xw, with_derivatives);
 
-        if (initial_assembly) {
-            // Create the (constant, derivativeless) initial state.
-            SolutionState state0 = state;
-            makeConstantState(state0);
-            // Compute initial accumulation contributions
-            // and well connection pressures.
-            computeAccum(state0, 0);
-            computeWellConnectionPressures(state0, xw);
-        }
+        // Remember the saturated Rs and Rv for updateState().
+        rsSat_ = state.rsSat.value();
+        rvSat_ = state.rvSat.value();
 
         // DISKVAL(state.pressure);
         // DISKVAL(state.saturation[0]);
@@ -788,10 +947,24 @@ namespace detail {
         // except gas. For gas, we compute b_g*s_g + Rs*b_o*s_o.
         // These quantities are stored in rq_[phase].accum[1].
         // The corresponding accumulation terms from the start of
-        // the timestep (b^0_p*s^0_p etc.) were already computed
-        // on the initial call to assemble() and stored in rq_[phase].accum[0].
+        // the timestep (b^0_p*s^0_p etc.) are computed on the initial
+        // call to assemble() and stored in rq_[phase].accum[0].
         computeAccum(state, 1);
 
+        if (initial_assembly) {
+            // The initial state has the same values as the current
+            // one, so the initial accumulation terms are the current
+            // ones without derivatives.
+            for (int phaseIdx = 0; phaseIdx < fluid_.numPhases(); ++phaseIdx) {
+                rq_[phaseIdx].accum[0] = ADB::constant(rq_[phaseIdx].accum[1].value());
+            }
+            // Create the (constant, derivativeless) initial state
+            // and compute the well connection pressures.
+            SolutionState state0 = state;
+            makeConstantState(state0);
+            computeWellConnectionPressures(state0, xw);
+        }
+
         // Set up the common parts of the mass balance equations
         // for each active phase.
         const V transi = subset(geo_.transmissibility(), ops_.internal_faces);
@@ -802,10 +975,14 @@ namespace detail {
             // std::cout << kr[phase];
             // std::cout << "===== rq_[" << phase << "].mflux = \n" << std::endl;
             // std::cout << rq_[phase].mflux;
-
+        }
+        if (stage_ == TransportStage) {
+            computeFractionalFlowFluxes();
+        }
+        for (int phaseIdx = 0; phaseIdx < fluid_.numPhases(); ++phaseIdx) {
             residual_.material_balance_eq[ phaseIdx ] =
                 pvdt*(rq_[phaseIdx].accum[1] - rq_[phaseIdx].accum[0])
-                + ops_.div*rq_[phaseIdx].mflux;
+                + applyDiv(ops_, rq_[phaseIdx].mflux);
 
 
             // DUMP(ops_.div*rq_[phase].mflux);
@@ -817,20 +994,17 @@ namespace detail {
         // Add the extra (flux) terms to the mass balance equations
         // From gas dissolved in the oil phase (rs) and oil vaporized in the gas phase (rv)
         // The extra terms in the accumulation part of the equation are already handled.
-        if (active_[ Oil ] && active_[ Gas ]) {
+        if (active(Oil) && active(Gas)) {
             const int po = fluid_.phaseUsage().phase_pos[ Oil ];
             const int pg = fluid_.phaseUsage().phase_pos[ Gas ];
 
-            const UpwindSelector<double> upwindOil(grid_, ops_,
-                                                rq_[po].head.value());
-            const ADB rs_face = upwindOil.select(state.rs);
-
-            const UpwindSelector<double> upwindGas(grid_, ops_,
-                                                rq_[pg].head.value());
-            const ADB rv_face = upwindGas.select(state.rv);
+            // Upwind directions of the oil and gas heads were
+            // determined in computeMassFlux().
+            const ADB rs_face = rq_[po].upwind.select(state.rs);
+            const ADB rv_face = rq_[pg].upwind.select(state.rv);
 
-            residual_.material_balance_eq[ pg ] += ops_.div * (rs_face * rq_[po].mflux);
-            residual_.material_balance_eq[ po ] += ops_.div * (rv_face * rq_[pg].mflux);
+            residual_.material_balance_eq[ pg ] += applyDiv(ops_, rs_face * rq_[po].mflux);
+            residual_.material_balance_eq[ po ] += applyDiv(ops_, rv_face * rq_[pg].mflux);
 
             // DUMP(residual_.material_balance_eq[ Gas ]);
 
@@ -848,27 +1022,25 @@ namespace detail {
 
 
 
-    template <class T>
-    void FullyImplicitBlackoilSolver<T>::addWellEq(const SolutionState& state,
+    template<class T, class PhaseConfig>
+    void FullyImplicitBlackoilSolver<T, PhaseConfig>::addWellEq(const SolutionState& state,
                                                    WellStateFullyImplicitBlackoil& xw,
                                                    V& aliveWells)
     {
         if( ! wellsActive() ) return ;
 
-        const int nc = Opm::AutoDiffGrid::numCells(grid_);
         const int np = wells().number_of_phases;
         const int nw = wells().number_of_wells;
         const int nperf = wells().well_connpos[nw];
         const Opm::PhaseUsage& pu = fluid_.phaseUsage();
         V Tw = Eigen::Map<const V>(wells().WI, nperf);
-        const std::vector<int> well_cells(wells().well_cells, wells().well_cells + nperf);
 
         // pressure diffs computed already (once per step, not changing per iteration)
         const V& cdp = well_perforation_pressure_diffs_;
 
         // Extract variables for perforation cell pressures
         // and corresponding perforation well pressures.
-        const ADB p_perfcell = subset(state.pressure, well_cells);
+        const ADB p_perfcell = subset(state.pressure, wops_.well_cells);
 
         // DUMPVAL(p_perfcell);
         // DUMPVAL(state.bhp);
@@ -922,22 +1094,31 @@ namespace detail {
         }
 
 
+        // Gather the perforation cell quantities once.
+        std::vector<ADB> perf_mob(np, ADB::null());
+        std::vector<ADB> perf_b(np, ADB::null());
+        for (int phase = 0; phase < np; ++phase) {
+            perf_mob[phase] = subset(rq_[phase].mob, wops_.well_cells);
+            perf_b[phase]   = subset(rq_[phase].b, wops_.well_cells);
+        }
+        const ADB perf_rs = subset(state.rs, wops_.well_cells);
+        const ADB perf_rv = subset(state.rv, wops_.well_cells);
+
         // HANDLE FLOW INTO WELLBORE
 
         // compute phase volumerates standard conditions
         std::vector<ADB> cq_ps(np, ADB::null());
         for (int phase = 0; phase < np; ++phase) {
-            const ADB& wellcell_mob = subset ( rq_[phase].mob, well_cells);
-            const ADB cq_p = -(isNotInjInx * Tw) * (wellcell_mob * drawdown);
-            cq_ps[phase] = subset(rq_[phase].b,well_cells) * cq_p;
+            const ADB cq_p = -(isNotInjInx * Tw) * (perf_mob[phase] * drawdown);
+            cq_ps[phase] = perf_b[phase] * cq_p;
         }
-        if (active_[Oil] && active_[Gas]) {
+        if (active(Oil) && active(Gas)) {
             const int oilpos = pu.phase_pos[Oil];
             const int gaspos = pu.phase_pos[Gas];
             ADB cq_psOil = cq_ps[oilpos];
             ADB cq_psGas = cq_ps[gaspos];
-            cq_ps[gaspos] += subset(state.rs,well_cells) * cq_psOil;
-            cq_ps[oilpos] += subset(state.rv,well_cells) * cq_psGas;
+            cq_ps[gaspos] += perf_rs * cq_psOil;
+            cq_ps[oilpos] += perf_rv * cq_psGas;
         }
 
         // phase rates at std. condtions
@@ -982,9 +1163,9 @@ namespace detail {
         // HANDLE FLOW OUT FROM WELLBORE
 
         // Total mobilities
-        ADB mt = subset(rq_[0].mob,well_cells);
+        ADB mt = perf_mob[0];
         for (int phase = 1; phase < np; ++phase) {
-            mt += subset(rq_[phase].mob,well_cells);
+            mt += perf_mob[phase];
         }
 
         // DUMPVAL(ADB::constant(isInjInx));
@@ -1002,22 +1183,20 @@ namespace detail {
             cmix_s[phase] = wops_.w2p * mix_s[phase];
         }
 
-        ADB well_rv = subset(state.rv,well_cells);
-        ADB well_rs = subset(state.rs,well_cells);
-        ADB d = V::Constant(nperf,1.0) -  well_rv * well_rs;
+        ADB d = V::Constant(nperf,1.0) -  perf_rv * perf_rs;
 
         for (int phase = 0; phase < np; ++phase) {
             ADB tmp = cmix_s[phase];
 
-            if (phase == Oil && active_[Gas]) {
+            if (phase == Oil && active(Gas)) {
                 const int gaspos = pu.phase_pos[Gas];
-                tmp = tmp - subset(state.rv,well_cells) * cmix_s[gaspos] / d;
+                tmp = tmp - perf_rv * cmix_s[gaspos] / d;
             }
-            if (phase == Gas && active_[Oil]) {
+            if (phase == Gas && active(Oil)) {
                 const int oilpos = pu.phase_pos[Oil];
-                tmp = tmp - subset(state.rs,well_cells) * cmix_s[oilpos] / d;
+                tmp = tmp - perf_rs * cmix_s[oilpos] / d;
             }
-            volRat += tmp / subset(rq_[phase].b,well_cells);
+            volRat += tmp / perf_b[phase];
         }
 
         // DUMPVAL(cqt_i);
@@ -1036,8 +1215,9 @@ namespace detail {
         // DUMPVAL(cq_ps[2]);
 
         // Add well contributions to mass balance equations
+        const int nc = Opm::AutoDiffGrid::numCells(grid_);
         for (int phase = 0; phase < np; ++phase) {
-            residual_.material_balance_eq[phase] -= superset(cq_s[phase],well_cells,nc);
+            residual_.material_balance_eq[phase] -= supersetSum(cq_s[phase], wops_.well_cells, nc);
         }
 
 
@@ -1142,8 +1322,8 @@ namespace detail {
 
 
 
-    template<class T>
-    void FullyImplicitBlackoilSolver<T>::updateWellControls(ADB& bhp,
+    template<class T, class PhaseConfig>
+    void FullyImplicitBlackoilSolver<T, PhaseConfig>::updateWellControls(ADB& bhp,
                                                             ADB& well_phase_flow_rate,
                                                             WellStateFullyImplicitBlackoil& xw) const
     {
@@ -1246,8 +1426,8 @@ namespace detail {
 
 
 
-    template<class T>
-    void FullyImplicitBlackoilSolver<T>::addWellControlEq(const SolutionState& state,
+    template<class T, class PhaseConfig>
+    void FullyImplicitBlackoilSolver<T, PhaseConfig>::addWellControlEq(const SolutionState& state,
                                                           const WellStateFullyImplicitBlackoil& xw,
                                                           const V& aliveWells)
     {
@@ -1317,8 +1497,8 @@ namespace detail {
 
 
 
-    template<class T>
-    V FullyImplicitBlackoilSolver<T>::solveJacobianSystem() const
+    template<class T, class PhaseConfig>
+    V FullyImplicitBlackoilSolver<T, PhaseConfig>::solveJacobianSystem() const
     {
         return linsolver_.computeNewtonIncrement(residual_);
     }
@@ -1327,6 +1507,331 @@ namespace detail {
 
 
 
+    template<class T, class PhaseConfig>
+    V FullyImplicitBlackoilSolver<T, PhaseConfig>::solveJacobianSystem(const NewtonIterationBlackoilInterface::IncrementControls& controls) const
+    {
+        return linsolver_.computeNewtonIncrement(residual_, controls);
+    }
+
+
+
+
+
+    template<class T, class PhaseConfig>
+    bool FullyImplicitBlackoilSolver<T, PhaseConfig>::localNewtonCells(const double dt,
+                                                                      std::vector<int>& cells) const
+    {
+        using namespace Opm::AutoDiffGrid;
+#if HAVE_MPI
+        // The active sets of the processes would not match.
+        if (linsolver_.parallelInformation().type() == typeid(ParallelISTLInformation)) {
+            return false;
+        }
+#endif
+        const int np = fluid_.numPhases();
+        const int nc = numCells(grid_);
+        const V pv = geo_.poreVolume();
+
+        // Scaled residual per cell, with the local instead of the
+        // average inverse formation volume factor.
+        std::vector<char> selected(nc, 0);
+        for (int phase = 0; phase < np; ++phase) {
+            const V cnv = dt * residual_.material_balance_eq[phase].value().abs()
+                / (rq_[phase].b.value() * pv);
+            for (int c = 0; c < nc; ++c) {
+                if (!(cnv[c] < param_.tolerance_cnv_)) {
+                    selected[c] = 1;
+                }
+            }
+        }
+        for (const int c : wops_.well_cells) {
+            selected[c] = 1;
+        }
+
+        // Neighbours of the selected cells, to let the update spread.
+        const int nif = ops_.nbi.rows();
+        for (int layer = 0; layer < param_.local_newton_halo_; ++layer) {
+            std::vector<char> grown = selected;
+            for (int f = 0; f < nif; ++f) {
+                const int c1 = ops_.nbi(f, 0);
+                const int c2 = ops_.nbi(f, 1);
+                if (selected[c1] || selected[c2]) {
+                    grown[c1] = 1;
+                    grown[c2] = 1;
+                }
+            }
+            selected.swap(grown);
+        }
+
+        cells.clear();
+        for (int c = 0; c < nc; ++c) {
+            if (selected[c]) {
+                cells.push_back(c);
+            }
+        }
+        return !cells.empty() && cells.size() <= param_.local_newton_max_fraction_ * nc;
+    }
+
+
+
+
+
+    template<class T, class PhaseConfig>
+    V FullyImplicitBlackoilSolver<T, PhaseConfig>::solveLocalJacobianSystem(const std::vector<int>& cells,
+                                                                            const NewtonIterationBlackoilInterface::IncrementControls& controls) const
+    {
+        using namespace Opm::AutoDiffGrid;
+        const int np = fluid_.numPhases();
+        const int nc = numCells(grid_);
+        const int na = cells.size();
+
+        // The cell unknowns (pressure, sw, xvar) come first, one
+        // block per phase, followed by the well unknowns.
+        LinearisedBlackoilResidual local_residual = {
+            std::vector<ADB>(np, ADB::null()),
+            restrictColumns(residual_.well_flux_eq, np, cells),
+            restrictColumns(residual_.well_eq, np, cells)
+        };
+        for (int phase = 0; phase < np; ++phase) {
+            local_residual.material_balance_eq[phase] =
+                restrictColumns(subset(residual_.material_balance_eq[phase], cells), np, cells);
+        }
+
+        const int nwell = residual_.sizeNonLinear() - np*nc;
+        NewtonIterationBlackoilInterface::IncrementControls local_controls;
+        local_controls.reduction = controls.reduction;
+        if (controls.initial_guess.size() > 0) {
+            local_controls.initial_guess.resize(np*na + nwell);
+            for (int block = 0; block < np; ++block) {
+                for (int i = 0; i < na; ++i) {
+                    local_controls.initial_guess[block*na + i] = controls.initial_guess[block*nc + cells[i]];
+                }
+            }
+            local_controls.initial_guess.tail(nwell) = controls.initial_guess.tail(nwell);
+        }
+
+        const V local_dx = linsolver_.computeNewtonIncrement(local_residual, local_controls);
+
+        V dx = V::Zero(np*nc + nwell);
+        for (int block = 0; block < np; ++block) {
+            for (int i = 0; i < na; ++i) {
+                dx[block*nc + cells[i]] = local_dx[block*na + i];
+            }
+        }
+        dx.tail(nwell) = local_dx.tail(nwell);
+        return dx;
+    }
+
+
+
+
+
+    namespace detail
+    {
+        /// The largest |r_i| scale_i, zero for an empty r.
+        inline double maxScaledResidual(const V& r, const V& scale)
+        {
+            return r.size() > 0 ? (r.abs() * scale).maxCoeff() : 0.0;
+        }
+
+        /// The equation with the given Jacobian blocks only. An
+        /// equation without derivatives (the well equations without
+        /// wells) gets empty blocks with the column counts of ref.
+        inline ADB selectBlocks(const ADB& eq, const std::vector<int>& blocks, const ADB& ref)
+        {
+            std::vector<M> jacs;
+            jacs.reserve(blocks.size());
+            for (const int block : blocks) {
+                if (eq.derivative().empty()) {
+                    jacs.push_back(M(eq.size(), ref.derivative()[block].cols()));
+                } else {
+                    jacs.push_back(eq.derivative()[block]);
+                }
+            }
+            return ADB::function(V(eq.value()), std::move(jacs));
+        }
+    } // namespace detail
+
+
+
+
+
+    template<class T, class PhaseConfig>
+    LinearisedBlackoilResidual
+    FullyImplicitBlackoilSolver<T, PhaseConfig>::pressureSystem(const BlackoilState& x) const
+    {
+        const int np = fluid_.numPhases();
+        const Opm::PhaseUsage& pu = fluid_.phaseUsage();
+
+        // Weights making the accumulation term sum to the pore
+        // volume for fixed b, rs and rv: 1/b for immiscible phases,
+        // and the inverse of the (b, rs, rv) matrix for oil and gas.
+        std::vector<V> weight(np);
+        for (int phase = 0; phase < np; ++phase) {
+            weight[phase] = 1.0 / rq_[phase].b.value();
+        }
+        if (active(Oil) && active(Gas)) {
+            const int po = pu.phase_pos[ Oil ];
+            const int pg = pu.phase_pos[ Gas ];
+            V rs, rv;
+            cellRsRv(x, rs, rv);
+            const V det = 1.0 - rs * rv;
+            const V wo = (weight[po] - rs * weight[pg]) / det;
+            const V wg = (weight[pg] - rv * weight[po]) / det;
+            weight[po] = wo;
+            weight[pg] = wg;
+        }
+
+        ADB pressure_eq = weight[0] * residual_.material_balance_eq[0];
+        for (int phase = 1; phase < np; ++phase) {
+            pressure_eq += weight[phase] * residual_.material_balance_eq[phase];
+        }
+
+        // Pressure, well rates and bhp.
+        const std::vector<int> blocks = { 0, np, np + 1 };
+        return LinearisedBlackoilResidual{
+            std::vector<ADB>(1, detail::selectBlocks(pressure_eq, blocks, pressure_eq)),
+            detail::selectBlocks(residual_.well_flux_eq, blocks, pressure_eq),
+            detail::selectBlocks(residual_.well_eq, blocks, pressure_eq)
+        };
+    }
+
+
+
+
+
+    template<class T, class PhaseConfig>
+    void
+    FullyImplicitBlackoilSolver<T, PhaseConfig>::cellRsRv(const BlackoilState& x, V& rs, V& rv) const
+    {
+        const int nc = AutoDiffGrid::numCells(grid_);
+        if (!(active(Oil) && active(Gas))) {
+            rs = V::Zero(nc);
+            rv = V::Zero(nc);
+            return;
+        }
+        // As in variableState(): the saturated values unless rs or
+        // rv is the primary variable.
+        V isRs = V::Zero(nc, 1);
+        V isRv = V::Zero(nc, 1);
+        V isSg = V::Zero(nc, 1);
+        primalVariableIndicators(isRs, isRv, isSg);
+        rs = rsSat_;
+        rv = rvSat_;
+        if (hasDisgas()) {
+            rs = isRs * Eigen::Map<const V>(& x.gasoilratio()[0], nc) + (1 - isRs) * rsSat_;
+        }
+        if (hasVapoil()) {
+            rv = isRv * Eigen::Map<const V>(& x.rv()[0], nc) + (1 - isRv) * rvSat_;
+        }
+    }
+
+
+
+
+
+    template<class T, class PhaseConfig>
+    int
+    FullyImplicitBlackoilSolver<T, PhaseConfig>::solveTransportReordered(const double dt,
+                                                                        BlackoilState& x,
+                                                                        WellStateFullyImplicitBlackoil& xw)
+    {
+        using namespace Opm::AutoDiffGrid;
+        const int nc = numCells(grid_);
+        const int np = fluid_.numPhases();
+        const Opm::PhaseUsage& pu = fluid_.phaseUsage();
+
+        BlackoilTransportReorder::Input input;
+        input.pvdt = geo_.poreVolume() / dt;
+        const ADB p = ADB::constant(Eigen::Map<const V>(& x.pressure()[0], nc));
+        input.pv_mult = poroMult(p).value();
+        const V tr_mult = transMult(p).value();
+        input.total_flux = total_flux_;
+        input.component.assign(np, std::vector<V>(np, V::Zero(nc)));
+        for (int phase = 0; phase < np; ++phase) {
+            input.head.push_back(rq_[phase].head.value());
+            input.mob_scale.push_back(tr_mult / rq_[phase].mu.value());
+            input.component[phase][phase] = rq_[phase].b.value();
+            input.accum0.push_back(rq_[phase].accum[0].value());
+        }
+        if (active(Oil) && active(Gas)) {
+            const int po = pu.phase_pos[ Oil ];
+            const int pg = pu.phase_pos[ Gas ];
+            V rs, rv;
+            cellRsRv(x, rs, rv);
+            input.component[pg][po] = rs * rq_[po].b.value();
+            input.component[po][pg] = rv * rq_[pg].b.value();
+        }
+
+        // Connection factors of the well terms of addWellEq(), with the
+        // drawdown and the injected rates of the latest assembly.
+        input.well_production = V::Zero(nc);
+        input.well_injection.assign(np, V::Zero(nc));
+        if (wellsActive()) {
+            const int nperf = wells().well_connpos[wells().number_of_wells];
+            for (int perf = 0; perf < nperf; ++perf) {
+                const int cell = wops_.well_cells[perf];
+                const double drawdown = x.pressure()[cell] - xw.perfPress()[perf];
+                if (drawdown >= 0.0) {
+                    input.well_production[cell] += wells().WI[perf] * drawdown;
+                } else {
+                    double mt = 0.0;
+                    for (int phase = 0; phase < np; ++phase) {
+                        mt += rq_[phase].mob.value()[cell];
+                    }
+                    if (mt > 0.0) {
+                        for (int phase = 0; phase < np; ++phase) {
+                            input.well_injection[phase][cell] += xw.perfPhaseRates()[perf*np + phase] / mt;
+                        }
+                    }
+                }
+            }
+        }
+
+        BlackoilState target = x;
+        const bool converged = reorder_->solve(input, target.saturation());
+        if (terminal_output_) {
+            std::cout << " Reordered transport: " << reorder_->iterations() << " cell iterations, "
+                      << reorder_->multiCellComponents() << " multi-cell components"
+                      << (converged ? "" : ", not converged") << std::endl;
+        }
+        updateState(stateIncrement(x, target), x, xw);
+        return reorder_->iterations();
+    }
+
+
+
+
+
+    template<class T, class PhaseConfig>
+    LinearisedBlackoilResidual
+    FullyImplicitBlackoilSolver<T, PhaseConfig>::transportSystem() const
+    {
+        const int np = fluid_.numPhases();
+        const int po = fluid_.phaseUsage().phase_pos[ Oil ];
+
+        // Saturation unknowns, sw and xvar.
+        std::vector<int> blocks;
+        for (int block = 1; block < np; ++block) {
+            blocks.push_back(block);
+        }
+        const ADB& ref = residual_.material_balance_eq[0];
+
+        // The wells are fixed, the well equations are empty.
+        const ADB no_eq = detail::selectBlocks(ADB::constant(V()), blocks, ref);
+        LinearisedBlackoilResidual system = { std::vector<ADB>(), no_eq, no_eq };
+        for (int phase = 0; phase < np; ++phase) {
+            if (phase != po) {
+                system.material_balance_eq.push_back(detail::selectBlocks(residual_.material_balance_eq[phase], blocks, ref));
+            }
+        }
+        return system;
+    }
+
+
+
+
+
     namespace detail
     {
 
@@ -1346,8 +1851,156 @@ namespace detail {
 
 
 
-    template<class T>
-    void FullyImplicitBlackoilSolver<T>::updateState(const V& dx,
+    template<class T, class PhaseConfig>
+    int
+    FullyImplicitBlackoilSolver<T, PhaseConfig>::
+    stepSequential(const double   dt,
+                   BlackoilState& x ,
+                   WellStateFullyImplicitBlackoil& xw)
+    {
+        using namespace Opm::AutoDiffGrid;
+        const int nc = numCells(grid_);
+        const int np = fluid_.numPhases();
+        const V pv = geo_.poreVolume();
+        const V pvdt = pv / dt;
+        const double tol_cnv = param_.tolerance_cnv_;
+
+        if (active(Gas)) { updatePrimalVariableFromState(x); }
+
+        stage_ = CoupledStage;
+        assemble(pvdt, x, true, xw, false);
+
+        int it = 0;
+        bool converged = getConvergence(dt, it);
+        int linearIterations = 0;
+        int innerIterations = 0;
+
+        while ( (!converged && (it < maxIter())) || (minIter() > it)) {
+            // Implicit pressure with fixed saturations.
+            stage_ = PressureStage;
+            for (int inner = 0; inner < sequentialMaxInnerIter(); ++inner) {
+                assemble(pvdt, x, false, xw);
+                const LinearisedBlackoilResidual system = pressureSystem(x);
+                const double cnv = detail::maxScaledResidual(system.material_balance_eq[0].value(), dt / pv);
+                if (cnv < tol_cnv
+                    && detail::infinityNorm(system.well_flux_eq) < param_.tolerance_wells_
+                    && detail::infinityNorm(system.well_eq) < Opm::unit::barsa) {
+                    break;
+                }
+                const V dxp = linsolver_.computeNewtonIncrement(system);
+                linearIterations += linsolver_.iterations();
+                ++innerIterations;
+
+                V dx = V::Zero(residual_.sizeNonLinear());
+                const int nwell = dxp.size() - nc;
+                dx.head(nc) = dxp.head(nc);
+                dx.tail(nwell) = dxp.tail(nwell);
+                updateState(dx, x, xw);
+            }
+
+            // Implicit transport with the total flux of the new pressure.
+            stage_ = CoupledStage;
+            assemble(pvdt, x, false, xw, false);
+            total_flux_ = totalFlux();
+            if (reorderTransport()) {
+                // The global Newton iterations below only correct for
+                // the properties lagged in the reordered solve.
+                solveTransportReordered(dt, x, xw);
+            }
+            stage_ = TransportStage;
+            for (int inner = 0; inner < sequentialMaxInnerIter(); ++inner) {
+                assemble(pvdt, x, false, xw);
+                const LinearisedBlackoilResidual system = transportSystem();
+                double cnv = 0.0;
+                for (int eq = 0; eq < np - 1; ++eq) {
+                    const int phase = eq < fluid_.phaseUsage().phase_pos[Oil] ? eq : eq + 1;
+                    cnv = std::max(cnv, detail::maxScaledResidual(system.material_balance_eq[eq].value(),
+                                                                   dt / (rq_[phase].b.value() * pv)));
+                }
+                if (cnv < tol_cnv) {
+                    break;
+                }
+                const V dxt = linsolver_.computeNewtonIncrement(system);
+                linearIterations += linsolver_.iterations();
+                ++innerIterations;
+
+                V dx = V::Zero(residual_.sizeNonLinear());
+                dx.segment(nc, (np - 1)*nc) = dxt;
+                updateState(dx, x, xw);
+            }
+
+            // Convergence of the coupled equations.
+            stage_ = CoupledStage;
+            assemble(pvdt, x, false, xw, false);
+            ++it;
+            converged = getConvergence(dt, it);
+        }
+
+        finishStepReport(x, converged, innerIterations, linearIterations);
+        if (!converged) {
+            std::cerr << "WARNING: Failed to compute converged solution in " << it << " sequential iterations." << std::endl;
+            return -1; // -1 indicates that the solver has to be restarted
+        }
+
+        linearIterations_ += linearIterations;
+        newtonIterations_ += innerIterations;
+
+        return linearIterations;
+    }
+
+
+
+
+
+    template<class T, class PhaseConfig>
+    V FullyImplicitBlackoilSolver<T, PhaseConfig>::stateIncrement(const BlackoilState& state,
+                                                                   const BlackoilState& guess) const
+    {
+        using namespace Opm::AutoDiffGrid;
+        const int np = fluid_.numPhases();
+        const int nc = numCells(grid_);
+        const int nw = wellsActive() ? wells().number_of_wells : 0;
+        const Opm::PhaseUsage& pu = fluid_.phaseUsage();
+
+        // updateState() subtracts the increment.
+        const int size = nc*(1 + int(active(Water)) + int(active(Gas))) + nw*(np + 1);
+        V dx = V::Zero(size);
+        for (int c = 0; c < nc; ++c) {
+            dx[c] = state.pressure()[c] - guess.pressure()[c];
+        }
+        int varstart = nc;
+        if (active(Water)) {
+            const int pos = pu.phase_pos[ Water ];
+            for (int c = 0; c < nc; ++c) {
+                dx[varstart + c] = state.saturation()[c*np + pos] - guess.saturation()[c*np + pos];
+            }
+            varstart += nc;
+        }
+        if (active(Gas)) {
+            const int pos = pu.phase_pos[ Gas ];
+            for (int c = 0; c < nc; ++c) {
+                switch (primalVariable_[c]) {
+                case PrimalVariables::Sg:
+                    dx[varstart + c] = state.saturation()[c*np + pos] - guess.saturation()[c*np + pos];
+                    break;
+                case PrimalVariables::RS:
+                    dx[varstart + c] = state.gasoilratio()[c] - guess.gasoilratio()[c];
+                    break;
+                case PrimalVariables::RV:
+                    dx[varstart + c] = state.rv()[c] - guess.rv()[c];
+                    break;
+                }
+            }
+        }
+        return dx;
+    }
+
+
+
+
+
+    template<class T, class PhaseConfig>
+    void FullyImplicitBlackoilSolver<T, PhaseConfig>::updateState(const V& dx,
                                                      BlackoilState& state,
                                                      WellStateFullyImplicitBlackoil& well_state)
     {
@@ -1363,31 +2016,17 @@ namespace detail {
         V isRs = V::Zero(nc,1);
         V isRv = V::Zero(nc,1);
         V isSg = V::Zero(nc,1);
-        if (active_[Gas]) {
-            for (int c = 0; c < nc; ++c) {
-                switch (primalVariable_[c]) {
-                case PrimalVariables::RS:
-                    isRs[c] = 1;
-                    break;
-
-                case PrimalVariables::RV:
-                    isRv[c] = 1;
-                    break;
-
-                default:
-                    isSg[c] = 1;
-                    break;
-                }
-            }
+        if (active(Gas)) {
+            primalVariableIndicators(isRs, isRv, isSg);
         }
 
         // Extract parts of dx corresponding to each part.
         const V dp = subset(dx, Span(nc));
         int varstart = nc;
-        const V dsw = active_[Water] ? subset(dx, Span(nc, 1, varstart)) : null;
+        const V dsw = active(Water) ? subset(dx, Span(nc, 1, varstart)) : null;
         varstart += dsw.size();
 
-        const V dxvar = active_[Gas] ? subset(dx, Span(nc, 1, varstart)): null;
+        const V dxvar = active(Gas) ? subset(dx, Span(nc, 1, varstart)): null;
         varstart += dxvar.size();
 
         const V dqs = subset(dx, Span(np*nw, 1, varstart));
@@ -1417,13 +2056,13 @@ namespace detail {
         {
             V maxVal = zero;
             V dso = zero;
-            if (active_[Water]){
+            if (active(Water)){
                 maxVal = dsw.abs().max(maxVal);
                 dso = dso - dsw;
             }
 
             V dsg;
-            if (active_[Gas]){
+            if (active(Gas)){
                 dsg = isSg * dxvar - isRv * dsw;
                 maxVal = dsg.abs().max(maxVal);
                 dso = dso - dsg;
@@ -1434,13 +2073,13 @@ namespace detail {
             V step = dsmax/maxVal;
             step = step.min(1.);
 
-            if (active_[Water]) {
+            if (active(Water)) {
                 const int pos = pu.phase_pos[ Water ];
                 const V sw_old = s_old.col(pos);
                 sw = sw_old - step * dsw;
             }
 
-            if (active_[Gas]) {
+            if (active(Gas)) {
                 const int pos = pu.phase_pos[ Gas ];
                 const V sg_old = s_old.col(pos);
                 sg = sg_old - step * dsg;
@@ -1494,7 +2133,7 @@ namespace detail {
             state.saturation()[c*np + pu.phase_pos[ Gas ]] = sg[c];
         }
 
-        if (active_[ Oil ]) {
+        if (active(Oil)) {
             const int pos = pu.phase_pos[ Oil ];
             for (int c = 0; c < nc; ++c) {
                 state.saturation()[c*np + pos] = so[c];
@@ -1504,14 +2143,14 @@ namespace detail {
         // Update rs and rv
         const double drmaxrel = drMaxRel();
         V rs;
-        if (has_disgas_) {
+        if (hasDisgas()) {
             const V rs_old = Eigen::Map<const V>(&state.gasoilratio()[0], nc);
             const V drs = isRs * dxvar;
             const V drs_limited = sign(drs) * drs.abs().min(rs_old.abs()*drmaxrel);
             rs = rs_old - drs_limited;
         }
         V rv;
-        if (has_vapoil_) {
+        if (hasVapoil()) {
             const V rv_old = Eigen::Map<const V>(&state.rv()[0], nc);
             const V drv = isRv * dxvar;
             const V drv_limited = sign(drv) * drv.abs().min(rv_old.abs()*drmaxrel);
@@ -1526,8 +2165,9 @@ namespace detail {
         // phase translation sg <-> rs
         std::fill(primalVariable_.begin(), primalVariable_.end(), PrimalVariables::Sg);
 
-        if (has_disgas_) {
-            const V rsSat0 = fluidRsSat(p_old, s_old.col(pu.phase_pos[Oil]), cells_);
+        if (hasDisgas()) {
+            // The old iterate is the state of the latest assemble().
+            const V& rsSat0 = rsSat_;
             const V rsSat = fluidRsSat(p, so, cells_);
             // The obvious case
             auto hasGas = (sg > 0 && isRs == 0);
@@ -1547,12 +2187,12 @@ namespace detail {
         }
 
         // phase transitions so <-> rv
-        if (has_vapoil_) {
+        if (hasVapoil()) {
 
-            // The gas pressure is needed for the rvSat calculations
-            const V gaspress_old = computeGasPressure(p_old, s_old.col(Water), s_old.col(Oil), s_old.col(Gas));
+            // The gas pressure is needed for the rvSat calculations.
+            // The old iterate is the state of the latest assemble().
             const V gaspress = computeGasPressure(p, sw, so, sg);
-            const V rvSat0 = fluidRvSat(gaspress_old, s_old.col(pu.phase_pos[Oil]), cells_);
+            const V& rvSat0 = rvSat_;
             const V rvSat = fluidRvSat(gaspress, so, cells_);
 
             // The obvious case
@@ -1573,11 +2213,11 @@ namespace detail {
         }
 
         // Update the state
-        if (has_disgas_) {
+        if (hasDisgas()) {
             std::copy(&rs[0], &rs[0] + nc, state.gasoilratio().begin());
         }
 
-        if (has_vapoil_) {
+        if (hasVapoil()) {
             std::copy(&rv[0], &rv[0] + nc, state.rv().begin());
         }
 
@@ -1608,9 +2248,9 @@ namespace detail {
 
 
 
-    template<class T>
+    template<class T, class PhaseConfig>
     std::vector<ADB>
-    FullyImplicitBlackoilSolver<T>::computeRelPerm(const SolutionState& state) const
+    FullyImplicitBlackoilSolver<T, PhaseConfig>::computeRelPerm(const SolutionState& state) const
     {
         using namespace Opm::AutoDiffGrid;
         const int               nc   = numCells(grid_);
@@ -1618,15 +2258,15 @@ namespace detail {
         const ADB zero = ADB::constant(V::Zero(nc));
 
         const Opm::PhaseUsage& pu = fluid_.phaseUsage();
-        const ADB& sw = (active_[ Water ]
+        const ADB& sw = (active(Water)
                          ? state.saturation[ pu.phase_pos[ Water ] ]
                          : zero);
 
-        const ADB& so = (active_[ Oil ]
+        const ADB& so = (active(Oil)
                          ? state.saturation[ pu.phase_pos[ Oil ] ]
                          : zero);
 
-        const ADB& sg = (active_[ Gas ]
+        const ADB& sg = (active(Gas)
                          ? state.saturation[ pu.phase_pos[ Gas ] ]
                          : zero);
 
@@ -1637,9 +2277,9 @@ namespace detail {
 
 
 
-    template<class T>
+    template<class T, class PhaseConfig>
     std::vector<ADB>
-    FullyImplicitBlackoilSolver<T>::computePressures(const SolutionState& state) const
+    FullyImplicitBlackoilSolver<T, PhaseConfig>::computePressures(const SolutionState& state) const
     {
         using namespace Opm::AutoDiffGrid;
         const int               nc   = numCells(grid_);
@@ -1647,15 +2287,15 @@ namespace detail {
         const ADB null = ADB::constant(V::Zero(nc));
 
         const Opm::PhaseUsage& pu = fluid_.phaseUsage();
-        const ADB& sw = (active_[ Water ]
+        const ADB& sw = (active(Water)
                         ? state.saturation[ pu.phase_pos[ Water ] ]
                         : null);
 
-        const ADB& so = (active_[ Oil ]
+        const ADB& so = (active(Oil)
                         ? state.saturation[ pu.phase_pos[ Oil ] ]
                         : null);
 
-        const ADB& sg = (active_[ Gas ]
+        const ADB& sg = (active(Gas)
                         ? state.saturation[ pu.phase_pos[ Gas ] ]
                         : null);
         return computePressures(state.pressure, sw, so, sg);
@@ -1667,9 +2307,9 @@ namespace detail {
 
 
 
-    template <class T>
+    template<class T, class PhaseConfig>
     std::vector<ADB>
-    FullyImplicitBlackoilSolver<T>::
+    FullyImplicitBlackoilSolver<T, PhaseConfig>::
     computePressures(const ADB& po,
                      const ADB& sw,
                      const ADB& so,
@@ -1704,14 +2344,14 @@ namespace detail {
 
 
 
-    template<class T>
+    template<class T, class PhaseConfig>
     V
-    FullyImplicitBlackoilSolver<T>::computeGasPressure(const V& po,
+    FullyImplicitBlackoilSolver<T, PhaseConfig>::computeGasPressure(const V& po,
                                                        const V& sw,
                                                        const V& so,
                                                        const V& sg) const
     {
-        assert (active_[Gas]);
+        assert (active(Gas));
         std::vector<ADB> cp = fluid_.capPress(ADB::constant(sw),
                                               ADB::constant(so),
                                               ADB::constant(sg),
@@ -1723,31 +2363,29 @@ namespace detail {
 
 
 
-    template<class T>
+    template<class T, class PhaseConfig>
     void
-    FullyImplicitBlackoilSolver<T>::computeMassFlux(const int               actph ,
+    FullyImplicitBlackoilSolver<T, PhaseConfig>::computeMassFlux(const int               actph ,
                                                  const V&                transi,
                                                  const ADB&              kr    ,
                                                  const ADB&              phasePressure,
                                                  const SolutionState&    state)
     {
-        const int canonicalPhaseIdx = canph_[ actph ];
-
-        const std::vector<PhasePresence> cond = phaseCondition();
-
         const ADB tr_mult = transMult(state.pressure);
-        const ADB mu    = fluidViscosity(canonicalPhaseIdx, phasePressure, state.temperature, state.rs, state.rv,cond, cells_);
+        // The viscosity and density for these inputs were computed
+        // together with the reciprocal FVF in computeAccum().
+        const ADB& mu = rq_[ actph ].mu;
 
         rq_[ actph ].mob = tr_mult * kr / mu;
 
-        const ADB rho   = fluidDensity(canonicalPhaseIdx, phasePressure, state.temperature, state.rs, state.rv,cond, cells_);
+        const ADB& rho = rq_[ actph ].rho;
 
         ADB& head = rq_[ actph ].head;
 
         // compute gravity potensial using the face average as in eclipse and MRST
-        const ADB rhoavg = ops_.caver * rho;
+        const ADB rhoavg = applyCAver(ops_, rho);
 
-        ADB dp = ops_.ngrad * phasePressure - geo_.gravity()[2] * (rhoavg * (ops_.ngrad * geo_.z().matrix()));
+        ADB dp = applyNGrad(ops_, phasePressure) - geo_.gravity()[2] * (rhoavg * applyNGrad(ops_, geo_.z()));
 
         if (use_threshold_pressure_) {
             applyThresholdPressures(dp);
@@ -1756,7 +2394,10 @@ namespace detail {
         head = transi*dp;
         //head      = transi*(ops_.ngrad * phasePressure) + gflux;
 
-        UpwindSelector<double> upwind(grid_, ops_, head.value());
+        // The selector is kept between iterations, and only rebuilds
+        // its gather map when some face changed upwind direction.
+        UpwindSelector<double>& upwind = rq_[ actph ].upwind;
+        upwind.update(ops_, head.value());
 
         const ADB& b       = rq_[ actph ].b;
         const ADB& mob     = rq_[ actph ].mob;
@@ -1769,9 +2410,57 @@ namespace detail {
 
 
 
-    template<class T>
+    template<class T, class PhaseConfig>
+    V
+    FullyImplicitBlackoilSolver<T, PhaseConfig>::totalFlux() const
+    {
+        V vt = V::Zero(ops_.internal_faces.size());
+        for (int phase = 0; phase < fluid_.numPhases(); ++phase) {
+            vt += rq_[phase].upwind.select(rq_[phase].mob.value()) * rq_[phase].head.value();
+        }
+        return vt;
+    }
+
+
+
+
+
+    template<class T, class PhaseConfig>
+    void
+    FullyImplicitBlackoilSolver<T, PhaseConfig>::computeFractionalFlowFluxes()
+    {
+        // The phase flux mob_a*head_a written as
+        //   mob_a/mob_t * (v_t + sum_{b != a} mob_b*(head_a - head_b)),
+        // with the total flux v_t fixed and the upwind directions of
+        // the phase heads of computeMassFlux().
+        const int np = fluid_.numPhases();
+        std::vector<ADB> mob_face;
+        mob_face.reserve(np);
+        for (int phase = 0; phase < np; ++phase) {
+            mob_face.push_back(rq_[phase].upwind.select(rq_[phase].mob));
+        }
+        ADB mob_total = mob_face[0];
+        for (int phase = 1; phase < np; ++phase) {
+            mob_total += mob_face[phase];
+        }
+        for (int phase = 0; phase < np; ++phase) {
+            ADB flux = ADB::constant(total_flux_);
+            for (int other = 0; other < np; ++other) {
+                if (other != phase) {
+                    flux += mob_face[other] * (rq_[phase].head - rq_[other].head);
+                }
+            }
+            rq_[phase].mflux = rq_[phase].upwind.select(rq_[phase].b) * (mob_face[phase] / mob_total) * flux;
+        }
+    }
+
+
+
+
+
+    template<class T, class PhaseConfig>
     void
-    FullyImplicitBlackoilSolver<T>::applyThresholdPressures(ADB& dp)
+    FullyImplicitBlackoilSolver<T, PhaseConfig>::applyThresholdPressures(ADB& dp)
     {
         // We support reversible threshold pressures only.
         // Method: if the potential difference is lower (in absolute
@@ -1801,9 +2490,9 @@ namespace detail {
 
 
 
-    template<class T>
+    template<class T, class PhaseConfig>
     double
-    FullyImplicitBlackoilSolver<T>::residualNorm() const
+    FullyImplicitBlackoilSolver<T, PhaseConfig>::residualNorm() const
     {
         double globalNorm = 0;
         std::vector<ADB>::const_iterator quantityIt = residual_.material_balance_eq.begin();
@@ -1825,9 +2514,9 @@ namespace detail {
     }
 
 
-    template<class T>
+    template<class T, class PhaseConfig>
     std::vector<double>
-    FullyImplicitBlackoilSolver<T>::computeResidualNorms() const
+    FullyImplicitBlackoilSolver<T, PhaseConfig>::computeResidualNorms() const
     {
         std::vector<double> residualNorms;
 
@@ -1861,9 +2550,9 @@ namespace detail {
         return residualNorms;
     }
 
-    template<class T>
+    template<class T, class PhaseConfig>
     void
-    FullyImplicitBlackoilSolver<T>::detectNewtonOscillations(const std::vector<std::vector<double>>& residual_history,
+    FullyImplicitBlackoilSolver<T, PhaseConfig>::detectNewtonOscillations(const std::vector<std::vector<double>>& residual_history,
                                                              const int it, const double relaxRelTol,
                                                              bool& oscillate, bool& stagnate) const
     {
@@ -1898,9 +2587,9 @@ namespace detail {
     }
 
 
-    template<class T>
+    template<class T, class PhaseConfig>
     void
-    FullyImplicitBlackoilSolver<T>::stablizeNewton(V& dx, V& dxOld, const double omega,
+    FullyImplicitBlackoilSolver<T, PhaseConfig>::stablizeNewton(V& dx, V& dxOld, const double omega,
                                                     const RelaxType relax_type) const
     {
         // The dxOld is updated with dx.
@@ -1922,16 +2611,119 @@ namespace detail {
                 }
                 dx = dx*omega + (1.-omega)*tempDxOld;
                 return;
+            case LINESEARCH:
+                // The step length is chosen by lineSearch().
+                return;
             default:
-                OPM_THROW(std::runtime_error, "Can only handle DAMPEN and SOR relaxation type.");
+                OPM_THROW(std::runtime_error, "Can only handle DAMPEN, SOR and LINESEARCH relaxation type.");
         }
 
         return;
     }
 
-    template<class T>
+    template<class T, class PhaseConfig>
+    void
+    FullyImplicitBlackoilSolver<T, PhaseConfig>::lineSearch(const V& dx,
+                                                            const V& pvdt,
+                                                            const std::vector<double>& residual_norms,
+                                                            BlackoilState& x,
+                                                            WellStateFullyImplicitBlackoil& xw)
+    {
+        // updateState() also changes the primary variable choice and
+        // the phase conditions, and assemble() the saturated Rs and Rv
+        // used by the next updateState(), which are restored with the state.
+        const BlackoilState x0 = x;
+        const WellStateFullyImplicitBlackoil xw0 = xw;
+        const std::vector<int> primalVariable0 = primalVariable_;
+        const std::vector<PhasePresence> phaseCondition0 = phaseCondition_;
+        const V rsSat0 = rsSat_;
+        const V rvSat0 = rvSat_;
+
+        const int np = fluid_.numPhases();
+        const double tiny = std::numeric_limits<double>::min();
+        double alpha = 1.0;
+        for (int cut = 0; ; ++cut) {
+            const V step = alpha * dx;
+            updateState(step, x, xw);
+            assemble(pvdt, x, false, xw, false);
+
+            // Mean relative change of the mass balance residuals, which
+            // have different scales for the different phases.
+            double ratio = std::numeric_limits<double>::infinity();
+            try {
+                const std::vector<double> norms = computeResidualNorms();
+                ratio = 0.0;
+                for (int p = 0; p < np; ++p) {
+                    ratio += norms[p] / std::max(residual_norms[p], tiny);
+                }
+                ratio /= np;
+            }
+            catch (const Opm::NumericalProblem&) {
+                if (cut == lineSearchMaxCuts()) {
+                    throw;
+                }
+            }
+
+            // Accept on sufficient decrease, or with the shortest step.
+            if (ratio <= 1.0 - 1.0e-4 * alpha || cut == lineSearchMaxCuts()) {
+                if (cut > 0 && terminal_output_) {
+                    std::cout << " Line search: step length " << alpha << std::endl;
+                }
+                return;
+            }
+
+            alpha *= 0.5;
+            x = x0;
+            xw = xw0;
+            primalVariable_ = primalVariable0;
+            phaseCondition_ = phaseCondition0;
+            rsSat_ = rsSat0;
+            rvSat_ = rvSat0;
+        }
+    }
+
+    template<class T, class PhaseConfig>
     double
-    FullyImplicitBlackoilSolver<T>::convergenceReduction(const Eigen::Array<double, Eigen::Dynamic, MaxNumPhases>& B,
+    FullyImplicitBlackoilSolver<T, PhaseConfig>::residualReductionRatio(const std::vector<std::vector<double>>& residual_norms_history) const
+    {
+        assert(residual_norms_history.size() >= 2);
+        const std::vector<double>& norms = residual_norms_history.back();
+        const std::vector<double>& norms_old = residual_norms_history[residual_norms_history.size() - 2];
+
+        // The slowest converging phase determines the rate, as in
+        // the convergence check all phases must be below tolerance.
+        const int np = fluid_.numPhases();
+        const double tiny = std::numeric_limits<double>::min();
+        double ratio = 0.0;
+        for (int p = 0; p < np; ++p) {
+            ratio = std::max(ratio, norms[p] / std::max(norms_old[p], tiny));
+        }
+        return ratio;
+    }
+
+    template<class T, class PhaseConfig>
+    double
+    FullyImplicitBlackoilSolver<T, PhaseConfig>::forcingTerm(const std::vector<std::vector<double>>& residual_norms_history,
+                                                             const double eta_old) const
+    {
+        const double ratio = residualReductionRatio(residual_norms_history);
+
+        // eta = gamma * (|F_k| / |F_k-1|)^alpha, but do not let eta
+        // drop much faster than the previous forcing term unless
+        // that is already small (Eisenstat and Walker, 1996).
+        const double gamma = param_.ew_gamma_;
+        const double alpha = param_.ew_alpha_;
+        double eta = gamma * std::pow(ratio, alpha);
+        const double safeguard = gamma * std::pow(eta_old, alpha);
+        if (safeguard > 0.1) {
+            eta = std::max(eta, safeguard);
+        }
+        return std::min(std::max(eta, param_.ew_eta_min_), param_.ew_eta_max_);
+    }
+
+    template<class T, class PhaseConfig>
+    double
+    FullyImplicitBlackoilSolver<T, PhaseConfig>::convergenceReduction(const Eigen::Array<double, Eigen::Dynamic, MaxNumPhases>& B,
                                                          const Eigen::Array<double, Eigen::Dynamic, MaxNumPhases>& tempV,
                                                          const Eigen::Array<double, Eigen::Dynamic, MaxNumPhases>& R,
                                                          std::array<double,MaxNumPhases>& R_sum,
@@ -1956,7 +2748,7 @@ namespace detail {
 
             for ( int idx=0; idx<MaxNumPhases; ++idx )
             {
-                if (active_[idx]) {
+                if (active(idx)) {
                     auto values     = std::tuple<double,double,double>(0.0 ,0.0 ,0.0);
                     auto containers = std::make_tuple(B.col(idx),
                                                       tempV.col(idx),
@@ -1982,7 +2774,7 @@ namespace detail {
         {
             for ( int idx=0; idx<MaxNumPhases; ++idx )
             {
-                if (active_[idx]) {
+                if (active(idx)) {
                     B_avg[idx] = B.col(idx).sum()/nc;
                     maxCoeff[idx]=tempV.col(idx).maxCoeff();
                     R_sum[idx] = R.col(idx).sum();
@@ -1997,9 +2789,9 @@ namespace detail {
         }
     }
 
-    template<class T>
+    template<class T, class PhaseConfig>
     bool
-    FullyImplicitBlackoilSolver<T>::getConvergence(const double dt, const int iteration)
+    FullyImplicitBlackoilSolver<T, PhaseConfig>::getConvergence(const double dt, const int iteration)
     {
         const double tol_mb    = param_.tolerance_mb_;
         const double tol_cnv   = param_.tolerance_cnv_;
@@ -2024,7 +2816,7 @@ namespace detail {
 
         for ( int idx=0; idx<MaxNumPhases; ++idx )
         {
-            if (active_[idx]) {
+            if (active(idx)) {
                 const int pos    = pu.phase_pos[idx];
                 const ADB& tempB = rq_[pos].b;
                 B.col(idx)       = 1./tempB.value();
@@ -2045,6 +2837,7 @@ namespace detail {
             converged_MB               = converged_MB && (mass_balance_residual[idx] < tol_mb);
             converged_CNV              = converged_CNV && (CNV[idx] < tol_cnv);
         }
+        step_report_.cnv.push_back(CNV);
 
         const double residualWellFlux = detail::infinityNorm(residual_.well_flux_eq);
         const double residualWell     = detail::infinityNorm(residual_.well_eq);
@@ -2089,53 +2882,36 @@ namespace detail {
     }
 
 
-    template<class T>
-    ADB
-    FullyImplicitBlackoilSolver<T>::fluidViscosity(const int               phase,
-                                                   const ADB&              p    ,
-                                                   const ADB&              temp ,
-                                                const ADB&              rs   ,
-                                                const ADB&              rv   ,
-                                                const std::vector<PhasePresence>& cond,
-                                                const std::vector<int>& cells) const
-    {
-        switch (phase) {
-        case Water:
-            return fluid_.muWat(p, temp, cells);
-        case Oil: {
-            return fluid_.muOil(p, temp, rs, cond, cells);
-        }
-        case Gas:
-            return fluid_.muGas(p, temp, rv, cond, cells);
-        default:
-            OPM_THROW(std::runtime_error, "Unknown phase index " << phase);
-        }
+    template<class T, class PhaseConfig>
+    void
+    FullyImplicitBlackoilSolver<T, PhaseConfig>::startStepReport(const BlackoilState& x)
+    {
+        step_report_ = StepReport();
+        step_start_pressure_ = x.pressure();
+        step_start_saturation_ = x.saturation();
     }
 
 
 
 
 
-    template<class T>
-    ADB
-    FullyImplicitBlackoilSolver<T>::fluidReciprocFVF(const int               phase,
-                                                  const ADB&              p    ,
-                                                  const ADB&              temp ,
-                                                  const ADB&              rs   ,
-                                                  const ADB&              rv   ,
-                                                  const std::vector<PhasePresence>& cond,
-                                                  const std::vector<int>& cells) const
-    {
-        switch (phase) {
-        case Water:
-            return fluid_.bWat(p, temp, cells);
-        case Oil: {
-            return fluid_.bOil(p, temp, rs, cond, cells);
-        }
-        case Gas:
-            return fluid_.bGas(p, temp, rv, cond, cells);
-        default:
-            OPM_THROW(std::runtime_error, "Unknown phase index " << phase);
+    template<class T, class PhaseConfig>
+    void
+    FullyImplicitBlackoilSolver<T, PhaseConfig>::finishStepReport(const BlackoilState& x,
+                                                                  const bool converged,
+                                                                  const int newton_iterations,
+                                                                  const int linear_iterations)
+    {
+        step_report_.converged = converged;
+        step_report_.newton_iterations = newton_iterations;
+        step_report_.linear_iterations = linear_iterations;
+        const std::vector<double>& p = x.pressure();
+        for (std::size_t c = 0; c < p.size(); ++c) {
+            step_report_.max_dp = std::max(step_report_.max_dp, std::abs(p[c] - step_start_pressure_[c]));
+        }
+        const std::vector<double>& s = x.saturation();
+        for (std::size_t i = 0; i < s.size(); ++i) {
+            step_report_.max_ds = std::max(step_report_.max_ds, std::abs(s[i] - step_start_saturation_[i]));
         }
     }
 
@@ -2143,37 +2919,9 @@ namespace detail {
 
 
 
-    template<class T>
-    ADB
-    FullyImplicitBlackoilSolver<T>::fluidDensity(const int               phase,
-                                                 const ADB&              p    ,
-                                                 const ADB&              temp ,
-                                              const ADB&              rs   ,
-                                              const ADB&              rv   ,
-                                              const std::vector<PhasePresence>& cond,
-                                              const std::vector<int>& cells) const
-    {
-        const double* rhos = fluid_.surfaceDensity();
-        ADB b = fluidReciprocFVF(phase, p, temp, rs, rv, cond, cells);
-        ADB rho = V::Constant(p.size(), 1, rhos[phase]) * b;
-        if (phase == Oil && active_[Gas]) {
-            // It is correct to index into rhos with canonical phase indices.
-            rho += V::Constant(p.size(), 1, rhos[Gas]) * rs * b;
-        }
-        if (phase == Gas && active_[Oil]) {
-            // It is correct to index into rhos with canonical phase indices.
-            rho += V::Constant(p.size(), 1, rhos[Oil]) * rv * b;
-        }
-        return rho;
-    }
-
-
-
-
-
-    template<class T>
+    template<class T, class PhaseConfig>
     V
-    FullyImplicitBlackoilSolver<T>::fluidRsSat(const V&                p,
+    FullyImplicitBlackoilSolver<T, PhaseConfig>::fluidRsSat(const V&                p,
                                                const V&                satOil,
                                                const std::vector<int>& cells) const
     {
@@ -2184,9 +2932,9 @@ namespace detail {
 
 
 
-    template<class T>
+    template<class T, class PhaseConfig>
     ADB
-    FullyImplicitBlackoilSolver<T>::fluidRsSat(const ADB&              p,
+    FullyImplicitBlackoilSolver<T, PhaseConfig>::fluidRsSat(const ADB&              p,
                                                const ADB&              satOil,
                                                const std::vector<int>& cells) const
     {
@@ -2194,9 +2942,9 @@ namespace detail {
     }
 
 
-    template<class T>
+    template<class T, class PhaseConfig>
     V
-    FullyImplicitBlackoilSolver<T>::fluidRvSat(const V&                p,
+    FullyImplicitBlackoilSolver<T, PhaseConfig>::fluidRvSat(const V&                p,
                                                const V&              satOil,
                                                const std::vector<int>& cells) const
     {
@@ -2207,9 +2955,9 @@ namespace detail {
 
 
 
-    template<class T>
+    template<class T, class PhaseConfig>
     ADB
-    FullyImplicitBlackoilSolver<T>::fluidRvSat(const ADB&              p,
+    FullyImplicitBlackoilSolver<T, PhaseConfig>::fluidRvSat(const ADB&              p,
                                                const ADB&              satOil,
                                                const std::vector<int>& cells) const
     {
@@ -2218,9 +2966,9 @@ namespace detail {
 
 
 
-    template<class T>
+    template<class T, class PhaseConfig>
     ADB
-    FullyImplicitBlackoilSolver<T>::poroMult(const ADB& p) const
+    FullyImplicitBlackoilSolver<T, PhaseConfig>::poroMult(const ADB& p) const
     {
         const int n = p.size();
         if (rock_comp_props_ && rock_comp_props_->isActive()) {
@@ -2246,9 +2994,9 @@ namespace detail {
 
 
 
-    template<class T>
+    template<class T, class PhaseConfig>
     ADB
-    FullyImplicitBlackoilSolver<T>::transMult(const ADB& p) const
+    FullyImplicitBlackoilSolver<T, PhaseConfig>::transMult(const ADB& p) const
     {
         const int n = p.size();
         if (rock_comp_props_ && rock_comp_props_->isActive()) {
@@ -2272,15 +3020,15 @@ namespace detail {
 
 
     /*
-    template<class T>
+    template<class T, class PhaseConfig>
     void
-    FullyImplicitBlackoilSolver<T>::
+    FullyImplicitBlackoilSolver<T, PhaseConfig>::
     classifyCondition(const SolutionState&        state,
                       std::vector<PhasePresence>& cond ) const
     {
         const PhaseUsage& pu = fluid_.phaseUsage();
 
-        if (active_[ Gas ]) {
+        if (active(Gas)) {
             // Oil/Gas or Water/Oil/Gas system
             const int po = pu.phase_pos[ Oil ];
             const int pg = pu.phase_pos[ Gas ];
@@ -2293,12 +3041,12 @@ namespace detail {
             for (V::Index c = 0, e = sg.size(); c != e; ++c) {
                 if (so[c] > 0)        { cond[c].setFreeOil  (); }
                 if (sg[c] > 0)        { cond[c].setFreeGas  (); }
-                if (active_[ Water ]) { cond[c].setFreeWater(); }
+                if (active(Water)) { cond[c].setFreeWater(); }
             }
         }
         else {
             // Water/Oil system
-            assert (active_[ Water ]);
+            assert (active(Water));
 
             const int po = pu.phase_pos[ Oil ];
             const V&  so = state.saturation[ po ].value();
@@ -2314,9 +3062,9 @@ namespace detail {
     } */
 
 
-    template<class T>
+    template<class T, class PhaseConfig>
     void
-    FullyImplicitBlackoilSolver<T>::classifyCondition(const BlackoilState& state)
+    FullyImplicitBlackoilSolver<T, PhaseConfig>::classifyCondition(const BlackoilState& state)
     {
         using namespace Opm::AutoDiffGrid;
         const int nc = numCells(grid_);
@@ -2324,7 +3072,7 @@ namespace detail {
 
         const PhaseUsage& pu = fluid_.phaseUsage();
         const DataBlock s = Eigen::Map<const DataBlock>(& state.saturation()[0], nc, np);
-        if (active_[ Gas ]) {
+        if (active(Gas)) {
             // Oil/Gas or Water/Oil/Gas system
             const V so = s.col(pu.phase_pos[ Oil ]);
             const V sg = s.col(pu.phase_pos[ Gas ]);
@@ -2332,12 +3080,12 @@ namespace detail {
             for (V::Index c = 0, e = sg.size(); c != e; ++c) {
                 if (so[c] > 0)        { phaseCondition_[c].setFreeOil  (); }
                 if (sg[c] > 0)        { phaseCondition_[c].setFreeGas  (); }
-                if (active_[ Water ]) { phaseCondition_[c].setFreeWater(); }
+                if (active(Water)) { phaseCondition_[c].setFreeWater(); }
             }
         }
         else {
             // Water/Oil system
-            assert (active_[ Water ]);
+            assert (active(Water));
 
             const V so = s.col(pu.phase_pos[ Oil ]);
 
@@ -2352,9 +3100,9 @@ namespace detail {
 
     }
 
-    template<class T>
+    template<class T, class PhaseConfig>
     void
-    FullyImplicitBlackoilSolver<T>::updatePrimalVariableFromState(const BlackoilState& state)
+    FullyImplicitBlackoilSolver<T, PhaseConfig>::updatePrimalVariableFromState(const BlackoilState& state)
     {
         using namespace Opm::AutoDiffGrid;
         const int nc = numCells(grid_);
@@ -2364,7 +3112,7 @@ namespace detail {
         const DataBlock s = Eigen::Map<const DataBlock>(& state.saturation()[0], nc, np);
 
         // Water/Oil/Gas system
-        assert (active_[ Gas ]);
+        assert (active(Gas));
 
         // reset the primary variables if RV and RS is not set Sg is used as primary variable.
         primalVariable_.resize(nc);
@@ -2381,7 +3129,7 @@ namespace detail {
 
         // For oil only cells Rs is used as primal variable. For cells almost full of water
         // the default primal variable (Sg) is used.
-        if (has_disgas_) {
+        if (hasDisgas()) {
             for (V::Index c = 0, e = sg.size(); c != e; ++c) {
                 if ( !watOnly[c] && hasOil[c] && !hasGas[c] ) {primalVariable_[c] = PrimalVariables::RS; }
             }
@@ -2389,7 +3137,7 @@ namespace detail {
 
         // For gas only cells Rv is used as primal variable. For cells almost full of water
         // the default primal variable (Sg) is used.
-        if (has_vapoil_) {
+        if (hasVapoil()) {
             for (V::Index c = 0, e = so.size(); c != e; ++c) {
                 if ( !watOnly[c] && hasGas[c] && !hasOil[c] ) {primalVariable_[c] = PrimalVariables::RV; }
             }
@@ -2401,12 +3149,43 @@ namespace detail {
 
 
 
+    template<class T, class PhaseConfig>
+    void
+    FullyImplicitBlackoilSolver<T, PhaseConfig>::primalVariableIndicators(V& isRs, V& isRv, V& isSg) const
+    {
+        if (!hasDisgas() && !hasVapoil()) {
+            // Sg is the only possible choice.
+            isSg.setOnes();
+            return;
+        }
+        const int nc = primalVariable_.size();
+        for (int c = 0; c < nc; ++c) {
+            switch (primalVariable_[c]) {
+            case PrimalVariables::RS:
+                isRs[c] = 1;
+                break;
+
+            case PrimalVariables::RV:
+                isRv[c] = 1;
+                break;
+
+            default:
+                isSg[c] = 1;
+                break;
+            }
+        }
+    }
+
+
+
+
+
     /// Update the phaseCondition_ member based on the primalVariable_ member.
-    template<class T>
+    template<class T, class PhaseConfig>
     void
-    FullyImplicitBlackoilSolver<T>::updatePhaseCondFromPrimalVariable()
+    FullyImplicitBlackoilSolver<T, PhaseConfig>::updatePhaseCondFromPrimalVariable()
     {
-        if (! active_[Gas]) {
+        if (! active(Gas)) {
             OPM_THROW(std::logic_error, "updatePhaseCondFromPrimarVariable() logic requires active gas phase.");
         }
         const int nc = primalVariable_.size();
@@ -41,6 +41,9 @@
 #include <opm/core/utility/platform_dependent/reenable_warnings.h>
 
 #include <cstddef>
+#include <iterator>
+#include <string>
+#include <vector>
 
 namespace Opm
 {
@@ -72,23 +75,11 @@ namespace Opm
         {
             int numCells = AutoDiffGrid::numCells(grid);
             int numFaces = AutoDiffGrid::numFaces(grid);
-            const int *cartDims = AutoDiffGrid::cartDims(grid);
-            int numCartesianCells =
-                cartDims[0]
-                * cartDims[1]
-                * cartDims[2];
-
-            // get the pore volume multipliers from the EclipseState
-            std::vector<double> multpv(numCartesianCells, 1.0);
-            if (eclState->hasDoubleGridProperty("MULTPV")) {
-                multpv = eclState->getDoubleGridProperty("MULTPV")->getData();
-            }
 
-            // get the net-to-gross cell thickness from the EclipseState
-            std::vector<double> ntg(numCartesianCells, 1.0);
-            if (eclState->hasDoubleGridProperty("NTG")) {
-                ntg = eclState->getDoubleGridProperty("NTG")->getData();
-            }
+            // get the pore volume multipliers and the net-to-gross cell
+            // thickness of the active cells from the EclipseState
+            std::vector<double> multpv = activeCellProperty_(grid, eclState, "MULTPV", 1.0);
+            std::vector<double> ntg = activeCellProperty_(grid, eclState, "NTG", 1.0);
 
             // get grid from parser.
             
@@ -97,17 +88,21 @@ namespace Opm
             // Pore volume.
             // New keywords MINPVF will add some PV due to OPM cpgrid process algorithm.
             // But the default behavior is to get the comparable pore volume with ECLIPSE.
+            const int* global_cell = AutoDiffGrid::globalCell(grid);
+            const double* poro = props.porosity();
+            const bool use_grid_volume = eclgrid->getMinpvMode() == MinpvMode::ModeEnum::OpmFIL;
+#pragma omp parallel for schedule(static)
             for (int cellIdx = 0; cellIdx < numCells; ++cellIdx) {
-                int cartesianCellIdx = AutoDiffGrid::globalCell(grid)[cellIdx];
+                int cartesianCellIdx = global_cell[cellIdx];
                 pvol_[cellIdx] =
-                    props.porosity()[cellIdx]
-                    * multpv[cartesianCellIdx]
-                    * ntg[cartesianCellIdx];
-                if (eclgrid->getMinpvMode() == MinpvMode::ModeEnum::OpmFIL) {
+                    poro[cellIdx]
+                    * multpv[cellIdx]
+                    * ntg[cellIdx];
+                if (use_grid_volume) {
                     pvol_[cellIdx] *= AutoDiffGrid::cellVolume(grid, cellIdx);
                 } else {
                     pvol_[cellIdx] *= eclgrid->getCellVolume(cartesianCellIdx);
-                }                
+                }
             }
             // Use volume weighted arithmetic average of the NTG values for
             // the cells effected by the current OPM cpgrid process algorithm
@@ -137,11 +132,13 @@ namespace Opm
 
             // multiply the face transmissibilities with their appropriate
             // transmissibility multipliers
+#pragma omp parallel for schedule(static)
             for (int faceIdx = 0; faceIdx < numFaces; faceIdx++) {
                 trans_[faceIdx] *= mult[faceIdx];
             }
 
             // Compute z coordinates
+#pragma omp parallel for schedule(static)
             for (int c = 0; c<numCells; ++c){
                 z_[c] = Opm::UgGridHelpers::cellCentroidCoordinate(grid, c, 2);
             }
@@ -153,14 +150,16 @@ namespace Opm
                 const typename Vector::Index nd = AutoDiffGrid::dimensions(grid);
                 typedef typename AutoDiffGrid::ADCell2FacesTraits<Grid>::Type Cell2Faces;
                 Cell2Faces c2f=AutoDiffGrid::cell2Faces(grid);
+                const std::vector<int> cellFaceStart = cellFaceOffsets_(grid);
 
-                std::size_t i = 0;
-                for (typename Vector::Index c = 0; c < numCells; ++c) {
+#pragma omp parallel for schedule(static)
+                for (int c = 0; c < numCells; ++c) {
                     const double* const cc = AutoDiffGrid::cellCentroid(grid, c);
 
                     typename Cell2Faces::row_type faces=c2f[c];
                     typedef typename Cell2Faces::row_type::iterator Iter;
 
+                    std::size_t i = cellFaceStart[c];
                     for (Iter f=faces.begin(), end=faces.end(); f!=end; ++f, ++i) {
                         auto fc = AutoDiffGrid::faceCentroid(grid, *f);
 
@@ -192,11 +191,27 @@ namespace Opm
                                      const double* perm,
                                      Vector &hTrans);
 
+        /// Values of a grid property in the active cells, or the given
+        /// default if the property is not in the deck. The values are
+        /// read directly from the Cartesian array of the EclipseState.
+        template <class Grid>
+        static std::vector<double> activeCellProperty_(const Grid &grid,
+                                                       Opm::EclipseStateConstPtr eclState,
+                                                       const std::string &keyword,
+                                                       const double defaultValue);
+
+        /// Volume weighted average of the net-to-gross values of the
+        /// active cells (ntg) with the cells above them that are removed
+        /// by MINPV.
         template <class Grid>
         void minPvFillProps_(const Grid &grid,
                              Opm::EclipseStateConstPtr eclState,
                              std::vector<double> &ntg);
 
+        /// Start of each cell's entries in the half-face (cell-face) arrays.
+        template <class Grid>
+        static std::vector<int> cellFaceOffsets_(const Grid &grid);
+
         Vector pvol_ ;
         Vector trans_;
         Vector gpot_ ;
@@ -208,6 +223,40 @@ namespace Opm
 
     };
 
+    template <class GridType>
+    inline std::vector<int> DerivedGeology::cellFaceOffsets_(const GridType &grid)
+    {
+        const int numCells = Opm::AutoDiffGrid::numCells(grid);
+        auto cell2Faces = Opm::UgGridHelpers::cell2Faces(grid);
+        std::vector<int> start(numCells + 1, 0);
+        for (int cellIdx = 0; cellIdx < numCells; ++cellIdx) {
+            auto cellFacesRange = cell2Faces[cellIdx];
+            start[cellIdx + 1] = start[cellIdx]
+                + std::distance(cellFacesRange.begin(), cellFacesRange.end());
+        }
+        return start;
+    }
+
+    template <class GridType>
+    inline std::vector<double> DerivedGeology::activeCellProperty_(const GridType &grid,
+                                                                   Opm::EclipseStateConstPtr eclState,
+                                                                   const std::string &keyword,
+                                                                   const double defaultValue)
+    {
+        const int numCells = Opm::AutoDiffGrid::numCells(grid);
+        std::vector<double> values(numCells, defaultValue);
+        if (eclState->hasDoubleGridProperty(keyword)) {
+            const auto property = eclState->getDoubleGridProperty(keyword);
+            const std::vector<double>& data = property->getData();
+            const int* global_cell = Opm::UgGridHelpers::globalCell(grid);
+#pragma omp parallel for schedule(static)
+            for (int cellIdx = 0; cellIdx < numCells; ++cellIdx) {
+                values[cellIdx] = data[global_cell[cellIdx]];
+            }
+        }
+        return values;
+    }
+
     template <class GridType>
     inline void DerivedGeology::minPvFillProps_(const GridType &grid,
                                                 Opm::EclipseStateConstPtr eclState,
@@ -218,14 +267,24 @@ namespace Opm
         const int* global_cell = Opm::UgGridHelpers::globalCell(grid);
         const int* cartdims = Opm::UgGridHelpers::cartDims(grid);
         EclipseGridConstPtr eclgrid = eclState->getEclipseGrid();
-        std::vector<double> porv = eclState->getDoubleGridProperty("PORV")->getData();
+        const auto porvProperty = eclState->getDoubleGridProperty("PORV");
+        const std::vector<double>& porv = porvProperty->getData();
+        const int nx = cartdims[0];
+        const int ny = cartdims[1];
+        const double minpv = eclgrid->getMinpvValue();
+
+        // The cells above the MINPV threshold are inactive, so their
+        // net-to-gross values are taken from the deck.
+        const bool hasNtg = eclState->hasDoubleGridProperty("NTG");
+        const auto ntgProperty = hasNtg ? eclState->getDoubleGridProperty("NTG") : nullptr;
+        const double* deckNtg = hasNtg ? ntgProperty->getData().data() : nullptr;
+
+#pragma omp parallel for schedule(static)
         for (int cellIdx = 0; cellIdx < numCells; ++cellIdx) {
-            const int nx = cartdims[0];
-            const int ny = cartdims[1];
             const int cartesianCellIdx = global_cell[cellIdx];
 
             const double cellVolume = eclgrid->getCellVolume(cartesianCellIdx);
-            ntg[cartesianCellIdx] *= cellVolume;
+            double ntgVolume = ntg[cellIdx] * cellVolume;
             double totalCellVolume = cellVolume;
 
             // Average properties as long as there exist cells above
@@ -233,15 +292,15 @@ namespace Opm
             int cartesianCellIdxAbove = cartesianCellIdx - nx*ny;
             while ( cartesianCellIdxAbove >= 0 &&
                  porv[cartesianCellIdxAbove] > 0 &&
-                 porv[cartesianCellIdxAbove] < eclgrid->getMinpvValue() ) {
+                 porv[cartesianCellIdxAbove] < minpv ) {
 
                 // Volume weighted arithmetic average of NTG
                 const double cellAboveVolume = eclgrid->getCellVolume(cartesianCellIdxAbove);
                 totalCellVolume += cellAboveVolume;
-                ntg[cartesianCellIdx] += ntg[cartesianCellIdxAbove]*cellAboveVolume;
+                ntgVolume += (deckNtg ? deckNtg[cartesianCellIdxAbove] : 1.0) * cellAboveVolume;
                 cartesianCellIdxAbove -= nx*ny;
             }
-            ntg[cartesianCellIdx] /= totalCellVolume;
+            ntg[cellIdx] = ntgVolume / totalCellVolume;
         }
     }
 
@@ -262,40 +321,46 @@ namespace Opm
         auto cell2Faces = Opm::UgGridHelpers::cell2Faces(grid);
         auto faceCells  = Opm::AutoDiffGrid::faceCells(grid);
         const int* global_cell = Opm::UgGridHelpers::globalCell(grid);
-        int cellFaceIdx = 0;
-
+        const std::vector<int> cellFaceStart = cellFaceOffsets_(grid);
+
+        // Translate the C face tags into the enum used by opm-parser's TransMult class
+        static const Opm::FaceDir::DirEnum tagToDirection[6] = {
+            Opm::FaceDir::XMinus, // left
+            Opm::FaceDir::XPlus,  // right
+            Opm::FaceDir::YMinus, // back
+            Opm::FaceDir::YPlus,  // front
+            Opm::FaceDir::ZMinus, // bottom
+            Opm::FaceDir::ZPlus   // top
+        };
+
+        // The multipliers are computed per half-face in parallel, and
+        // combined into the (shared) faces afterwards.
+        std::vector<double> halfFaceMult(cellFaceStart[numCells], 1.0);
+        int badFaceTag = -1;
+#pragma omp parallel for schedule(static)
         for (int cellIdx = 0; cellIdx < numCells; ++cellIdx) {
             // loop over all logically-Cartesian faces of the current cell
             auto cellFacesRange = cell2Faces[cellIdx];
+            int cellFaceIdx = cellFaceStart[cellIdx];
+
+            // the index of the current cell in arrays for the logically-Cartesian grid
+            const int cartesianCellIdx = global_cell[cellIdx];
 
             for(auto cellFaceIter = cellFacesRange.begin(), cellFaceEnd = cellFacesRange.end();
                 cellFaceIter != cellFaceEnd; ++cellFaceIter, ++cellFaceIdx)
             {
-                // the index of the current cell in arrays for the logically-Cartesian grid
-                int cartesianCellIdx = global_cell[cellIdx];
-
                 // The index of the face in the compressed grid
                 int faceIdx = *cellFaceIter;
 
                 // the logically-Cartesian direction of the face
                 int faceTag = Opm::UgGridHelpers::faceTag(grid, cellFaceIter);
-
-                // Translate the C face tag into the enum used by opm-parser's TransMult class
-                Opm::FaceDir::DirEnum faceDirection;
-                if (faceTag == 0) // left
-                    faceDirection = Opm::FaceDir::XMinus;
-                else if (faceTag == 1) // right
-                    faceDirection = Opm::FaceDir::XPlus;
-                else if (faceTag == 2) // back
-                    faceDirection = Opm::FaceDir::YMinus;
-                else if (faceTag == 3) // front
-                    faceDirection = Opm::FaceDir::YPlus;
-                else if (faceTag == 4) // bottom
-                    faceDirection = Opm::FaceDir::ZMinus;
-                else if (faceTag == 5) // top
-                    faceDirection = Opm::FaceDir::ZPlus;
-                else
-                    OPM_THROW(std::logic_error, "Unhandled face direction: " << faceTag);
+                if (faceTag < 0 || faceTag > 5) {
+                    // Exceptions must not leave the parallel region.
+#pragma omp critical
+                    badFaceTag = faceTag;
+                    continue;
+                }
+                const Opm::FaceDir::DirEnum faceDirection = tagToDirection[faceTag];
 
                 // Account for NTG in horizontal one-sided transmissibilities
                 switch (faceDirection) {
@@ -303,7 +368,7 @@ namespace Opm
                 case Opm::FaceDir::XPlus:
                 case Opm::FaceDir::YMinus:
                 case Opm::FaceDir::YPlus:
-                    halfIntersectTransmissibility[cellFaceIdx] *= ntg[cartesianCellIdx];
+                    halfIntersectTransmissibility[cellFaceIdx] *= ntg[cellIdx];
                     break;
                 default:
                     // do nothing for the top and bottom faces
@@ -311,25 +376,36 @@ namespace Opm
                 }
 
                 // Multiplier contribution on this face for MULT[XYZ] logical cartesian multipliers
-                intersectionTransMult[faceIdx] *=
-                    multipliers->getMultiplier(cartesianCellIdx, faceDirection);
+                double mult = multipliers->getMultiplier(cartesianCellIdx, faceDirection);
 
                 // Multiplier contribution on this fase for region multipliers
                 const int cellIdxInside  = faceCells(faceIdx, 0);
                 const int cellIdxOutside = faceCells(faceIdx, 1);
 
                 // Do not apply region multipliers in the case of boundary connections
-                if (cellIdxInside < 0 || cellIdxOutside < 0) {
-                    continue;
-                }
-                const int cartesianCellIdxInside = global_cell[cellIdxInside];
-                const int cartesianCellIdxOutside = global_cell[cellIdxOutside];
-                //  Only apply the region multipliers from the inside
-                if (cartesianCellIdx == cartesianCellIdxInside) {
-                    intersectionTransMult[faceIdx] *= multipliers->getRegionMultiplier(cartesianCellIdxInside,cartesianCellIdxOutside,faceDirection);
+                if (cellIdxInside >= 0 && cellIdxOutside >= 0) {
+                    const int cartesianCellIdxInside = global_cell[cellIdxInside];
+                    const int cartesianCellIdxOutside = global_cell[cellIdxOutside];
+                    //  Only apply the region multipliers from the inside
+                    if (cartesianCellIdx == cartesianCellIdxInside) {
+                        mult *= multipliers->getRegionMultiplier(cartesianCellIdxInside,cartesianCellIdxOutside,faceDirection);
+                    }
                 }
+                halfFaceMult[cellFaceIdx] = mult;
+            }
+        }
+        if (badFaceTag != -1) {
+            OPM_THROW(std::logic_error, "Unhandled face direction: " << badFaceTag);
+        }
 
-
+        // Combine the half-face multipliers into the faces.
+        for (int cellIdx = 0; cellIdx < numCells; ++cellIdx) {
+            auto cellFacesRange = cell2Faces[cellIdx];
+            int cellFaceIdx = cellFaceStart[cellIdx];
+            for(auto cellFaceIter = cellFacesRange.begin(), cellFaceEnd = cellFacesRange.end();
+                cellFaceIter != cellFaceEnd; ++cellFaceIter, ++cellFaceIdx)
+            {
+                intersectionTransMult[*cellFaceIter] *= halfFaceMult[cellFaceIdx];
             }
         }
     }
@@ -0,0 +1,341 @@
+/*
+  Copyright 2015 SINTEF ICT, Applied Mathematics.
+
+  This file is part of the Open Porous Media project (OPM).
+
+  OPM is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  OPM is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with OPM.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "config.h"
+
+#include <opm/autodiff/GridOperatorsCache.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <sstream>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#if defined(__unix__) || (defined(__APPLE__) && defined(__MACH__))
+#define OPM_GRIDOPERATORSCACHE_MMAP 1
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace Opm
+{
+
+    namespace
+    {
+        typedef HelperOps::M M;
+
+        // File layout (native byte order):
+        //   magic[8], version, sizeof(index), sizeof(scalar), grid hash,
+        //   internal faces (count, data), neighbours (count, data),
+        //   ngrad, grad, caver, div, fullngrad, fulldiv, each as
+        //   (rows, cols, nnz, outer[cols+1], inner[nnz], values[nnz]).
+        const char          magic[8] = { 'O', 'P', 'M', 'G', 'O', 'P', 'S', '\0' };
+        const std::uint32_t version  = 2;
+
+        typedef std::remove_pointer<decltype(M().outerIndexPtr())>::type StorageIndex;
+
+        template <typename T>
+        void writeRaw(std::ostream& os, const T* data, const std::size_t n)
+        {
+            os.write(reinterpret_cast<const char*>(data), n * sizeof(T));
+        }
+
+        template <typename T>
+        void writeValue(std::ostream& os, const T& value)
+        {
+            writeRaw(os, &value, 1);
+        }
+
+        void writeMatrix(std::ostream& os, const M& m)
+        {
+            M mc = m;
+            mc.makeCompressed();
+            const std::int64_t rows = mc.rows();
+            const std::int64_t cols = mc.cols();
+            const std::int64_t nnz  = mc.nonZeros();
+            writeValue(os, rows);
+            writeValue(os, cols);
+            writeValue(os, nnz);
+            writeRaw(os, mc.outerIndexPtr(), cols + 1);
+            writeRaw(os, mc.innerIndexPtr(), nnz);
+            writeRaw(os, mc.valuePtr(), nnz);
+        }
+
+
+
+        /// Read-only image of a whole file, memory mapped where
+        /// supported and read into memory otherwise.
+        class FileImage
+        {
+        public:
+            explicit FileImage(const std::string& filename)
+                : data_(0), size_(0)
+            {
+#ifdef OPM_GRIDOPERATORSCACHE_MMAP
+                const int fd = ::open(filename.c_str(), O_RDONLY);
+                if (fd < 0) {
+                    return;
+                }
+                struct stat st;
+                if (::fstat(fd, &st) == 0 && st.st_size > 0) {
+                    void* addr = ::mmap(0, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+                    if (addr != MAP_FAILED) {
+                        data_ = static_cast<const char*>(addr);
+                        size_ = st.st_size;
+                    }
+                }
+                ::close(fd);
+#else
+                std::ifstream is(filename.c_str(), std::ios::binary);
+                buffer_.assign(std::istreambuf_iterator<char>(is), std::istreambuf_iterator<char>());
+                data_ = buffer_.data();
+                size_ = buffer_.size();
+#endif
+            }
+
+            ~FileImage()
+            {
+#ifdef OPM_GRIDOPERATORSCACHE_MMAP
+                if (data_ != 0) {
+                    ::munmap(const_cast<char*>(data_), size_);
+                }
+#endif
+            }
+
+            const char* data() const { return data_; }
+            std::size_t size() const { return size_; }
+
+        private:
+            FileImage(const FileImage&);
+            FileImage& operator=(const FileImage&);
+
+            const char* data_;
+            std::size_t size_;
+#ifndef OPM_GRIDOPERATORSCACHE_MMAP
+            std::vector<char> buffer_;
+#endif
+        };
+
+
+
+        /// Bounds-checked sequential reads from a file image.
+        class ImageReader
+        {
+        public:
+            ImageReader(const char* begin, const std::size_t size)
+                : pos_(begin), end_(begin + size)
+            {
+            }
+
+            template <typename T>
+            bool readRaw(T* data, const std::int64_t n)
+            {
+                if (n < 0 || !fits<T>(n)) {
+                    return false;
+                }
+                std::memcpy(data, pos_, n * sizeof(T));
+                pos_ += n * sizeof(T);
+                return true;
+            }
+
+            template <typename T>
+            bool readValue(T& value)
+            {
+                return readRaw(&value, 1);
+            }
+
+            /// True if n more elements of type T remain.
+            template <typename T>
+            bool fits(const std::int64_t n) const
+            {
+                return n >= 0 && std::uint64_t(n) <= std::uint64_t(end_ - pos_) / sizeof(T);
+            }
+
+            bool atEnd() const { return pos_ == end_; }
+
+        private:
+            const char* pos_;
+            const char* end_;
+        };
+
+
+
+        /// Read a compressed matrix, which must have the given size
+        /// and valid compressed structure: outer starts from zero
+        /// and nondecreasing up to nnz, and strictly increasing inner
+        /// indices in [0, rows) within each column.
+        bool readMatrix(ImageReader& reader,
+                        const std::int64_t expected_rows,
+                        const std::int64_t expected_cols,
+                        M& m)
+        {
+            std::int64_t rows = 0, cols = 0, nnz = 0;
+            if (!reader.readValue(rows) || !reader.readValue(cols) || !reader.readValue(nnz)) {
+                return false;
+            }
+            if (rows != expected_rows || cols != expected_cols
+                || nnz < 0 || nnz > rows * cols
+                || !reader.fits<StorageIndex>(cols + 1 + nnz)) {
+                return false;
+            }
+            M tmp(rows, cols);
+            tmp.resizeNonZeros(nnz);
+            StorageIndex* outer = tmp.outerIndexPtr();
+            StorageIndex* inner = tmp.innerIndexPtr();
+            if (!reader.readRaw(outer, cols + 1)
+                || !reader.readRaw(inner, nnz)
+                || !reader.readRaw(tmp.valuePtr(), nnz)) {
+                return false;
+            }
+            if (outer[0] != 0 || outer[cols] != nnz) {
+                return false;
+            }
+            for (std::int64_t col = 0; col < cols; ++col) {
+                if (outer[col + 1] < outer[col]) {
+                    return false;
+                }
+                for (StorageIndex k = outer[col]; k < outer[col + 1]; ++k) {
+                    if (inner[k] < 0 || inner[k] >= rows
+                        || (k > outer[col] && inner[k] <= inner[k - 1])) {
+                        return false;
+                    }
+                }
+            }
+            m = std::move(tmp);
+            return true;
+        }
+    } // anonymous namespace
+
+
+
+    bool readHelperOps(const std::string& filename,
+                       const std::uint64_t grid_hash,
+                       const int num_cells,
+                       const int num_faces,
+                       HelperOps& ops)
+    {
+        const FileImage image(filename);
+        if (image.data() == 0) {
+            return false;
+        }
+        ImageReader reader(image.data(), image.size());
+
+        char          file_magic[8];
+        std::uint32_t file_version    = 0;
+        std::uint32_t file_index_size = 0;
+        std::uint32_t file_value_size = 0;
+        std::uint64_t file_hash       = 0;
+        if (!reader.readRaw(file_magic, 8)
+            || !std::equal(file_magic, file_magic + 8, magic)
+            || !reader.readValue(file_version)    || file_version != version
+            || !reader.readValue(file_index_size) || file_index_size != sizeof(StorageIndex)
+            || !reader.readValue(file_value_size) || file_value_size != sizeof(double)
+            || !reader.readValue(file_hash)       || file_hash != grid_hash) {
+            return false;
+        }
+
+        // The hash covers the cell and face counts, which bound all
+        // sizes in the file.
+        HelperOps tmp;
+        std::int64_t ni = 0;
+        if (!reader.readValue(ni) || ni < 0 || ni > num_faces) {
+            return false;
+        }
+        tmp.internal_faces.resize(ni);
+        tmp.nbi.resize(ni, 2);
+        if (!reader.readRaw(tmp.internal_faces.data(), ni)
+            || !reader.readRaw(tmp.nbi.data(), 2*ni)) {
+            return false;
+        }
+        for (std::int64_t i = 0; i < ni; ++i) {
+            if (tmp.internal_faces[i] < 0 || tmp.internal_faces[i] >= num_faces
+                || tmp.nbi(i, 0) < 0 || tmp.nbi(i, 0) >= num_cells
+                || tmp.nbi(i, 1) < 0 || tmp.nbi(i, 1) >= num_cells) {
+                return false;
+            }
+        }
+        if (!readMatrix(reader, ni, num_cells, tmp.ngrad)
+            || !readMatrix(reader, ni, num_cells, tmp.grad)
+            || !readMatrix(reader, ni, num_cells, tmp.caver)
+            || !readMatrix(reader, num_cells, ni, tmp.div)
+            || !readMatrix(reader, num_faces, num_cells, tmp.fullngrad)
+            || !readMatrix(reader, num_cells, num_faces, tmp.fulldiv)
+            || !reader.atEnd()) {
+            return false;
+        }
+
+        ops = std::move(tmp);
+        return true;
+    }
+
+
+
+    void writeHelperOps(const std::string& filename,
+                        const std::uint64_t grid_hash,
+                        const HelperOps& ops)
+    {
+        std::ostringstream tmpname;
+        tmpname << filename << ".tmp."
+                << std::chrono::high_resolution_clock::now().time_since_epoch().count()
+                << '.' << static_cast<const void*>(&ops);
+        {
+            std::ofstream os(tmpname.str().c_str(), std::ios::binary | std::ios::trunc);
+            if (!os) {
+                std::cerr << "Warning: could not write grid operators cache " << filename << std::endl;
+                return;
+            }
+            const std::uint32_t index_size = sizeof(StorageIndex);
+            const std::uint32_t value_size = sizeof(double);
+            writeRaw(os, magic, 8);
+            writeValue(os, version);
+            writeValue(os, index_size);
+            writeValue(os, value_size);
+            writeValue(os, grid_hash);
+
+            const std::int64_t num_internal = ops.internal_faces.size();
+            writeValue(os, num_internal);
+            writeRaw(os, ops.internal_faces.data(), num_internal);
+            writeRaw(os, ops.nbi.data(), 2*num_internal);
+            writeMatrix(os, ops.ngrad);
+            writeMatrix(os, ops.grad);
+            writeMatrix(os, ops.caver);
+            writeMatrix(os, ops.div);
+            writeMatrix(os, ops.fullngrad);
+            writeMatrix(os, ops.fulldiv);
+            if (!os) {
+                std::cerr << "Warning: could not write grid operators cache " << filename << std::endl;
+                std::remove(tmpname.str().c_str());
+                return;
+            }
+        }
+        if (std::rename(tmpname.str().c_str(), filename.c_str()) != 0) {
+            std::cerr << "Warning: could not write grid operators cache " << filename << std::endl;
+            std::remove(tmpname.str().c_str());
+        }
+    }
+
+} // namespace Opm
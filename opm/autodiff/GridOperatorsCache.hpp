@@ -0,0 +1,109 @@
+/*
+  Copyright 2015 SINTEF ICT, Applied Mathematics.
+
+  This file is part of the Open Porous Media project (OPM).
+
+  OPM is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  OPM is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with OPM.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef OPM_GRIDOPERATORSCACHE_HEADER_INCLUDED
+#define OPM_GRIDOPERATORSCACHE_HEADER_INCLUDED
+
+#include <opm/autodiff/AutoDiffHelpers.hpp>
+#include <opm/autodiff/GridHelpers.hpp>
+
+#include <cstdint>
+#include <string>
+
+namespace Opm
+{
+
+    /// Hash of the grid topology (face-cell connections) and the
+    /// cell geometry (depths and volumes), used to check that a
+    /// grid-operators cache file belongs to a given grid.
+    template <class Grid>
+    std::uint64_t gridOperatorsHash(const Grid& grid)
+    {
+        using namespace AutoDiffGrid;
+        // 64-bit FNV-1a.
+        std::uint64_t h = 14695981039346656037ULL;
+        auto mix = [&h](const void* data, const std::size_t bytes) {
+            const unsigned char* p = static_cast<const unsigned char*>(data);
+            for (std::size_t i = 0; i < bytes; ++i) {
+                h ^= p[i];
+                h *= 1099511628211ULL;
+            }
+        };
+        const int nc = numCells(grid);
+        const int nf = numFaces(grid);
+        const int dim = dimensions(grid);
+        mix(&nc, sizeof nc);
+        mix(&nf, sizeof nf);
+        mix(&dim, sizeof dim);
+        const typename ADFaceCellTraits<Grid>::Type nb = faceCellsToEigen(grid);
+        for (int f = 0; f < nf; ++f) {
+            const int c[2] = { nb(f, 0), nb(f, 1) };
+            mix(c, sizeof c);
+        }
+        const Eigen::Array<double, Eigen::Dynamic, 1> z = cellCentroidsZToEigen(grid);
+        mix(z.data(), z.size() * sizeof(double));
+        for (int c = 0; c < nc; ++c) {
+            const double v = cellVolume(grid, c);
+            mix(&v, sizeof v);
+        }
+        return h;
+    }
+
+    /// Read the operators of a HelperOps from a grid-operators cache
+    /// file. The file is a flat binary image of the internal faces,
+    /// their neighbours and the compressed sparse operators, which is
+    /// memory mapped where supported. Since HelperOps owns its
+    /// matrices, the arrays are still copied out of the mapping.
+    /// \return false (leaving ops untouched) if the file does not
+    ///         exist, has an unknown format or a different grid hash,
+    ///         or if its sizes or sparse structure are invalid for a
+    ///         grid with the given numbers of cells and faces.
+    bool readHelperOps(const std::string& filename,
+                       const std::uint64_t grid_hash,
+                       const int num_cells,
+                       const int num_faces,
+                       HelperOps& ops);
+
+    /// Write the operators of a HelperOps to a grid-operators cache
+    /// file. The file is written under a temporary name and then
+    /// renamed, so concurrent runs never see a partial file.
+    void writeHelperOps(const std::string& filename,
+                        const std::uint64_t grid_hash,
+                        const HelperOps& ops);
+
+    /// Return the HelperOps of grid, read from the cache file if it
+    /// is valid for this grid, otherwise constructed from the grid
+    /// and written to the cache file for later runs.
+    template <class Grid>
+    HelperOps cachedHelperOps(const Grid& grid, const std::string& filename)
+    {
+        const std::uint64_t hash = gridOperatorsHash(grid);
+        HelperOps ops;
+        if (readHelperOps(filename, hash, AutoDiffGrid::numCells(grid),
+                          AutoDiffGrid::numFaces(grid), ops)) {
+            return ops;
+        }
+        HelperOps built(grid);
+        writeHelperOps(filename, hash, built);
+        return built;
+    }
+
+} // namespace Opm
+
+#endif // OPM_GRIDOPERATORSCACHE_HEADER_INCLUDED
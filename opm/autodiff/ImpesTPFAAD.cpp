@@ -378,7 +378,7 @@ namespace {
             const ADB perf_b = cell_to_well_selector.select(subset(cell_b, well_cells), well_b);
             const V z0 = z0all.block(0, phase, nc, 1);
             const V q  = qall .block(0, phase, nc, 1);
-            const ADB well_contrib = superset(perf_flux*perf_b, well_cells, nc);
+            const ADB well_contrib = supersetSum(perf_flux*perf_b, well_cells, nc);
             const ADB divcontrib = delta_t * (ops_.div * (flux * face_b) + well_contrib);
             const V qcontrib = delta_t * q;
             const ADB pvcontrib = ADB::constant(pv*z0);
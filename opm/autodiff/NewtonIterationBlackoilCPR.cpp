@@ -107,8 +107,16 @@ namespace Opm
         linear_solver_reduction_( param.getDefault("linear_solver_reduction", 1e-3 ) ),
         linear_solver_maxiter_( param.getDefault("linear_solver_maxiter", 150 ) ),
         linear_solver_restart_( param.getDefault("linear_solver_restart", 40 ) ),
-        linear_solver_verbosity_( param.getDefault("linear_solver_verbosity", 0 ))
+        linear_solver_verbosity_( param.getDefault("linear_solver_verbosity", 0 )),
+        reorder_cells_( param.getDefault("linear_solver_reorder", std::string("none")) == "rcm" ),
+        linear_solver_recycle_( param.getDefault("linear_solver_recycle", 0 ) ),
+        permutation_num_blocks_( 0 ),
+        permutation_nnz_( 0 )
     {
+        const std::string reorder = param.getDefault("linear_solver_reorder", std::string("none"));
+        if (reorder != "none" && reorder != "rcm") {
+            OPM_THROW(std::runtime_error, "Unknown linear_solver_reorder " << reorder);
+        }
     }
 
 
@@ -121,6 +129,15 @@ namespace Opm
     NewtonIterationBlackoilCPR::SolutionVector
     NewtonIterationBlackoilCPR::computeNewtonIncrement(const LinearisedBlackoilResidual& residual) const
     {
+        return computeNewtonIncrement(residual, IncrementControls());
+    }
+
+    NewtonIterationBlackoilCPR::SolutionVector
+    NewtonIterationBlackoilCPR::computeNewtonIncrement(const LinearisedBlackoilResidual& residual,
+                                                       const IncrementControls& controls) const
+    {
+        const double reduction = controls.reduction > 0.0 ? controls.reduction : linear_solver_reduction_;
+
         // Build the vector of equations.
         const int np = residual.material_balance_eq.size();
         std::vector<ADB> eqs;
@@ -164,6 +181,20 @@ namespace Opm
         A.topRows(nc) *= pscale;
         b.topRows(nc) *= pscale;
 
+        // Renumber the cells to reduce the bandwidth, which improves
+        // the ILU preconditioner and the locality of the products.
+        bool reorder = reorder_cells_;
+#if HAVE_MPI
+        if (parallelInformation_.type() == typeid(ParallelISTLInformation)) {
+            reorder = false;
+        }
+#endif
+        if (reorder) {
+            updateCellPermutation(A.topLeftCorner(nc, nc), np);
+            A = cell_permutation_->permute(A);
+            b = cell_permutation_->permute(b);
+        }
+
         // Solve reduced system.
         SolutionVector dx(SolutionVector::Zero(b.size()));
 
@@ -176,9 +207,22 @@ namespace Opm
         // Right hand side.
         Vector istlb(istlA.N());
         std::copy_n(b.data(), istlb.size(), istlb.begin());
-        // System solution
+        // System solution, starting from the reservoir part of the
+        // initial guess. The eliminated well unknowns are recovered.
         Vector x(istlA.M());
         x = 0.0;
+        const bool use_x = controls.initial_guess.size() > 0;
+        if (use_x) {
+            if (controls.initial_guess.size() < b.size()) {
+                OPM_THROW(std::logic_error, "Initial guess of size " << controls.initial_guess.size()
+                          << " is smaller than the reduced system of size " << b.size() << ".");
+            }
+            V x0 = controls.initial_guess.head(b.size());
+            if (reorder) {
+                x0 = cell_permutation_->permute(x0);
+            }
+            std::copy_n(x0.data(), x.size(), x.begin());
+        }
 
         Dune::InverseOperatorResult result;
 #if HAVE_MPI
@@ -192,7 +236,7 @@ namespace Opm
             // Construct operator, scalar product and vectors needed.
             typedef Dune::OverlappingSchwarzOperator<Mat,Vector,Vector,Comm> Operator;
             Operator opA(istlA, istlComm);
-            constructPreconditionerAndSolve<Dune::SolverCategory::overlapping>(opA, istlAe, x, istlb, istlComm, result);
+            constructPreconditionerAndSolve<Dune::SolverCategory::overlapping>(opA, istlAe, x, istlb, istlComm, reduction, use_x, result);
         }
         else
 #endif
@@ -201,7 +245,7 @@ namespace Opm
             typedef Dune::MatrixAdapter<Mat,Vector,Vector> Operator;
             Operator opA(istlA);
             Dune::Amg::SequentialInformation info;
-            constructPreconditionerAndSolve(opA, istlAe, x, istlb, info, result);
+            constructPreconditionerAndSolve(opA, istlAe, x, istlb, info, reduction, use_x, result);
         }
 
         // store number of iterations
@@ -214,6 +258,9 @@ namespace Opm
 
         // Copy solver output to dx.
         std::copy(x.begin(), x.end(), dx.data());
+        if (reorder) {
+            dx = cell_permutation_->unpermute(dx);
+        }
 
         if( hasWells )
         {
@@ -232,6 +279,37 @@ namespace Opm
 
 
 
+    void NewtonIterationBlackoilCPR::updateCellPermutation(const Eigen::SparseMatrix<double, Eigen::RowMajor>& Ap,
+                                                           const int num_blocks) const
+    {
+        if (cell_permutation_
+            && cell_permutation_->numCells() == Ap.rows()
+            && permutation_num_blocks_ == num_blocks
+            && permutation_nnz_ == Ap.nonZeros()) {
+            return;
+        }
+        cell_permutation_.reset(new CellPermutation(reverseCuthillMcKee(Ap), num_blocks));
+        permutation_num_blocks_ = num_blocks;
+        permutation_nnz_ = Ap.nonZeros();
+        // The recycled solutions are in the old numbering.
+        recycled_solutions_.clear();
+    }
+
+
+
+    void NewtonIterationBlackoilCPR::recycleSolution(const Vector& x) const
+    {
+        if (linear_solver_recycle_ <= 0) {
+            return;
+        }
+        recycled_solutions_.push_front(x);
+        while (int(recycled_solutions_.size()) > linear_solver_recycle_) {
+            recycled_solutions_.pop_back();
+        }
+    }
+
+
+
     namespace
     {
 
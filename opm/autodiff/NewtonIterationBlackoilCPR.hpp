@@ -24,12 +24,16 @@
 #include <opm/autodiff/DuneMatrix.hpp>
 #include <opm/autodiff/NewtonIterationBlackoilInterface.hpp>
 #include <opm/autodiff/CPRPreconditioner.hpp>
+#include <opm/autodiff/CellOrdering.hpp>
 #include <opm/core/utility/parameters/ParameterGroup.hpp>
 #include <opm/core/linalg/LinearSolverInterface.hpp>
 #include <dune/istl/scalarproducts.hh>
 #include <dune/istl/operators.hh>
 #include <dune/istl/bvector.hh>
+#include <deque>
 #include <memory>
+#include <string>
+#include <vector>
 
 namespace Opm
 {
@@ -58,6 +62,10 @@ namespace Opm
         ///                        cpr_ilu_n        (default 0) use ILU(n) for preconditioning of the linear system
         ///                        cpr_use_amg      (default false) if true, use AMG preconditioner for elliptic part
         ///                        cpr_use_bicgstab (default true)  if true, use BiCGStab (else use CG) for elliptic part
+        ///                        linear_solver_reorder (default "none") if "rcm", renumber the cells
+        ///                                         with reverse Cuthill-McKee before solving (serial runs only)
+        ///                        linear_solver_recycle (default 0) number of previous solutions kept
+        ///                                         to improve the initial guess of the next solve
         /// \param[in] parallelInformation In the case of a parallel run
         ///                               with dune-istl the information about the parallelization.
         NewtonIterationBlackoilCPR(const parameter::ParameterGroup& param,
@@ -70,6 +78,14 @@ namespace Opm
         /// \return               the solution x
         virtual SolutionVector computeNewtonIncrement(const LinearisedBlackoilResidual& residual) const;
 
+        /// \copydoc NewtonIterationBlackoilInterface::computeNewtonIncrement(const LinearisedBlackoilResidual&, const IncrementControls&) const
+        /// The reduction replaces linear_solver_reduction for this
+        /// solve. The iteration starts from the combination of the
+        /// initial guess and the recycled solutions with the smallest
+        /// residual.
+        virtual SolutionVector computeNewtonIncrement(const LinearisedBlackoilResidual& residual,
+                                                      const IncrementControls& controls) const;
+
         /// \copydoc NewtonIterationBlackoilInterface::iterations
         virtual int iterations () const { return iterations_; }
 
@@ -81,10 +97,14 @@ namespace Opm
         /// \brief construct the CPR preconditioner and the solver.
         /// \tparam P The type of the parallel information.
         /// \param parallelInformation the information about the parallelization.
+        /// \param reduction the relative reduction of the residual (of b).
+        /// \param use_x if true, x is an initial guess, otherwise zero.
         template<int category=Dune::SolverCategory::sequential, class O, class P>
         void constructPreconditionerAndSolve(O& opA, DuneMatrix& istlAe,
                                              Vector& x, Vector& istlb,
                                              const P& parallelInformation,
+                                             const double reduction,
+                                             const bool use_x,
                                              Dune::InverseOperatorResult& result) const
         {
             typedef Dune::ScalarProductChooser<Vector,P,category> ScalarProductChooser;
@@ -94,6 +114,26 @@ namespace Opm
             // typedef Dune::SeqILU0<Mat,Vector,Vector> Preconditioner;
            typedef Opm::CPRPreconditioner<Mat,Vector,Vector,P> Preconditioner;
             parallelInformation.copyOwnerToAll(istlb, istlb);
+            parallelInformation.copyOwnerToAll(x, x);
+
+            // Start from the best combination of x and the recycled
+            // solutions. The solvers measure the reduction relative
+            // to the initial residual, so the tolerance is adjusted
+            // to keep it relative to the right hand side.
+            double solve_reduction = reduction;
+            if (linear_solver_recycle_ > 0 || use_x) {
+                const double b_norm = sp->norm(istlb);
+                const double r0_norm = projectInitialGuess(opA, *sp, istlb, use_x, x);
+                if (r0_norm <= reduction * b_norm) {
+                    result.clear();
+                    result.converged = true;
+                    result.reduction = b_norm > 0.0 ? r0_norm / b_norm : 0.0;
+                    recycleSolution(x);
+                    return;
+                }
+                solve_reduction = reduction * b_norm / r0_norm;
+            }
+
             Preconditioner precond(cpr_param_, opA.getmat(), istlAe, parallelInformation);
 
             // TODO: Revise when linear solvers interface opm-core is done
@@ -101,18 +141,81 @@ namespace Opm
             // GMRes solver
             if ( newton_use_gmres_ ) {
                 Dune::RestartedGMResSolver<Vector> linsolve(opA, *sp, precond,
-                          linear_solver_reduction_, linear_solver_restart_, linear_solver_maxiter_, linear_solver_verbosity_);
+                          solve_reduction, linear_solver_restart_, linear_solver_maxiter_, linear_solver_verbosity_);
                 // Solve system.
                 linsolve.apply(x, istlb, result);
             }
             else { // BiCGstab solver
                 Dune::BiCGSTABSolver<Vector> linsolve(opA, *sp, precond,
-                          linear_solver_reduction_, linear_solver_maxiter_, linear_solver_verbosity_);
+                          solve_reduction, linear_solver_maxiter_, linear_solver_verbosity_);
                 // Solve system.
                 linsolve.apply(x, istlb, result);
             }
+            if (result.converged) {
+                recycleSolution(x);
+            }
         }
 
+        /// Replace x by the combination of the recycled solutions,
+        /// and x if use_x is true, that minimises the residual of
+        /// opA x = b. The images of the candidates are
+        /// orthonormalised (modified Gram-Schmidt), and b is
+        /// projected onto their span.
+        /// \return the norm of the residual of the new x.
+        template<class O, class SP>
+        double projectInitialGuess(O& opA, SP& sp, const Vector& b, const bool use_x, Vector& x) const
+        {
+            std::vector<const Vector*> candidates;
+            if (use_x) {
+                candidates.push_back(&x);
+            }
+            for (const Vector& u : recycled_solutions_) {
+                if (u.size() == b.size()) {
+                    candidates.push_back(&u);
+                }
+            }
+
+            std::vector<Vector> z; // z[i] with opA z[i] = q[i].
+            std::vector<Vector> q; // Orthonormal.
+            for (const Vector* u : candidates) {
+                Vector zi(*u);
+                Vector qi(b.size());
+                opA.apply(zi, qi);
+                const double norm0 = sp.norm(qi);
+                for (std::size_t j = 0; j < q.size(); ++j) {
+                    const double h = sp.dot(q[j], qi);
+                    qi.axpy(-h, q[j]);
+                    zi.axpy(-h, z[j]);
+                }
+                const double norm = sp.norm(qi);
+                if (!(norm > 1.0e-10 * norm0)) {
+                    continue; // Linearly dependent.
+                }
+                qi /= norm;
+                zi /= norm;
+                q.push_back(qi);
+                z.push_back(zi);
+            }
+
+            x = 0.0;
+            Vector r(b);
+            for (std::size_t i = 0; i < q.size(); ++i) {
+                const double c = sp.dot(q[i], b);
+                x.axpy(c, z[i]);
+                r.axpy(-c, q[i]);
+            }
+            return sp.norm(r);
+        }
+
+        /// Keep x for the initial guess of the next solves, at most
+        /// linear_solver_recycle of them.
+        void recycleSolution(const Vector& x) const;
+
+        /// Renumber the system with an RCM ordering of the pressure
+        /// block, recomputed only when its sparsity changes.
+        void updateCellPermutation(const Eigen::SparseMatrix<double, Eigen::RowMajor>& Ap,
+                                   const int num_blocks) const;
+
         CPRParameter cpr_param_;
 
         mutable int iterations_;
@@ -123,6 +226,15 @@ namespace Opm
         const int    linear_solver_maxiter_;
         const int    linear_solver_restart_;
         const int    linear_solver_verbosity_;
+        const bool   reorder_cells_;
+        const int    linear_solver_recycle_;
+
+        mutable std::unique_ptr<CellPermutation> cell_permutation_;
+        mutable int permutation_num_blocks_;
+        mutable int permutation_nnz_;
+        // Latest solutions of the reduced system, in the ordering of
+        // the ISTL system, the most recent first.
+        mutable std::deque<Vector> recycled_solutions_;
     };
 
 } // namespace Opm
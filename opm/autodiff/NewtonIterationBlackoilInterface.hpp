@@ -41,6 +41,32 @@ namespace Opm
         /// \return               the solution x
         virtual SolutionVector computeNewtonIncrement(const LinearisedBlackoilResidual& residual) const = 0;
 
+        /// Settings of a single solve that override the defaults of
+        /// the linear solver.
+        struct IncrementControls
+        {
+            IncrementControls() : reduction(-1.0) {}
+            /// Relative residual reduction (inexact Newton), the
+            /// solver's own tolerance is used if not positive.
+            double reduction;
+            /// Start of the iteration, zero if empty. Has the size of
+            /// the solution.
+            SolutionVector initial_guess;
+        };
+
+        /// Solve the linear system Ax = b as computeNewtonIncrement(),
+        /// with the given tolerance and initial guess. Solvers
+        /// without these settings ignore them and call
+        /// computeNewtonIncrement().
+        /// \param[in] residual   residual object containing A and b.
+        /// \param[in] controls   settings of this solve.
+        /// \return               the solution x
+        virtual SolutionVector computeNewtonIncrement(const LinearisedBlackoilResidual& residual,
+                                                      const IncrementControls& /* controls */) const
+        {
+            return computeNewtonIncrement(residual);
+        }
+
         /// \return number of linear iterations used during last call of computeNewtonIncrement
         virtual int iterations () const = 0;
 
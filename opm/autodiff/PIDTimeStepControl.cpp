@@ -0,0 +1,105 @@
+/*
+  Copyright 2015 SINTEF ICT, Applied Mathematics.
+
+  This file is part of the Open Porous Media project (OPM).
+
+  OPM is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  OPM is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with OPM.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <config.h>
+
+#include <opm/autodiff/PIDTimeStepControl.hpp>
+#include <opm/core/utility/parameters/ParameterGroup.hpp>
+#include <opm/core/utility/ErrorMacros.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+namespace Opm
+{
+
+    namespace
+    {
+        // Gains of the PID controller.
+        const double kP = 0.075;
+        const double kI = 0.175;
+        const double kD = 0.01;
+    }
+
+
+
+    PIDTimeStepControl::PIDTimeStepControl(const int target_iterations,
+                                           const double target_ds,
+                                           const double max_growth,
+                                           const double min_factor,
+                                           const double chop_factor)
+        : target_iterations_(target_iterations)
+        , target_ds_(target_ds)
+        , max_growth_(max_growth)
+        , min_factor_(min_factor)
+        , chop_factor_(chop_factor)
+    {
+        if (target_iterations < 1 || !(target_ds > 0.0)
+            || !(max_growth >= 1.0) || !(min_factor > 0.0 && min_factor <= 1.0)
+            || !(chop_factor > 0.0 && chop_factor < 1.0)) {
+            OPM_THROW(std::runtime_error, "PIDTimeStepControl: invalid parameters.");
+        }
+    }
+
+
+
+    PIDTimeStepControl::PIDTimeStepControl(const parameter::ParameterGroup& param)
+        : PIDTimeStepControl(param.getDefault("timestep.target_newton_iterations", 8),
+                             param.getDefault("timestep.target_ds", 0.2),
+                             param.getDefault("timestep.max_growth", 3.0),
+                             param.getDefault("timestep.min_factor", 0.2),
+                             param.getDefault("timestep.chop_factor", 0.5))
+    {
+    }
+
+
+
+    double PIDTimeStepControl::suggestNext(const double dt,
+                                           const int newton_iterations,
+                                           const double max_ds)
+    {
+        // A step without saturation change gives the largest growth.
+        const double e = std::max(max_ds / target_ds_, 1.0e-6);
+        double factor;
+        if (e > 1.0) {
+            factor = 1.0 / e;
+        } else {
+            const double e1 = errors_.size() > 0 ? errors_.back() : e;
+            const double e2 = errors_.size() > 1 ? errors_.front() : e1;
+            factor = std::pow(e1 / e, kP) * std::pow(1.0 / e, kI) * std::pow(e1 * e1 / (e * e2), kD);
+        }
+        errors_.push_back(e);
+        if (errors_.size() > 2) {
+            errors_.erase(errors_.begin());
+        }
+
+        factor = std::min(factor, double(target_iterations_) / std::max(newton_iterations, 1));
+        factor = std::min(std::max(factor, min_factor_), max_growth_);
+        return dt * factor;
+    }
+
+
+
+    double PIDTimeStepControl::suggestAfterFailure(const double dt) const
+    {
+        return dt * chop_factor_;
+    }
+
+} // namespace Opm
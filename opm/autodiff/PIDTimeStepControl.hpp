@@ -0,0 +1,87 @@
+/*
+  Copyright 2015 SINTEF ICT, Applied Mathematics.
+
+  This file is part of the Open Porous Media project (OPM).
+
+  OPM is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  OPM is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with OPM.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef OPM_PIDTIMESTEPCONTROL_HEADER_INCLUDED
+#define OPM_PIDTIMESTEPCONTROL_HEADER_INCLUDED
+
+#include <vector>
+
+namespace Opm
+{
+
+    namespace parameter { class ParameterGroup; }
+
+    /// Time step control aiming at a target saturation change and a
+    /// target number of Newton iterations per step.
+    ///
+    /// The saturation change is controlled by a PID controller on
+    /// the ratio e_n = max_ds / target_ds of the accepted steps:
+    ///   dt_{n+1} = dt_n (e_{n-1}/e_n)^kP (1/e_n)^kI (e_{n-1}^2/(e_n e_{n-2}))^kD,
+    /// or dt_n / e_n after a step with e_n > 1. The step is limited by
+    /// the factor target_iterations / newton_iterations as well, and
+    /// the change between consecutive steps by min_factor and max_growth.
+    class PIDTimeStepControl
+    {
+    public:
+        /// Construct a controller.
+        /// \param[in] target_iterations  desired Newton iterations per step.
+        /// \param[in] target_ds          desired max saturation change per step.
+        /// \param[in] max_growth         largest ratio of consecutive steps.
+        /// \param[in] min_factor         smallest ratio of consecutive accepted steps.
+        /// \param[in] chop_factor        step reduction after a failed step.
+        PIDTimeStepControl(const int target_iterations,
+                           const double target_ds,
+                           const double max_growth = 3.0,
+                           const double min_factor = 0.2,
+                           const double chop_factor = 0.5);
+
+        /// Construct from the parameters
+        ///   timestep.target_newton_iterations (8)
+        ///   timestep.target_ds (0.2)
+        ///   timestep.max_growth (3.0)
+        ///   timestep.min_factor (0.2)
+        ///   timestep.chop_factor (0.5)
+        explicit PIDTimeStepControl(const parameter::ParameterGroup& param);
+
+        /// Length of the step following an accepted step.
+        /// \param[in] dt                 length of the accepted step.
+        /// \param[in] newton_iterations  Newton iterations it used.
+        /// \param[in] max_ds             largest saturation change over the step.
+        double suggestNext(const double dt,
+                           const int newton_iterations,
+                           const double max_ds);
+
+        /// Length of the retry of a failed step of length dt.
+        double suggestAfterFailure(const double dt) const;
+
+        /// Forget the errors of the previous steps.
+        void reset() { errors_.clear(); }
+
+    private:
+        int target_iterations_;
+        double target_ds_;
+        double max_growth_;
+        double min_factor_;
+        double chop_factor_;
+        std::vector<double> errors_; // e_{n-2}, e_{n-1}, at most two.
+    };
+
+} // namespace Opm
+
+#endif // OPM_PIDTIMESTEPCONTROL_HEADER_INCLUDED
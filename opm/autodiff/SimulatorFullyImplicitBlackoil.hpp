@@ -63,6 +63,24 @@ namespace Opm
         ///     num_transport_substeps (1)     number of transport steps per pressure step
         ///     use_segregation_split (false)  solve for gravity segregation (if false,
         ///                                    segregation is ignored).
+        ///     extrapolation_order (0)        if 1 or 2, extrapolate the initial guess of
+        ///                                    each step linearly or quadratically in time
+        ///                                    from the previous accepted steps.
+        ///     solver_approach (fully_implicit) "sequential" to iterate an implicit
+        ///                                    pressure step and an implicit transport
+        ///                                    step with fixed total flux instead; the
+        ///                                    linear systems are then solved by a
+        ///                                    NewtonIterationBlackoilSimple solver.
+        ///     sequential_max_inner_iter (10) max Newton iterations of each stage.
+        ///     reorder_transport (false)      with the sequential approach, solve the
+        ///                                    transport cell by cell in upwind order
+        ///                                    before the global transport iterations.
+        ///     timestep.control ("none")      "pid" to divide each report step into
+        ///                                    substeps chosen by a PIDTimeStepControl
+        ///                                    (see there for its parameters), unless
+        ///                                    timestep.adaptive is set.
+        ///     timestep.initial_step_length (report step length) first substep, in days.
+        ///     timestep.max_restarts (10)     max consecutive failed substeps.
         ///
         /// \param[in] grid          grid data structure
         /// \param[in] geo           derived geological properties
@@ -24,7 +24,11 @@
 #include <opm/core/utility/ErrorMacros.hpp>
 
 #include <opm/autodiff/GeoProps.hpp>
+#include <opm/autodiff/BlackoilPhaseConfiguration.hpp>
+#include <opm/autodiff/BlackoilStateExtrapolation.hpp>
 #include <opm/autodiff/FullyImplicitBlackoilSolver.hpp>
+#include <opm/autodiff/NewtonIterationBlackoilSimple.hpp>
+#include <opm/autodiff/PIDTimeStepControl.hpp>
 #include <opm/autodiff/BlackoilPropsAdInterface.hpp>
 #include <opm/autodiff/WellStateFullyImplicitBlackoil.hpp>
 #include <opm/autodiff/RateConverter.hpp>
@@ -38,6 +42,8 @@
 #include <opm/core/simulator/SimulatorTimer.hpp>
 #include <opm/core/simulator/AdaptiveSimulatorTimer.hpp>
 #include <opm/core/utility/StopWatch.hpp>
+#include <opm/core/utility/Exceptions.hpp>
+#include <opm/core/utility/Units.hpp>
 #include <opm/core/io/vtk/writeVtkData.hpp>
 #include <opm/core/utility/miscUtilities.hpp>
 #include <opm/core/utility/miscUtilitiesBlackoil.hpp>
@@ -120,6 +126,30 @@ namespace Opm
         RateConverterType rateConverter_;
         // Threshold pressures.
         std::vector<double> threshold_pressures_by_face_;
+        // Compile-time phase configuration used for the solver.
+        const BlackoilPhaseConfigurationId phase_config_;
+        // Accepted states for the initial guess extrapolation, null if disabled.
+        std::unique_ptr<BlackoilStateExtrapolation> extrapolation_;
+        // Linear solver of the sequential solver approach, whose
+        // pressure and transport systems do not have the block
+        // structure required by the CPR solver. Null if not used.
+        std::unique_ptr<NewtonIterationBlackoilInterface> sequential_linsolver_;
+        // Substep control of the report steps, null if disabled.
+        std::unique_ptr<PIDTimeStepControl> step_control_;
+        // Next substep length, carried over to the next report step.
+        // Non-positive to start with the report step length.
+        double suggested_step_;
+        int max_restarts_;
+
+        template <class PhaseConfig>
+        void
+        solveReportStep(SimulatorTimer& timer,
+                        const Wells* wells,
+                        BlackoilState& state,
+                        WellStateFullyImplicitBlackoil& well_state,
+                        AdaptiveTimeStepping* adaptiveTimeStepping,
+                        unsigned int& newtonIterations,
+                        unsigned int& linearIterations);
 
         void
         computeRESV(const std::size_t               step,
@@ -189,9 +219,27 @@ namespace Opm
           eclipse_state_(eclipse_state),
           output_writer_(output_writer),
           rateConverter_(props_, std::vector<int>(AutoDiffGrid::numCells(grid_), 0)),
-          threshold_pressures_by_face_(threshold_pressures_by_face)
+          threshold_pressures_by_face_(threshold_pressures_by_face),
+          phase_config_(blackoilPhaseConfiguration(props.phaseUsage(), has_disgas, has_vapoil)),
+          suggested_step_(-1.0),
+          max_restarts_(0)
     {
         // Misc init.
+        const int extrapolation_order = param.getDefault("extrapolation_order", int(0));
+        if (extrapolation_order > 0) {
+            extrapolation_.reset(new BlackoilStateExtrapolation(extrapolation_order));
+        }
+        if (param.getDefault("solver_approach", std::string("fully_implicit")) == "sequential") {
+            sequential_linsolver_.reset(new NewtonIterationBlackoilSimple(param, solver_.parallelInformation()));
+        }
+        const std::string step_control = param.getDefault("timestep.control", std::string("none"));
+        if (step_control == "pid") {
+            step_control_.reset(new PIDTimeStepControl(param));
+            suggested_step_ = unit::convert::from(param.getDefault("timestep.initial_step_length", -1.0), unit::day);
+            max_restarts_ = param.getDefault("timestep.max_restarts", int(10));
+        } else if (step_control != "none") {
+            OPM_THROW(std::runtime_error, "Unknown timestep.control: " << step_control);
+        }
         const int num_cells = AutoDiffGrid::numCells(grid);
         allcells_.resize(num_cells);
         for (int cell = 0; cell < num_cells; ++cell) {
@@ -228,8 +276,6 @@ namespace Opm
         std::string tstep_filename = output_writer_.outputDirectory() + "/step_timing.txt";
         std::ofstream tstep_os(tstep_filename.c_str());
 
-        typename FullyImplicitBlackoilSolver<T>::SolverParameter solverParam( param_ );
-
         // adaptive time stepping
         std::unique_ptr< AdaptiveTimeStepping > adaptiveTimeStepping;
         if( param_.getDefault("timestep.adaptive", bool(false) ) )
@@ -285,33 +331,36 @@ namespace Opm
             computeRESV(timer.currentStepNum(), wells, state, well_state);
 
             // Run a multiple steps of the solver depending on the time step control.
+            // The runtime phase configuration selects the solver instantiation.
             solver_timer.start();
 
-            FullyImplicitBlackoilSolver<T> solver(solverParam, grid_, props_, geo_, rock_comp_props_, wells, solver_, has_disgas_, has_vapoil_, terminal_output_);
-            if (!threshold_pressures_by_face_.empty()) {
-                solver.setThresholdPressures(threshold_pressures_by_face_);
-            }
-
-            // If sub stepping is enabled allow the solver to sub cycle
-            // in case the report steps are to large for the solver to converge
-            //
-            // \Note: The report steps are met in any case
-            // \Note: The sub stepping will require a copy of the state variables
-            if( adaptiveTimeStepping ) {
-                adaptiveTimeStepping->step( timer, solver, state, well_state,  output_writer_ );
-            }
-            else {
-                // solve for complete report step
-                solver.step(timer.currentStepLength(), state, well_state);
+            AdaptiveTimeStepping* ats = adaptiveTimeStepping.get();
+            switch (phase_config_) {
+            case OilWaterConfigurationId:
+                solveReportStep<OilWaterConfiguration>(timer, wells, state, well_state, ats,
+                                                       totalNewtonIterations, totalLinearIterations);
+                break;
+            case DeadOilGasConfigurationId:
+                solveReportStep<DeadOilGasConfiguration>(timer, wells, state, well_state, ats,
+                                                         totalNewtonIterations, totalLinearIterations);
+                break;
+            case LiveOilConfigurationId:
+                solveReportStep<LiveOilConfiguration>(timer, wells, state, well_state, ats,
+                                                      totalNewtonIterations, totalLinearIterations);
+                break;
+            case LiveOilWetGasConfigurationId:
+                solveReportStep<LiveOilWetGasConfiguration>(timer, wells, state, well_state, ats,
+                                                            totalNewtonIterations, totalLinearIterations);
+                break;
+            default:
+                solveReportStep<DynamicBlackoilPhaseConfiguration>(timer, wells, state, well_state, ats,
+                                                                   totalNewtonIterations, totalLinearIterations);
+                break;
             }
 
             // take time that was used to solve system for this reportStep
             solver_timer.stop();
 
-            // accumulate the number of Newton and Linear Iterations
-            totalNewtonIterations += solver.newtonIterations();
-            totalLinearIterations += solver.linearIterations();
-
             // Report timing.
             const double st = solver_timer.secsSinceStart();
 
@@ -347,6 +396,101 @@ namespace Opm
         return report;
     }
 
+    template<class T>
+    template<class PhaseConfig>
+    void
+    SimulatorFullyImplicitBlackoil<T>::Impl::solveReportStep(SimulatorTimer& timer,
+                                                            const Wells* wells,
+                                                            BlackoilState& state,
+                                                            WellStateFullyImplicitBlackoil& well_state,
+                                                            AdaptiveTimeStepping* adaptiveTimeStepping,
+                                                            unsigned int& newtonIterations,
+                                                            unsigned int& linearIterations)
+    {
+        typedef FullyImplicitBlackoilSolver<T, PhaseConfig> Solver;
+        typename Solver::SolverParameter solverParam( param_ );
+
+        const NewtonIterationBlackoilInterface& linsolver = sequential_linsolver_ ? *sequential_linsolver_ : solver_;
+        Solver solver(solverParam, grid_, props_, geo_, rock_comp_props_, wells, linsolver, has_disgas_, has_vapoil_, terminal_output_);
+        if (!threshold_pressures_by_face_.empty()) {
+            solver.setThresholdPressures(threshold_pressures_by_face_);
+        }
+        solver.setStateExtrapolation(extrapolation_.get());
+
+        // If sub stepping is enabled allow the solver to sub cycle
+        // in case the report steps are to large for the solver to converge
+        //
+        // \Note: The report steps are met in any case
+        // \Note: The sub stepping will require a copy of the state variables
+        if( adaptiveTimeStepping ) {
+            adaptiveTimeStepping->step( timer, solver, state, well_state,  output_writer_ );
+        }
+        else if (step_control_) {
+            // Substeps of the lengths suggested by the controller,
+            // with the last one ending at the report step. A remainder
+            // of up to max_stretch times the proposal is merged into
+            // the last substep instead of being run on its own.
+            const double max_stretch = 0.2;
+            double remaining = timer.currentStepLength();
+            double dt = suggested_step_ > 0.0 ? suggested_step_ : remaining;
+            int restarts = 0;
+            while (remaining > 0.0) {
+                const bool last = remaining <= (1.0 + max_stretch) * dt;
+                const double substep = last ? remaining : dt;
+                const BlackoilState last_state(state);
+                const WellStateFullyImplicitBlackoil last_well_state(well_state);
+                int linear_its = -1;
+                try {
+                    linear_its = solver.step(substep, state, well_state);
+                }
+                catch (const Opm::NumericalProblem& e) {
+                    std::cerr << "Substep failed: " << e.what() << std::endl;
+                }
+                if (linear_its < 0) {
+                    if (++restarts > max_restarts_) {
+                        OPM_THROW(Opm::NumericalProblem, "Substep failed " << restarts
+                                  << " times in a row in report step " << timer.currentStepNum());
+                    }
+                    state = last_state;
+                    well_state = last_well_state;
+                    dt = step_control_->suggestAfterFailure(substep);
+                    if (terminal_output_) {
+                        std::cout << "Restarting with substep " << unit::convert::to(dt, unit::day) << " days" << std::endl;
+                    }
+                    continue;
+                }
+                restarts = 0;
+                remaining = last ? 0.0 : remaining - substep;
+                const typename Solver::StepReport& report = solver.lastStepReport();
+                const double suggestion = step_control_->suggestNext(substep, report.newton_iterations, report.max_ds);
+                if (substep < dt) {
+                    // A substep clipped to the end of the report step
+                    // may only reduce the proposal, not replace it.
+                    dt *= std::min(suggestion / substep, 1.0);
+                } else {
+                    dt = suggestion;
+                }
+                if (terminal_output_) {
+                    std::cout << "Substep " << unit::convert::to(substep, unit::day) << " days: "
+                              << report.newton_iterations << " Newton iterations, "
+                              << report.linear_iterations << " linear iterations, max dp "
+                              << unit::convert::to(report.max_dp, unit::barsa) << " bar, max ds "
+                              << report.max_ds << ". Next substep "
+                              << unit::convert::to(dt, unit::day) << " days" << std::endl;
+                }
+            }
+            suggested_step_ = dt;
+        }
+        else {
+            // solve for complete report step
+            solver.step(timer.currentStepLength(), state, well_state);
+        }
+
+        // accumulate the number of Newton and Linear Iterations
+        newtonIterations += solver.newtonIterations();
+        linearIterations += solver.linearIterations();
+    }
+
     namespace SimFIBODetails {
         typedef std::unordered_map<std::string, WellConstPtr> WellMap;
 
@@ -26,6 +26,7 @@
 #define BOOST_TEST_MODULE AutoDiffHelpersTest
 
 #include <opm/autodiff/AutoDiffHelpers.hpp>
+#include <opm/core/grid/GridManager.hpp>
 
 #include <boost/test/unit_test.hpp>
 
@@ -144,3 +145,256 @@ BOOST_AUTO_TEST_CASE(vertcatCollapseJacsTest)
     BOOST_CHECK((x.value() == expected_val).all());
     BOOST_CHECK(x.derivative()[0] == expected_jac);
 }
+
+
+
+namespace {
+    AutoDiffBlock<double>::M
+    selectionMatrix(const int full_size, const std::vector<int>& indices)
+    {
+        AutoDiffBlock<double>::M mat(indices.size(), full_size);
+        for (int i = 0; i < int(indices.size()); ++i) {
+            mat.insert(i, indices[i]) = 1.0;
+        }
+        return mat;
+    }
+
+    std::vector<AutoDiffBlock<double> > subsetTestVariables()
+    {
+        typedef AutoDiffBlock<double> ADB;
+        ADB::V x(5), y(2);
+        x << 1.0, 2.0, 3.0, 4.0, 5.0;
+        y << 6.0, 7.0;
+        std::vector<ADB::V> vals{ x, y };
+        return ADB::variables(vals);
+    }
+}
+
+
+
+BOOST_AUTO_TEST_CASE(subsetSupersetTest)
+{
+    typedef AutoDiffBlock<double> ADB;
+    typedef ADB::V V;
+    typedef ADB::M M;
+
+    const std::vector<ADB> vars = subsetTestVariables();
+    // A quantity with coupled, nonzero Jacobians in both blocks.
+    const ADB x = vars[0] * vars[0] + (selectionMatrix(2, { 0, 1, 1, 0, 1 }) * vars[1]);
+
+    // Unsorted, repeated indices.
+    const std::vector<int> ind{ 3, 0, 3, 4 };
+    const ADB xs = subset(x, ind);
+    const M sel = selectionMatrix(5, ind);
+    const ADB xs_ref = sel * x;
+    BOOST_CHECK((xs.value() == xs_ref.value()).all());
+    BOOST_REQUIRE_EQUAL(xs.numBlocks(), 2);
+    for (int block = 0; block < 2; ++block) {
+        BOOST_CHECK(xs.derivative()[block] == M(xs_ref.derivative()[block]));
+    }
+
+    // Unsorted, unique indices.
+    const std::vector<int> sup_ind{ 6, 1, 4, 2 };
+    const ADB xp = superset(xs, sup_ind, 8);
+    const ADB xp_ref = M(selectionMatrix(8, sup_ind).transpose()) * xs;
+    BOOST_CHECK((xp.value() == xp_ref.value()).all());
+    for (int block = 0; block < 2; ++block) {
+        BOOST_CHECK(xp.derivative()[block] == M(xp_ref.derivative()[block]));
+    }
+    V expected(8);
+    expected << 0.0, xs.value()[1], xs.value()[3], 0.0, xs.value()[2], 0.0, xs.value()[0], 0.0;
+    BOOST_CHECK((superset(xs.value(), sup_ind, 8) == expected).all());
+
+    // Repeated indices, e.g. perforations sharing a cell, are summed
+    // by supersetSum() as by the transposed selection matrix.
+    const std::vector<int> rep_ind{ 6, 1, 6, 1 };
+    const ADB xr = supersetSum(xs, rep_ind, 8);
+    const ADB xr_ref = M(selectionMatrix(8, rep_ind).transpose()) * xs;
+    BOOST_CHECK((xr.value() == xr_ref.value()).all());
+    for (int block = 0; block < 2; ++block) {
+        BOOST_CHECK(xr.derivative()[block] == M(xr_ref.derivative()[block]));
+    }
+    BOOST_CHECK_EQUAL(xr.value()[6], xs.value()[0] + xs.value()[2]);
+    BOOST_CHECK((supersetSum(xs.value(), rep_ind, 8) == xr_ref.value()).all());
+}
+
+
+
+BOOST_AUTO_TEST_CASE(supersetSumTest)
+{
+    typedef AutoDiffBlock<double> ADB;
+    typedef ADB::M M;
+
+    const std::vector<ADB> vars = subsetTestVariables();
+    const ADB x = vars[0] * vars[0] + (selectionMatrix(2, { 0, 1, 1, 0, 1 }) * vars[1]);
+
+    // Repeated indices are summed, like perforations sharing a cell,
+    // both sorted and unsorted.
+    for (const std::vector<int>& ind : { std::vector<int>{ 0, 2, 2, 5, 5 },
+                                         std::vector<int>{ 5, 2, 0, 2, 5 } }) {
+        const ADB xs = supersetSum(x, ind, 7);
+        const ADB xs_ref = M(selectionMatrix(7, ind).transpose()) * x;
+        BOOST_CHECK((xs.value() == xs_ref.value()).all());
+        BOOST_REQUIRE_EQUAL(xs.numBlocks(), 2);
+        for (int block = 0; block < 2; ++block) {
+            BOOST_CHECK(xs.derivative()[block] == M(xs_ref.derivative()[block]));
+        }
+    }
+}
+
+
+
+BOOST_AUTO_TEST_CASE(restrictColumnsTest)
+{
+    typedef AutoDiffBlock<double> ADB;
+    typedef ADB::M M;
+
+    const std::vector<ADB> vars = subsetTestVariables();
+    const ADB x = vars[0] * vars[0] + (selectionMatrix(2, { 0, 1, 1, 0, 1 }) * vars[1]);
+
+    // The local Newton system keeps the columns of the selected
+    // cells in the cell blocks, and all columns of the others.
+    const std::vector<int> cols{ 1, 3, 4 };
+    const ADB xr = restrictColumns(x, 1, cols);
+    BOOST_CHECK((xr.value() == x.value()).all());
+    BOOST_REQUIRE_EQUAL(xr.numBlocks(), 2);
+    BOOST_CHECK(xr.derivative()[0] == M(x.derivative()[0] * M(selectionMatrix(5, cols).transpose())));
+    BOOST_CHECK(xr.derivative()[1] == x.derivative()[1]);
+
+    // The well equations of a local Newton system without wells
+    // have no derivatives and are passed through.
+    const ADB no_wells = ADB::null();
+    const ADB nr = restrictColumns(no_wells, 1, cols);
+    BOOST_CHECK_EQUAL(nr.size(), 0);
+    BOOST_CHECK(nr.derivative().empty());
+}
+
+
+
+BOOST_AUTO_TEST_CASE(selectorTest)
+{
+    typedef AutoDiffBlock<double> ADB;
+    typedef ADB::V V;
+    typedef ADB::M M;
+
+    const std::vector<ADB> vars = subsetTestVariables();
+    const ADB x1 = vars[0] * vars[0];
+    const ADB x2 = 2.0 * vars[0] + (selectionMatrix(2, { 1, 1, 0, 0, 1 }) * vars[1]);
+    V basis(5);
+    basis << 1.0, -1.0, 0.0, -2.0, 3.0;
+
+    Selector<double> sel(basis);
+    const ADB x = sel.select(x1, x2);
+
+    const std::vector<int> left{ 0, 2, 4 };
+    const std::vector<int> right{ 1, 3 };
+    const ADB x_ref = M(selectionMatrix(5, left).transpose()) * (selectionMatrix(5, left) * x1)
+                    + M(selectionMatrix(5, right).transpose()) * (selectionMatrix(5, right) * x2);
+    BOOST_CHECK((x.value() == x_ref.value()).all());
+    BOOST_CHECK((sel.select(x1.value(), x2.value()) == x_ref.value()).all());
+    for (int block = 0; block < 2; ++block) {
+        BOOST_CHECK(x.derivative()[block] == M(x_ref.derivative()[block]));
+    }
+
+    // Constant first argument.
+    const ADB c = sel.select(ADB::constant(V::Constant(5, 7.0)), x2);
+    BOOST_REQUIRE_EQUAL(c.numBlocks(), 2);
+    BOOST_CHECK_EQUAL(c.value()[0], 7.0);
+    BOOST_CHECK_EQUAL(c.value()[1], x2.value()[1]);
+    BOOST_CHECK_EQUAL(c.derivative()[0].coeff(0, 0), 0.0);
+    BOOST_CHECK_EQUAL(c.derivative()[0].coeff(1, 1), 2.0);
+}
+
+
+
+BOOST_AUTO_TEST_CASE(faceLoopKernelsTest)
+{
+    typedef AutoDiffBlock<double> ADB;
+    typedef ADB::V V;
+    typedef ADB::M M;
+
+    const GridManager gm(3, 2);
+    const UnstructuredGrid& grid = *gm.c_grid();
+    const HelperOps ops(grid);
+    const int nc = grid.number_of_cells;
+    const int nif = ops.internal_faces.size();
+
+    // Cell quantity with one diagonal and one non-diagonal block.
+    V p(nc), s(nc);
+    for (int c = 0; c < nc; ++c) {
+        p[c] = 100.0 + c*c;
+        s[c] = 0.1*c;
+    }
+    std::vector<V> vals{ p, s };
+    const std::vector<ADB> vars = ADB::variables(vals);
+    const ADB x = vars[0] * vars[0] + ops.div * (ops.ngrad * vars[1]);
+
+    const ADB g = applyNGrad(ops, x);
+    const ADB g_ref = ops.ngrad * x;
+    BOOST_CHECK((g.value() == g_ref.value()).all());
+    BOOST_CHECK((applyNGrad(ops, x.value()) == g_ref.value()).all());
+    const ADB a = applyCAver(ops, x);
+    const ADB a_ref = ops.caver * x;
+    BOOST_CHECK((a.value() == a_ref.value()).all());
+    for (int block = 0; block < 2; ++block) {
+        BOOST_CHECK(g.derivative()[block] == M(g_ref.derivative()[block]));
+        BOOST_CHECK(a.derivative()[block] == M(a_ref.derivative()[block]));
+    }
+
+    // Face quantity.
+    V t(nif);
+    for (int f = 0; f < nif; ++f) {
+        t[f] = 1.0 + f;
+    }
+    const ADB flux = t * g;
+    const ADB d = applyDiv(ops, flux);
+    const ADB d_ref = ops.div * flux;
+    BOOST_CHECK((d.value() - d_ref.value()).abs().maxCoeff() < 1e-12);
+    BOOST_CHECK((applyDiv(ops, flux.value()) - d_ref.value()).abs().maxCoeff() < 1e-12);
+    for (int block = 0; block < 2; ++block) {
+        BOOST_CHECK(M(d.derivative()[block] - d_ref.derivative()[block]).norm() < 1e-12);
+    }
+}
+
+
+
+BOOST_AUTO_TEST_CASE(upwindSelectorTest)
+{
+    typedef AutoDiffBlock<double> ADB;
+    typedef ADB::V V;
+    typedef ADB::M M;
+
+    const GridManager gm(3, 2);
+    const UnstructuredGrid& grid = *gm.c_grid();
+    const HelperOps ops(grid);
+    const int nc = grid.number_of_cells;
+    const int nif = ops.internal_faces.size();
+
+    V p(nc);
+    for (int c = 0; c < nc; ++c) {
+        p[c] = (c % 2 == 0) ? 10.0 + c : 5.0 - c;
+    }
+    const ADB x = ADB::variable(0, p, { nc }) * ADB::variable(0, p, { nc });
+    const V flux = ops.ngrad * p.matrix();
+
+    UpwindSelector<double> upwind(grid, ops, flux);
+    M select(nif, nc);
+    for (int f = 0; f < nif; ++f) {
+        select.insert(f, flux[f] >= 0 ? ops.nbi(f, 0) : ops.nbi(f, 1)) = 1.0;
+    }
+    const ADB xf = upwind.select(x);
+    const ADB xf_ref = select * x;
+    BOOST_CHECK((xf.value() == xf_ref.value()).all());
+    BOOST_CHECK((upwind.select(x.value()) == xf_ref.value()).all());
+    BOOST_CHECK(xf.derivative()[0] == M(xf_ref.derivative()[0]));
+
+    // Same directions: nothing to redo. Reversed: all faces flip.
+    BOOST_CHECK(!upwind.update(ops, 2.0 * flux));
+    BOOST_CHECK(upwind.update(ops, -flux - 1.0));
+    const ADB xr = upwind.select(x);
+    for (int f = 0; f < nif; ++f) {
+        const int c = (-flux[f] - 1.0 >= 0) ? ops.nbi(f, 0) : ops.nbi(f, 1);
+        BOOST_CHECK_EQUAL(xr.value()[f], x.value()[c]);
+        BOOST_CHECK_EQUAL(xr.derivative()[0].coeff(f, c), 2.0 * p[c]);
+    }
+}
@@ -0,0 +1,124 @@
+/*
+  Copyright 2015 SINTEF ICT, Applied Mathematics.
+
+  This file is part of the Open Porous Media project (OPM).
+
+  OPM is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  OPM is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with OPM.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <config.h>
+
+#if HAVE_DYNAMIC_BOOST_TEST
+#define BOOST_TEST_DYN_LINK
+#endif
+
+#define BOOST_TEST_MODULE BlackoilStateExtrapolationTest
+
+#include <opm/autodiff/BlackoilStateExtrapolation.hpp>
+#include <opm/core/simulator/BlackoilState.hpp>
+
+#include <boost/test/unit_test.hpp>
+
+#include <stdexcept>
+
+using namespace Opm;
+
+namespace {
+    const int num_cells = 3;
+    const int num_phases = 2;
+
+    // State with the components given as polynomials in time.
+    BlackoilState state(const double t)
+    {
+        BlackoilState s;
+        s.init(num_cells, 0, num_phases);
+        for (int c = 0; c < num_cells; ++c) {
+            s.pressure()[c] = 1.0e7 + 1.0e5*(c + 1)*t + 1.0e3*t*t;
+            s.saturation()[c*num_phases]     = 0.2 + 0.01*t;
+            s.saturation()[c*num_phases + 1] = 0.8 - 0.01*t;
+            s.gasoilratio()[c] = 10.0 - 2.0*t;
+            s.rv()[c] = 0.0;
+        }
+        return s;
+    }
+}
+
+BOOST_AUTO_TEST_CASE(InvalidOrder)
+{
+    BOOST_CHECK_THROW(BlackoilStateExtrapolation(0), std::runtime_error);
+    BOOST_CHECK_THROW(BlackoilStateExtrapolation(3), std::runtime_error);
+}
+
+BOOST_AUTO_TEST_CASE(NeedsTwoStates)
+{
+    BlackoilStateExtrapolation extrapolation(1);
+    BlackoilState guess;
+    BOOST_CHECK(extrapolation.empty());
+    BOOST_CHECK(!extrapolation.extrapolate(1.0, state(0.0), guess));
+    extrapolation.addState(state(0.0), 0.0);
+    BOOST_CHECK(!extrapolation.extrapolate(1.0, state(0.0), guess));
+    // A step of zero length replaces the last state.
+    extrapolation.addState(state(0.0), 0.0);
+    BOOST_CHECK(!extrapolation.extrapolate(1.0, state(0.0), guess));
+}
+
+BOOST_AUTO_TEST_CASE(Linear)
+{
+    BlackoilStateExtrapolation extrapolation(1);
+    extrapolation.addState(state(0.0), 0.0);
+    extrapolation.addState(state(1.0), 1.0);
+    extrapolation.addState(state(3.0), 2.0);
+
+    BlackoilState guess;
+    BOOST_REQUIRE(extrapolation.extrapolate(1.0, state(3.0), guess));
+    const BlackoilState s1 = state(1.0);
+    const BlackoilState s3 = state(3.0);
+    for (int c = 0; c < num_cells; ++c) {
+        // Slope from the last two states, t = 1 and 3.
+        const double p = s3.pressure()[c] + 0.5*(s3.pressure()[c] - s1.pressure()[c]);
+        BOOST_CHECK_CLOSE(guess.pressure()[c], p, 1e-10);
+        BOOST_CHECK_CLOSE(guess.saturation()[c*num_phases], 0.24, 1e-10);
+        BOOST_CHECK_CLOSE(guess.gasoilratio()[c], 2.0, 1e-10);
+    }
+
+    // Rs is kept non-negative.
+    BOOST_REQUIRE(extrapolation.extrapolate(4.0, state(3.0), guess));
+    for (int c = 0; c < num_cells; ++c) {
+        BOOST_CHECK_EQUAL(guess.gasoilratio()[c], 0.0);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(Quadratic)
+{
+    BlackoilStateExtrapolation extrapolation(2);
+    extrapolation.addState(state(0.0), 0.0);
+    extrapolation.addState(state(1.0), 1.0);
+    extrapolation.addState(state(1.5), 0.5);
+    extrapolation.addState(state(3.0), 1.5);
+
+    // Exact for the quadratic pressure.
+    BlackoilState guess;
+    BOOST_REQUIRE(extrapolation.extrapolate(2.0, state(3.0), guess));
+    const BlackoilState s5 = state(5.0);
+    for (int c = 0; c < num_cells; ++c) {
+        BOOST_CHECK_CLOSE(guess.pressure()[c], s5.pressure()[c], 1e-10);
+        BOOST_CHECK_CLOSE(guess.saturation()[c*num_phases + 1], s5.saturation()[c*num_phases + 1], 1e-10);
+    }
+
+    // The change is added to the given state.
+    BlackoilState start = state(3.0);
+    start.pressure()[0] += 1.0;
+    BOOST_REQUIRE(extrapolation.extrapolate(2.0, start, guess));
+    BOOST_CHECK_CLOSE(guess.pressure()[0], s5.pressure()[0] + 1.0, 1e-10);
+}
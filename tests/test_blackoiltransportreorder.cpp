@@ -0,0 +1,214 @@
+/*
+  Copyright 2015 SINTEF ICT, Applied Mathematics.
+
+  This file is part of the Open Porous Media project (OPM).
+
+  OPM is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  OPM is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with OPM.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <config.h>
+
+#if HAVE_DYNAMIC_BOOST_TEST
+#define BOOST_TEST_DYN_LINK
+#endif
+
+#define BOOST_TEST_MODULE BlackoilTransportReorderTest
+
+#include <opm/autodiff/BlackoilTransportReorder.hpp>
+#include <opm/autodiff/BlackoilPropsAdInterface.hpp>
+#include <opm/core/utility/ErrorMacros.hpp>
+
+#include <boost/test/unit_test.hpp>
+
+#include <stdexcept>
+#include <vector>
+
+using namespace Opm;
+
+namespace {
+    typedef AutoDiffBlock<double> ADB;
+    typedef ADB::V V;
+
+    // Water-oil properties with quadratic relative permeabilities,
+    // the only property used by the transport solver.
+    class QuadraticRelperm : public BlackoilPropsAdInterface
+    {
+    public:
+        int numDimensions() const { return 1; }
+        int numCells() const { return 0; }
+        const double* porosity() const { return 0; }
+        const double* permeability() const { return 0; }
+        int numPhases() const { return 2; }
+        PhaseUsage phaseUsage() const
+        {
+            PhaseUsage pu;
+            pu.num_phases = 2;
+            pu.phase_used[BlackoilPhases::Aqua] = 1;
+            pu.phase_used[BlackoilPhases::Liquid] = 1;
+            pu.phase_used[BlackoilPhases::Vapour] = 0;
+            pu.phase_pos[BlackoilPhases::Aqua] = 0;
+            pu.phase_pos[BlackoilPhases::Liquid] = 1;
+            pu.phase_pos[BlackoilPhases::Vapour] = -1;
+            return pu;
+        }
+        const double* surfaceDensity(int) const { return 0; }
+        ADB muWat(const ADB&, const ADB&, const Cells&) const { return unused(); }
+        ADB muOil(const ADB&, const ADB&, const ADB&, const std::vector<PhasePresence>&, const Cells&) const { return unused(); }
+        ADB muGas(const ADB&, const ADB&, const ADB&, const std::vector<PhasePresence>&, const Cells&) const { return unused(); }
+        ADB bWat(const ADB&, const ADB&, const Cells&) const { return unused(); }
+        ADB bOil(const ADB&, const ADB&, const ADB&, const std::vector<PhasePresence>&, const Cells&) const { return unused(); }
+        ADB bGas(const ADB&, const ADB&, const ADB&, const std::vector<PhasePresence>&, const Cells&) const { return unused(); }
+        ADB rsSat(const ADB&, const Cells&) const { return unused(); }
+        ADB rsSat(const ADB&, const ADB&, const Cells&) const { return unused(); }
+        ADB rvSat(const ADB&, const Cells&) const { return unused(); }
+        ADB rvSat(const ADB&, const ADB&, const Cells&) const { return unused(); }
+        std::vector<ADB> relperm(const ADB& sw, const ADB& so, const ADB&, const Cells&) const
+        {
+            std::vector<ADB> kr(3, ADB::null());
+            kr[BlackoilPhases::Aqua] = sw * sw;
+            kr[BlackoilPhases::Liquid] = so * so;
+            kr[BlackoilPhases::Vapour] = ADB::constant(V::Zero(sw.size()));
+            return kr;
+        }
+        std::vector<ADB> capPress(const ADB&, const ADB&, const ADB&, const Cells&) const
+        {
+            return std::vector<ADB>(3, unused());
+        }
+        void updateSatHyst(const std::vector<double>&, const std::vector<int>&) {}
+        void updateSatOilMax(const std::vector<double>&) {}
+
+    private:
+        static ADB unused()
+        {
+            OPM_THROW(std::logic_error, "Not used by BlackoilTransportReorder.");
+        }
+    };
+
+    // Cells 0, ..., n-1 in a row, face i between cells i and i + 1.
+    HelperOps rowOfCells(const int n)
+    {
+        HelperOps ops;
+        ops.nbi.resize(n - 1, 2);
+        for (int f = 0; f < n - 1; ++f) {
+            ops.nbi(f, 0) = f;
+            ops.nbi(f, 1) = f + 1;
+        }
+        ops.div.resize(n, n - 1);
+        return ops;
+    }
+
+    // Unit b, viscosity, pore volume multiplier and equal heads.
+    BlackoilTransportReorder::Input input(const int n, const double pvdt,
+                                          const std::vector<double>& sat)
+    {
+        BlackoilTransportReorder::Input in;
+        in.pvdt = V::Constant(n, pvdt);
+        in.pv_mult = V::Ones(n);
+        in.total_flux = V::Zero(n - 1);
+        in.head.assign(2, V::Zero(n - 1));
+        in.mob_scale.assign(2, V::Ones(n));
+        in.component.assign(2, std::vector<V>(2, V::Zero(n)));
+        in.component[0][0] = V::Ones(n);
+        in.component[1][1] = V::Ones(n);
+        in.accum0.assign(2, V::Zero(n));
+        for (int c = 0; c < n; ++c) {
+            in.accum0[0][c] = sat[2*c];
+            in.accum0[1][c] = sat[2*c + 1];
+        }
+        in.well_production = V::Zero(n);
+        in.well_injection.assign(2, V::Zero(n));
+        return in;
+    }
+
+    std::vector<double> uniformSaturation(const int n, const double sw)
+    {
+        std::vector<double> sat(2*n);
+        for (int c = 0; c < n; ++c) {
+            sat[2*c] = sw;
+            sat[2*c + 1] = 1.0 - sw;
+        }
+        return sat;
+    }
+}
+
+
+
+BOOST_AUTO_TEST_CASE(CoCurrentDisplacement)
+{
+    const int n = 10;
+    const double pvdt = 2.0;
+    const QuadraticRelperm props;
+    const HelperOps ops = rowOfCells(n);
+    BlackoilTransportReorder transport(props, ops, 1e-12, 30, 0.2);
+
+    std::vector<double> sat = uniformSaturation(n, 0.1);
+    BlackoilTransportReorder::Input in = input(n, pvdt, sat);
+    in.total_flux = V::Ones(n - 1);
+    in.head.assign(2, V::Ones(n - 1));
+    in.well_injection[0][0] = 2.0;
+    in.well_production[n - 1] = 1.0;
+
+    BOOST_REQUIRE(transport.solve(in, sat));
+    BOOST_CHECK_EQUAL(transport.multiCellComponents(), 0);
+    BOOST_CHECK(transport.iterations() > 0);
+
+    // Water moves in from the injector, with a decreasing profile
+    // up to the producer (whose rate differs from the total flux).
+    BOOST_CHECK(sat[0] > 0.1);
+    for (int c = 0; c < n; ++c) {
+        BOOST_CHECK_CLOSE(sat[2*c] + sat[2*c + 1], 1.0, 1e-10);
+        if (c > 0 && c < n - 1) {
+            BOOST_CHECK(sat[2*c] <= sat[2*(c - 1)] + 1e-12);
+        }
+    }
+
+    // Water balance: accumulation equals injection minus production.
+    double accumulated = 0.0;
+    for (int c = 0; c < n; ++c) {
+        accumulated += pvdt * (sat[2*c] - 0.1);
+    }
+    const double sw0 = sat[0];
+    const double swn = sat[2*(n - 1)];
+    const double injected = 2.0 * (sw0*sw0 + (1 - sw0)*(1 - sw0));
+    const double produced = swn*swn;
+    BOOST_CHECK_CLOSE(accumulated, injected - produced, 1e-6);
+}
+
+
+
+BOOST_AUTO_TEST_CASE(CounterCurrentSegregation)
+{
+    const int n = 6;
+    const QuadraticRelperm props;
+    const HelperOps ops = rowOfCells(n);
+    BlackoilTransportReorder transport(props, ops, 1e-12, 100, 0.2);
+
+    // No total flux, water driven towards the last cell and oil
+    // towards the first, which couples all cells.
+    std::vector<double> sat = uniformSaturation(n, 0.5);
+    BlackoilTransportReorder::Input in = input(n, 10.0, sat);
+    in.head[0] = V::Constant(n - 1, 1.0);
+    in.head[1] = V::Constant(n - 1, -1.0);
+
+    BOOST_REQUIRE(transport.solve(in, sat));
+    BOOST_CHECK_EQUAL(transport.multiCellComponents(), 1);
+
+    double total_water = 0.0;
+    for (int c = 0; c < n; ++c) {
+        total_water += sat[2*c];
+    }
+    BOOST_CHECK_CLOSE(total_water, 0.5*n, 1e-8);
+    BOOST_CHECK(sat[0] < 0.5);
+    BOOST_CHECK(sat[2*(n - 1)] > 0.5);
+}
@@ -0,0 +1,159 @@
+/*
+  Copyright 2015 SINTEF ICT, Applied Mathematics.
+
+  This file is part of the Open Porous Media project (OPM).
+
+  OPM is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  OPM is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with OPM.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <config.h>
+
+#if HAVE_DYNAMIC_BOOST_TEST
+#define BOOST_TEST_DYN_LINK
+#endif
+
+#define BOOST_TEST_MODULE CellOrderingTest
+
+#include <opm/autodiff/CellOrdering.hpp>
+
+#include <boost/test/unit_test.hpp>
+
+#include <algorithm>
+#include <cstdlib>
+#include <utility>
+#include <vector>
+
+using namespace Opm;
+
+namespace {
+    typedef Eigen::SparseMatrix<double, Eigen::RowMajor> Mat;
+
+    // Five-point Laplacian on an nx x ny grid, with cells numbered
+    // by the given permutation of the natural order.
+    Mat laplacian(const int nx, const int ny, const std::vector<int>& number)
+    {
+        std::vector<Eigen::Triplet<double> > t;
+        for (int j = 0; j < ny; ++j) {
+            for (int i = 0; i < nx; ++i) {
+                const int c = number[j*nx + i];
+                t.emplace_back(c, c, 4.0);
+                if (i > 0)      { t.emplace_back(c, number[j*nx + i - 1], -1.0); }
+                if (i < nx - 1) { t.emplace_back(c, number[j*nx + i + 1], -1.0); }
+                if (j > 0)      { t.emplace_back(c, number[(j - 1)*nx + i], -1.0); }
+                if (j < ny - 1) { t.emplace_back(c, number[(j + 1)*nx + i], -1.0); }
+            }
+        }
+        Mat A(nx*ny, nx*ny);
+        A.setFromTriplets(t.begin(), t.end());
+        return A;
+    }
+
+    int bandwidth(const Mat& A)
+    {
+        int bw = 0;
+        for (int row = 0; row < A.rows(); ++row) {
+            for (Mat::InnerIterator it(A, row); it; ++it) {
+                bw = std::max(bw, std::abs(int(it.index()) - row));
+            }
+        }
+        return bw;
+    }
+}
+
+
+
+BOOST_AUTO_TEST_CASE(RcmReducesBandwidth)
+{
+    const int nx = 12, ny = 5, n = nx*ny;
+    // Scramble the natural numbering deterministically.
+    std::vector<int> number(n);
+    for (int c = 0; c < n; ++c) {
+        number[c] = (c * 37) % n;
+    }
+    const Mat A = laplacian(nx, ny, number);
+
+    const std::vector<int> new2old = reverseCuthillMcKee(A);
+    std::vector<int> sorted = new2old;
+    std::sort(sorted.begin(), sorted.end());
+    for (int c = 0; c < n; ++c) {
+        BOOST_REQUIRE_EQUAL(sorted[c], c);
+    }
+
+    const CellPermutation perm(new2old, 1);
+    const Mat B = perm.permute(A);
+    BOOST_CHECK_EQUAL(B.nonZeros(), A.nonZeros());
+    BOOST_CHECK(bandwidth(B) <= ny + 1);
+    BOOST_CHECK(bandwidth(B) < bandwidth(A));
+}
+
+
+
+BOOST_AUTO_TEST_CASE(PermutedSystem)
+{
+    typedef Eigen::Array<double, Eigen::Dynamic, 1> V;
+    // Two blocks of three cells, permuted consistently.
+    const std::vector<int> new2old = { 2, 0, 1 };
+    const CellPermutation perm(new2old, 2);
+    V x(6);
+    x << 10, 11, 12, 20, 21, 22;
+    const V y = perm.permute(x);
+    V expected(6);
+    expected << 12, 10, 11, 22, 20, 21;
+    BOOST_CHECK((y == expected).all());
+    BOOST_CHECK((perm.unpermute(y) == x).all());
+
+    // (P A P^T)(P x) == P (A x).
+    Mat A(6, 6);
+    for (int i = 0; i < 6; ++i) {
+        A.insert(i, i) = 1.0 + i;
+        A.insert(i, (i + 3) % 6) = 0.5;
+    }
+    A.insert(0, 1) = 2.0;
+    A.makeCompressed();
+    const V Ax = (A * x.matrix()).array();
+    const V PAPy = (perm.permute(A) * y.matrix()).array();
+    BOOST_CHECK(((PAPy - perm.permute(Ax)).abs() < 1e-14).all());
+
+    BOOST_CHECK_THROW(CellPermutation({ 0, 0, 1 }, 1), std::logic_error);
+}
+
+
+
+BOOST_AUTO_TEST_CASE(TopologicalComponents)
+{
+    // 0 -> 1 -> {2 <-> 3} -> 4, and 5 -> 1, given out of order.
+    const std::vector<std::pair<int, int> > edges = {
+        { 3, 4 }, { 2, 3 }, { 1, 2 }, { 3, 2 }, { 0, 1 }, { 5, 1 }, { 2, 3 }
+    };
+    std::vector<int> order;
+    std::vector<int> start;
+    topologicalComponents(6, edges, order, start);
+
+    BOOST_REQUIRE_EQUAL(order.size(), 6u);
+    BOOST_REQUIRE_EQUAL(start.size(), 6u);
+    std::vector<int> component(6, -1);
+    for (int comp = 0; comp + 1 < int(start.size()); ++comp) {
+        for (int k = start[comp]; k < start[comp + 1]; ++k) {
+            component[order[k]] = comp;
+        }
+    }
+    BOOST_CHECK(std::find(component.begin(), component.end(), -1) == component.end());
+    BOOST_CHECK_EQUAL(component[2], component[3]);
+    BOOST_CHECK_EQUAL(start[component[2] + 1] - start[component[2]], 2);
+    for (const auto& e : edges) {
+        BOOST_CHECK(component[e.first] <= component[e.second]);
+    }
+
+    BOOST_CHECK_THROW(topologicalComponents(2, { { 0, 2 } }, order, start), std::logic_error);
+}
@@ -0,0 +1,161 @@
+/*
+  Copyright 2015 SINTEF ICT, Applied Mathematics.
+
+  This file is part of the Open Porous Media project (OPM).
+
+  OPM is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  OPM is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with OPM.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <config.h>
+
+#if HAVE_DYNAMIC_BOOST_TEST
+#define BOOST_TEST_DYN_LINK
+#endif
+
+#define BOOST_TEST_MODULE GridOperatorsCacheTest
+
+#include <opm/autodiff/GridOperatorsCache.hpp>
+#include <opm/core/grid/GridManager.hpp>
+
+#include <boost/test/unit_test.hpp>
+#include <boost/filesystem.hpp>
+
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <string>
+
+using namespace Opm;
+
+namespace {
+    // A cache file name in the temporary directory, removed on exit.
+    struct TemporaryFile
+    {
+        TemporaryFile()
+            : name((boost::filesystem::temp_directory_path()
+                    / boost::filesystem::unique_path("test_gridoperatorscache-%%%%-%%%%.bin")).string())
+        {
+        }
+        ~TemporaryFile() { std::remove(name.c_str()); }
+        const std::string name;
+    };
+
+    // Overwrite the bytes at offset in file with value.
+    template <typename T>
+    void patch(const std::string& file, const std::streamoff offset, const T& value)
+    {
+        std::fstream f(file.c_str(), std::ios::in | std::ios::out | std::ios::binary);
+        f.seekp(offset);
+        f.write(reinterpret_cast<const char*>(&value), sizeof value);
+    }
+
+    // Header: magic, version, index size, scalar size and hash.
+    const std::streamoff header_size = 8 + 3*4 + 8;
+
+    bool equalMatrices(const HelperOps::M& A, const HelperOps::M& B)
+    {
+        if (A.rows() != B.rows() || A.cols() != B.cols() || A.nonZeros() != B.nonZeros()) {
+            return false;
+        }
+        return HelperOps::M(A - B).norm() == 0.0;
+    }
+}
+
+
+
+BOOST_AUTO_TEST_CASE(RoundTrip)
+{
+    const GridManager gm(4, 3);
+    const UnstructuredGrid& grid = *gm.c_grid();
+    const int nc = grid.number_of_cells;
+    const int nf = grid.number_of_faces;
+    const TemporaryFile tmp;
+    const std::string& filename = tmp.name;
+
+    const std::uint64_t hash = gridOperatorsHash(grid);
+    HelperOps ops;
+    BOOST_CHECK(!readHelperOps(filename, hash, nc, nf, ops));
+
+    // First call builds and writes the cache, second call reads it.
+    const HelperOps built = cachedHelperOps(grid, filename);
+    BOOST_REQUIRE(std::ifstream(filename.c_str()).good());
+    BOOST_REQUIRE(readHelperOps(filename, hash, nc, nf, ops));
+
+    BOOST_CHECK((ops.internal_faces == built.internal_faces).all());
+    BOOST_CHECK((ops.nbi == built.nbi).all());
+    BOOST_CHECK(equalMatrices(ops.ngrad,     built.ngrad));
+    BOOST_CHECK(equalMatrices(ops.grad,      built.grad));
+    BOOST_CHECK(equalMatrices(ops.caver,     built.caver));
+    BOOST_CHECK(equalMatrices(ops.div,       built.div));
+    BOOST_CHECK(equalMatrices(ops.fullngrad, built.fullngrad));
+    BOOST_CHECK(equalMatrices(ops.fulldiv,   built.fulldiv));
+
+    // A different grid must not accept the cache.
+    const GridManager other(3, 4);
+    HelperOps other_ops;
+    BOOST_CHECK(gridOperatorsHash(*other.c_grid()) != hash);
+    BOOST_CHECK(!readHelperOps(filename, gridOperatorsHash(*other.c_grid()),
+                               other.c_grid()->number_of_cells,
+                               other.c_grid()->number_of_faces, other_ops));
+}
+
+
+
+BOOST_AUTO_TEST_CASE(CorruptFile)
+{
+    const GridManager gm(4, 3);
+    const UnstructuredGrid& grid = *gm.c_grid();
+    const int nc = grid.number_of_cells;
+    const int nf = grid.number_of_faces;
+    const std::uint64_t hash = gridOperatorsHash(grid);
+    const TemporaryFile tmp;
+    const std::string& filename = tmp.name;
+
+    const HelperOps built = cachedHelperOps(grid, filename);
+    const std::int64_t ni = built.internal_faces.size();
+    // Start of the ngrad matrix, and of its outer and inner arrays.
+    const std::streamoff ngrad = header_size + 8 + 3*ni*sizeof(int);
+    const std::streamoff outer = ngrad + 3*8;
+    const std::streamoff inner = outer + (nc + 1)*sizeof(int);
+    HelperOps ops;
+
+    // Too many internal faces for the grid.
+    patch(filename, header_size, std::int64_t(nf + 1));
+    BOOST_CHECK(!readHelperOps(filename, hash, nc, nf, ops));
+    writeHelperOps(filename, hash, built);
+    BOOST_REQUIRE(readHelperOps(filename, hash, nc, nf, ops));
+
+    // A huge nnz, which must fail before allocating.
+    patch(filename, ngrad + 2*8, std::int64_t(1) << 60);
+    BOOST_CHECK(!readHelperOps(filename, hash, nc, nf, ops));
+    writeHelperOps(filename, hash, built);
+
+    // Decreasing outer index.
+    patch(filename, outer + sizeof(int), int(-1));
+    BOOST_CHECK(!readHelperOps(filename, hash, nc, nf, ops));
+    writeHelperOps(filename, hash, built);
+
+    // Inner index out of range.
+    patch(filename, inner, int(ni));
+    BOOST_CHECK(!readHelperOps(filename, hash, nc, nf, ops));
+
+    // The cache is rebuilt from the grid instead.
+    const HelperOps rebuilt = cachedHelperOps(grid, filename);
+    BOOST_CHECK(equalMatrices(rebuilt.ngrad, built.ngrad));
+    BOOST_CHECK(readHelperOps(filename, hash, nc, nf, ops));
+
+    // A truncated file.
+    boost::filesystem::resize_file(filename, boost::filesystem::file_size(filename) - 1);
+    BOOST_CHECK(!readHelperOps(filename, hash, nc, nf, ops));
+}
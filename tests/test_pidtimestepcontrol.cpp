@@ -0,0 +1,75 @@
+/*
+  Copyright 2015 SINTEF ICT, Applied Mathematics.
+
+  This file is part of the Open Porous Media project (OPM).
+
+  OPM is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  OPM is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with OPM.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <config.h>
+
+#if HAVE_DYNAMIC_BOOST_TEST
+#define BOOST_TEST_DYN_LINK
+#endif
+
+#define BOOST_TEST_MODULE PIDTimeStepControlTest
+
+#include <opm/autodiff/PIDTimeStepControl.hpp>
+
+#include <boost/test/unit_test.hpp>
+
+#include <stdexcept>
+
+using namespace Opm;
+
+BOOST_AUTO_TEST_CASE(InvalidParameters)
+{
+    BOOST_CHECK_THROW(PIDTimeStepControl(0, 0.2), std::runtime_error);
+    BOOST_CHECK_THROW(PIDTimeStepControl(8, 0.0), std::runtime_error);
+    BOOST_CHECK_THROW(PIDTimeStepControl(8, 0.2, 0.5), std::runtime_error);
+    BOOST_CHECK_THROW(PIDTimeStepControl(8, 0.2, 3.0, 0.2, 1.0), std::runtime_error);
+}
+
+BOOST_AUTO_TEST_CASE(SaturationTarget)
+{
+    PIDTimeStepControl control(8, 0.2, 3.0, 0.2, 0.5);
+
+    // On target, the step is kept.
+    BOOST_CHECK_CLOSE(control.suggestNext(10.0, 8, 0.2), 10.0, 1e-10);
+
+    // Overshoot: reduced by the ratio to the target.
+    BOOST_CHECK_CLOSE(control.suggestNext(10.0, 8, 0.4), 5.0, 1e-10);
+
+    // Small changes let the step grow, but at most by max_growth.
+    control.reset();
+    const double dt = control.suggestNext(10.0, 4, 0.1);
+    BOOST_CHECK(dt > 10.0);
+    BOOST_CHECK(dt < 30.0);
+    BOOST_CHECK_CLOSE(control.suggestNext(10.0, 1, 0.0), 30.0, 1e-10);
+
+    // Large overshoots are limited by min_factor.
+    BOOST_CHECK_CLOSE(control.suggestNext(10.0, 8, 10.0), 2.0, 1e-10);
+}
+
+BOOST_AUTO_TEST_CASE(IterationTarget)
+{
+    PIDTimeStepControl control(8, 0.2, 3.0, 0.2, 0.5);
+
+    // Too many iterations reduce the step even on the saturation target.
+    BOOST_CHECK_CLOSE(control.suggestNext(10.0, 16, 0.2), 5.0, 1e-10);
+    // Few iterations do not override the saturation target.
+    BOOST_CHECK_CLOSE(control.suggestNext(10.0, 2, 0.2), 10.0, 1e-10);
+
+    BOOST_CHECK_CLOSE(control.suggestAfterFailure(10.0), 5.0, 1e-10);
+}
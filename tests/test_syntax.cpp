@@ -7,11 +7,13 @@
 #define BOOST_TEST_MODULE SyntaxTest
 
 #include <opm/autodiff/AutoDiff.hpp>
+#include <opm/autodiff/AutoDiffBatch.hpp>
 
 #include <boost/test/unit_test.hpp>
 
 #include <cmath>
 #include <iostream>
+#include <vector>
 
 BOOST_AUTO_TEST_CASE(Initialisation)
 {
@@ -239,3 +241,95 @@ BOOST_AUTO_TEST_CASE(SquareRoot)
     BOOST_CHECK_CLOSE(f.val(),  std::sqrt(g.val()) - 1.2, atol);
     BOOST_CHECK_CLOSE(f.der(), 1.0/(2.0 * std::sqrt(g.val())) * g.der(), atol);
 }
+
+
+BOOST_AUTO_TEST_CASE(ExpLogPow)
+{
+    typedef Opm::AutoDiff<double> AdFW;
+
+    const double atol = 1.0e-13;
+
+    const AdFW x = AdFW::variable(0.75);
+
+    const AdFW e = std::exp(x);
+    BOOST_CHECK_CLOSE(e.val(), std::exp(x.val()), atol);
+    BOOST_CHECK_CLOSE(e.der(), std::exp(x.val()), atol);
+
+    const AdFW l = std::log(x);
+    BOOST_CHECK_CLOSE(l.val(), std::log(x.val()), atol);
+    BOOST_CHECK_CLOSE(l.der(), 1.0 / x.val(), atol);
+
+    const AdFW p = std::pow(x, 3.0);
+    BOOST_CHECK_CLOSE(p.val(), std::pow(x.val(), 3.0), atol);
+    BOOST_CHECK_CLOSE(p.der(), 3.0*x.val()*x.val(), atol);
+
+    const AdFW q = std::pow(2.0, x);
+    BOOST_CHECK_CLOSE(q.val(), std::pow(2.0, x.val()), atol);
+    BOOST_CHECK_CLOSE(q.der(), std::pow(2.0, x.val())*std::log(2.0), atol);
+
+    const AdFW r = std::pow(x, x);
+    BOOST_CHECK_CLOSE(r.val(), std::pow(x.val(), x.val()), atol);
+    BOOST_CHECK_CLOSE(r.der(), r.val()*(std::log(x.val()) + 1.0), atol);
+}
+
+
+BOOST_AUTO_TEST_CASE(MinMax)
+{
+    typedef Opm::AutoDiff<double> AdFW;
+
+    const AdFW x = AdFW::variable(0.5);
+    const AdFW y = AdFW::constant(0.25);
+
+    BOOST_CHECK_EQUAL(std::min(x, y).val(), 0.25);
+    BOOST_CHECK_EQUAL(std::min(x, y).der(), 0.0);
+    BOOST_CHECK_EQUAL(std::max(x, y).val(), 0.5);
+    BOOST_CHECK_EQUAL(std::max(x, y).der(), 1.0);
+
+    BOOST_CHECK_EQUAL(std::min(x, 1.0).der(), 1.0);
+    BOOST_CHECK_EQUAL(std::max(x, 1.0).der(), 0.0);
+}
+
+
+BOOST_AUTO_TEST_CASE(MultipleDerivatives)
+{
+    typedef Opm::AutoDiff<double, 3> AdFW;
+
+    const double atol = 1.0e-13;
+
+    const AdFW p  = AdFW::variable(2.0, 0);
+    const AdFW s  = AdFW::variable(0.3, 1);
+    const AdFW rs = AdFW::variable(5.0, 2);
+
+    const AdFW f = p*s + std::exp(rs / 10.0) - 1.0;
+    BOOST_CHECK_CLOSE(f.val(), 2.0*0.3 + std::exp(0.5) - 1.0, atol);
+    BOOST_CHECK_CLOSE(f.der(0), 0.3, atol);
+    BOOST_CHECK_CLOSE(f.der(1), 2.0, atol);
+    BOOST_CHECK_CLOSE(f.der(2), std::exp(0.5) / 10.0, atol);
+
+    const AdFW g = -f;
+    for (int i = 0; i < 3; ++i) {
+        BOOST_CHECK_EQUAL(g.der(i), -f.der(i));
+    }
+}
+
+
+BOOST_AUTO_TEST_CASE(Batch)
+{
+    typedef Opm::AutoDiffBatch<double, 2> Batch;
+
+    std::vector<double> pv = { 1.0, 2.0, 3.0 };
+    std::vector<double> sv = { 0.1, 0.2, 0.3 };
+    const Batch p = Batch::variable(pv, 0);
+    const Batch s = Batch::variable(sv, 1);
+
+    Batch f(p.size());
+    for (int i = 0; i < p.size(); ++i) {
+        f.assign(i, p[i] * s[i]);
+    }
+
+    for (int i = 0; i < f.size(); ++i) {
+        BOOST_CHECK_EQUAL(f.value()[i], pv[i] * sv[i]);
+        BOOST_CHECK_EQUAL(f.derivative(0)[i], sv[i]);
+        BOOST_CHECK_EQUAL(f.derivative(1)[i], pv[i]);
+    }
+}